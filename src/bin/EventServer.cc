@@ -0,0 +1,619 @@
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <netinet/in.h>
+
+#include "EventServer.h"
+#include "AssertLocal.h"
+#include "Logger.h"
+#include "Parameters.h"
+#include "PipelineStats.h"
+#include "LatencyBudget.h"
+
+using namespace std;
+using namespace srl;
+
+/** Epoll ids of the listening socket and of the wake-up pipe */
+#define LISTEN_ID 0
+#define WAKE_ID 1
+
+#define MAX_EVENTS 256
+
+/** Buffers written with one writev() call */
+#define MAX_IOV 64
+
+/** Bytes read from one connection per event, for fairness */
+#define READ_CHUNK (64 * 1024)
+
+struct EventServer::Connection
+{
+  Connection(unsigned long i, int s)
+    : id(i), sock(s), protocol(UNKNOWN), pending(0),
+      nextLine(0), nextAnswer(0), outputOffset(0),
+      readClosed(false), events(0), lastActive(LatencyBudget::now()) {}
+
+  unsigned long id;
+
+  int sock;
+
+  enum { UNKNOWN, LINES, FRAMES } protocol;
+
+  /** Bytes read but not parsed yet; the decoder has them for frames */
+  string input;
+
+  FrameDecoder decoder;
+
+  /** Requests being labeled */
+  int pending;
+
+  //
+  // lines are answered in request order
+  //
+  unsigned long nextLine;
+  unsigned long nextAnswer;
+  map<unsigned long, string> answers;
+
+  /** Bytes waiting for the socket */
+  list<string> output;
+
+  /** Bytes of output.front() already written */
+  size_t outputOffset;
+
+  /** EOF, or a protocol error: no more requests */
+  bool readClosed;
+
+  /** Events watched */
+  unsigned int events;
+
+  /** When the connection last read or wrote something, in milliseconds */
+  double lastActive;
+
+  /**
+   * Requests whose answers are not written yet, counted against the
+   *   pending limit, including the answers of STATS or RELOAD requests and
+   *   of empty frames, which are ready at once
+   */
+  size_t backlog() const {
+    return pending + answers.size() + output.size();
+  }
+};
+
+/** A request of one connection: one line, or one frame */
+class EventServer::Job : public BatchJob
+{
+ public:
+  Job(EventServer & server, unsigned long conn, unsigned long t, bool f)
+    : connection(conn), tag(t), framed(f), mServer(server) {}
+
+  void done() { mServer.complete(this); }
+
+  unsigned long connection;
+
+  /** Frame id, or line number */
+  unsigned long tag;
+
+  bool framed;
+
+ private:
+  EventServer & mServer;
+};
+
+std::string statsReport(srl::MicroBatcher * batcher)
+{
+  ostringstream os;
+  os << "pid " << getpid() << "\n";
+  if(batcher != NULL) os << "queue_depth " << batcher->getQueueDepth() << "\n";
+  PipelineStats::print(os);
+  return os.str();
+}
+
+std::string requestReload()
+{
+  if(! Parameters::contains("allow-reload")){
+    return "Reload not allowed\n\n";
+  }
+  CERR << "Reload requested through worker " << getpid() << endl;
+  kill(getppid(), SIGHUP);
+  return "Reload started\n\n";
+}
+
+static void setNonBlocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  RVASSERT(flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0,
+	   "Failed to make descriptor non-blocking: " << strerror(errno));
+}
+
+EventServer::EventServer(int listenSock,
+			 int maxPending,
+			 double requestTimeout,
+			 srl::MicroBatcher & batcher)
+  : mListenSock(listenSock), mMaxPending(maxPending), 
+    mRequestTimeout(requestTimeout), mBatcher(batcher),
+    mNextId(WAKE_ID + 1), mDraining(0), mStopped(false)
+{
+  pthread_mutex_init(& mMutex, NULL);
+
+  // every idle connection holds a descriptor
+  struct rlimit limit;
+  if(getrlimit(RLIMIT_NOFILE, & limit) == 0 && limit.rlim_cur < limit.rlim_max){
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, & limit);
+  }
+
+  mEpoll = epoll_create(1024);
+  RVASSERT(mEpoll >= 0, "Failed to create epoll: " << strerror(errno));
+
+  int fds[2];
+  RVASSERT(pipe(fds) == 0, "Failed to create pipe: " << strerror(errno));
+  mWakeRead = fds[0];
+  mWakeWrite = fds[1];
+  setNonBlocking(mWakeRead);
+  setNonBlocking(mWakeWrite);
+
+  struct epoll_event ev;
+  memset(& ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+  // wake up one worker per new connection
+  ev.events |= EPOLLEXCLUSIVE;
+#endif
+  ev.data.u64 = LISTEN_ID;
+  RVASSERT(epoll_ctl(mEpoll, EPOLL_CTL_ADD, mListenSock, & ev) == 0,
+	   "Failed to watch listening socket: " << strerror(errno));
+
+  ev.events = EPOLLIN;
+  ev.data.u64 = WAKE_ID;
+  RVASSERT(epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeRead, & ev) == 0,
+	   "Failed to watch pipe: " << strerror(errno));
+}
+
+EventServer::~EventServer()
+{
+  while(! mConnections.empty()) close(mConnections.begin()->second);
+  ::close(mEpoll);
+  ::close(mWakeRead);
+  ::close(mWakeWrite);
+  pthread_mutex_destroy(& mMutex);
+}
+
+void EventServer::complete(Job * job)
+{
+  pthread_mutex_lock(& mMutex);
+  mCompleted.push_back(job);
+  pthread_mutex_unlock(& mMutex);
+
+  // a full pipe wakes up the loop already
+  char c = 0;
+  while(::write(mWakeWrite, & c, 1) < 0 && errno == EINTR);
+}
+
+void EventServer::drain()
+{
+  mDraining = 1;
+  // write() is safe in a signal handler
+  char c = 0;
+  if(::write(mWakeWrite, & c, 1) < 0){
+    // the pipe is full: the loop wakes up anyway
+  }
+}
+
+void EventServer::stopAccepting()
+{
+  mStopped = true;
+  epoll_ctl(mEpoll, EPOLL_CTL_DEL, mListenSock, NULL);
+  LOGM << "Draining " << mConnections.size() << " connections." << endl;
+}
+
+void EventServer::closeIdle()
+{
+  double now = LatencyBudget::now();
+  vector<Connection *> idle;
+  for(map<unsigned long, Connection *>::iterator it = mConnections.begin();
+      it != mConnections.end(); it ++){
+    Connection * conn = it->second;
+    if(conn->pending == 0 && conn->output.empty() &&
+       now - conn->lastActive >= DRAIN_IDLE_MS){
+      idle.push_back(conn);
+    }
+  }
+  for(size_t i = 0; i < idle.size(); i ++) close(idle[i]);
+}
+
+void EventServer::run()
+{
+  struct epoll_event events[MAX_EVENTS];
+
+  while(true){
+    if(mDraining && ! mStopped) stopAccepting();
+    if(mStopped){
+      closeIdle();
+      if(mConnections.empty()) return;
+    }
+
+    int n = epoll_wait(mEpoll, events, MAX_EVENTS,
+		       (mStopped ? DRAIN_IDLE_MS : -1));
+    if(n < 0){
+      RVASSERT(errno == EINTR, "epoll_wait failed: " << strerror(errno));
+      continue;
+    }
+
+    for(int i = 0; i < n; i ++){
+      unsigned long id = events[i].data.u64;
+      if(id == LISTEN_ID){
+	accept();
+	continue;
+      }
+      if(id == WAKE_ID){
+	char buffer[1024];
+	while(::read(mWakeRead, buffer, sizeof(buffer)) > 0);
+	continue;
+      }
+
+      // closed while handling an earlier event
+      map<unsigned long, Connection *>::iterator it = mConnections.find(id);
+      if(it == mConnections.end()) continue;
+      Connection * conn = it->second;
+
+      if(events[i].events & (EPOLLERR | EPOLLHUP)){
+	close(conn);
+	continue;
+      }
+      if((events[i].events & EPOLLIN) && (! read(conn) || ! parse(conn))){
+	close(conn);
+	continue;
+      }
+      // requests held back by the pending limit may go once written
+      if((events[i].events & EPOLLOUT) && (! write(conn) || ! parse(conn))){
+	close(conn);
+	continue;
+      }
+      updateEvents(conn);
+      closeIfDone(conn);
+    }
+
+    drainCompleted();
+    dispatchDeferred();
+  }
+}
+
+void EventServer::accept()
+{
+  while(true){
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    // the other workers accept on this socket too: whoever loses the race
+    //   gets EAGAIN
+    int sock = ::accept4(mListenSock, (struct sockaddr *) & address,
+			 & length, SOCK_NONBLOCK);
+    if(sock < 0){
+      if(errno == EINTR || errno == ECONNABORTED) continue;
+      if(errno != EAGAIN && errno != EWOULDBLOCK){
+	CERR << "Failed to accept connection: " << strerror(errno) << endl;
+      }
+      return;
+    }
+
+    Connection * conn = new Connection(mNextId ++, sock);
+
+    struct epoll_event ev;
+    memset(& ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = conn->id;
+    if(epoll_ctl(mEpoll, EPOLL_CTL_ADD, sock, & ev) != 0){
+      CERR << "Failed to watch connection: " << strerror(errno) << endl;
+      ::close(sock);
+      delete conn;
+      continue;
+    }
+    conn->events = ev.events;
+    mConnections[conn->id] = conn;
+    LOGD << "Connection " << conn->id << " opened, "
+	 << mConnections.size() << " open." << endl;
+  }
+}
+
+bool EventServer::read(Connection * conn)
+{
+  char chunk[READ_CHUNK];
+  ssize_t n = ::read(conn->sock, chunk, sizeof(chunk));
+  if(n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+
+  conn->lastActive = LatencyBudget::now();
+  if(n == 0){
+    conn->readClosed = true;
+  } else if(conn->protocol == Connection::FRAMES){
+    conn->decoder.append(chunk, n);
+  } else {
+    conn->input.append(chunk, n);
+  }
+  return true;
+}
+
+bool EventServer::parse(Connection * conn)
+{
+  if(conn->protocol == Connection::UNKNOWN){
+    // the first bytes tell the protocol
+    if(conn->input.size() < 4 &&
+       startsWithRequestMagic(conn->input.data(), conn->input.size())){
+      return ! conn->readClosed || conn->input.empty();
+    }
+
+    if(startsWithRequestMagic(conn->input.data(), conn->input.size())){
+      conn->protocol = Connection::FRAMES;
+      conn->decoder.append(conn->input.data(), conn->input.size());
+      conn->input.clear();
+    } else {
+      conn->protocol = Connection::LINES;
+    }
+  }
+
+  if(conn->protocol == Connection::FRAMES) return parseFrames(conn);
+  return parseLines(conn);
+}
+
+bool EventServer::parseLines(Connection * conn)
+{
+  size_t start = 0;
+  while(conn->backlog() < (size_t) mMaxPending){
+    size_t end = conn->input.find('\n', start);
+    if(end == string::npos){
+      // the last line before EOF needs no terminator
+      if(! conn->readClosed || start >= conn->input.size()) break;
+      end = conn->input.size();
+    }
+
+    string line = conn->input.substr(start, end - start);
+    if(! line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    start = min(end + 1, conn->input.size());
+
+    if(line == STATS_REQUEST){
+      answerLine(conn, conn->nextLine ++, statsReport(& mBatcher) + "\n");
+      continue;
+    }
+    if(line == RELOAD_REQUEST){
+      answerLine(conn, conn->nextLine ++, requestReload());
+      continue;
+    }
+
+    LOGH << "Request: " << line << endl;
+    Job * job = new Job(* this, conn->id, conn->nextLine ++, false);
+    job->sentences.push_back(line);
+    if(mRequestTimeout > 0){
+      job->deadline = LatencyBudget::now() + mRequestTimeout;
+    }
+    conn->pending ++;
+    dispatch(job);
+  }
+  conn->input.erase(0, start);
+
+  // the input may also hold complete lines, held back by the limit
+  if(conn->input.size() > MAX_LINE &&
+     conn->input.find('\n') == string::npos){
+    CERR << "Request longer than " << MAX_LINE
+	 << " bytes. Closing connection." << endl;
+    return false;
+  }
+  return true;
+}
+
+bool EventServer::parseFrames(Connection * conn)
+{
+  try{
+    while(conn->backlog() < (size_t) mMaxPending){
+      FrameRequest request;
+      if(! conn->decoder.next(request)) break;
+
+      // a frame without sentences asks for the stats
+      if(request.sentences.empty()){
+	FrameResponse response;
+	response.id = request.id;
+	response.results.push_back(FrameResult(FRAME_OK,
+					       statsReport(& mBatcher)));
+	conn->output.push_back(string());
+	encodeFrame(response, conn->output.back());
+	continue;
+      }
+
+      for(size_t i = 0; i < request.sentences.size(); i ++){
+	LOGH << "Request " << request.id << ": "
+	     << request.sentences[i] << endl;
+      }
+      Job * job = new Job(* this, conn->id, request.id, true);
+      job->sentences.swap(request.sentences);
+      if(mRequestTimeout > 0){
+	job->deadline = LatencyBudget::now() + mRequestTimeout;
+      }
+      conn->pending ++;
+      dispatch(job);
+    }
+  } catch(exception & e){
+    // the stream can not be resynced, but the frames already read are
+    //   still answered
+    CERR << "Closing connection: " << e.what() << endl;
+    conn->readClosed = true;
+    conn->decoder = FrameDecoder();
+  }
+  return true;
+}
+
+void EventServer::dispatch(Job * job)
+{
+  // keep the arrival order
+  if(! mDeferred.empty() || ! mBatcher.trySubmit(job)){
+    mDeferred.push_back(job);
+  }
+}
+
+void EventServer::dispatchDeferred()
+{
+  while(! mDeferred.empty()){
+    Job * job = mDeferred.front();
+    if(mConnections.find(job->connection) == mConnections.end()){
+      // nobody would read the answer
+      mDeferred.pop_front();
+      delete job;
+      continue;
+    }
+    if(job->deadline > 0 && job->deadline <= LatencyBudget::now()){
+      // the client stopped waiting while the batcher was full
+      mDeferred.pop_front();
+      for(size_t i = 0; i < job->sentences.size(); i ++)
+	PipelineStats::count(STAT_DEADLINE_EXPIRED);
+      job->results.assign(job->sentences.size(),
+			  FrameResult(FRAME_FAILED, DEADLINE_EXPIRED_ERROR));
+      complete(job);
+      continue;
+    }
+    if(! mBatcher.trySubmit(job)) break;
+    mDeferred.pop_front();
+  }
+}
+
+void EventServer::drainCompleted()
+{
+  vector<Job *> completed;
+  pthread_mutex_lock(& mMutex);
+  completed.swap(mCompleted);
+  pthread_mutex_unlock(& mMutex);
+
+  for(size_t i = 0; i < completed.size(); i ++){
+    Job * job = completed[i];
+    map<unsigned long, Connection *>::iterator it =
+      mConnections.find(job->connection);
+    if(it == mConnections.end()){
+      delete job;
+      continue;
+    }
+    Connection * conn = it->second;
+    conn->pending --;
+
+    if(job->framed){
+      FrameResponse response;
+      response.id = (unsigned int) job->tag;
+      response.results.swap(job->results);
+      conn->output.push_back(string());
+      encodeFrame(response, conn->output.back());
+    } else {
+      const FrameResult & result = job->results[0];
+      if(result.status == FRAME_OK){
+	answerLine(conn, job->tag, result.data);
+      } else {
+	CERR << "Failed to process sentence: " << job->sentences[0] << endl
+	     << result.data << endl;
+	// an empty output, such that the client is not left waiting
+	answerLine(conn, job->tag, "\n");
+      }
+    }
+    delete job;
+
+    // requests held back by the pending limit may go now
+    if(! parse(conn) || ! write(conn)){
+      close(conn);
+      continue;
+    }
+    updateEvents(conn);
+    closeIfDone(conn);
+  }
+}
+
+void EventServer::answerLine(Connection * conn,
+			     unsigned long line,
+			     const std::string & answer)
+{
+  conn->answers[line] = answer;
+
+  map<unsigned long, string>::iterator it;
+  while((it = conn->answers.find(conn->nextAnswer)) != conn->answers.end()){
+    conn->output.push_back(string());
+    conn->output.back().swap(it->second);
+    conn->answers.erase(it);
+    conn->nextAnswer ++;
+  }
+}
+
+bool EventServer::write(Connection * conn)
+{
+  while(! conn->output.empty()){
+    struct iovec iov[MAX_IOV];
+    int count = 0;
+    size_t offset = conn->outputOffset;
+    for(list<string>::iterator it = conn->output.begin();
+	it != conn->output.end() && count < MAX_IOV; it ++){
+      iov[count].iov_base = (void *) (it->data() + offset);
+      iov[count].iov_len = it->size() - offset;
+      offset = 0;
+      count ++;
+    }
+
+    ssize_t n = writev(conn->sock, iov, count);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      return (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    conn->lastActive = LatencyBudget::now();
+    size_t written = n;
+    while(written > 0){
+      size_t left = conn->output.front().size() - conn->outputOffset;
+      if(written < left){
+	conn->outputOffset += written;
+	break;
+      }
+      written -= left;
+      conn->output.pop_front();
+      conn->outputOffset = 0;
+    }
+  }
+  return true;
+}
+
+void EventServer::updateEvents(Connection * conn)
+{
+  unsigned int events = 0;
+  if(! conn->readClosed && conn->backlog() < (size_t) mMaxPending){
+    events |= EPOLLIN;
+  }
+  if(! conn->output.empty()) events |= EPOLLOUT;
+  if(events == conn->events) return;
+
+  struct epoll_event ev;
+  memset(& ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.u64 = conn->id;
+  if(epoll_ctl(mEpoll, EPOLL_CTL_MOD, conn->sock, & ev) != 0){
+    CERR << "Failed to watch connection: " << strerror(errno) << endl;
+  }
+  conn->events = events;
+}
+
+void EventServer::closeIfDone(Connection * conn)
+{
+  if(conn->readClosed && conn->backlog() == 0 && conn->input.empty()){
+    if(conn->decoder.pending() > 0){
+      CERR << "Connection closed in the middle of a frame." << endl;
+    }
+    close(conn);
+  }
+}
+
+void EventServer::close(Connection * conn)
+{
+  epoll_ctl(mEpoll, EPOLL_CTL_DEL, conn->sock, NULL);
+  ::close(conn->sock);
+  mConnections.erase(conn->id);
+  LOGD << "Connection " << conn->id << " closed, "
+       << mConnections.size() << " open." << endl;
+  delete conn;
+}
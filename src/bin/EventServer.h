@@ -0,0 +1,175 @@
+
+#ifndef SRL_EVENT_SERVER_H
+#define SRL_EVENT_SERVER_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <pthread.h>
+#include <signal.h>
+
+#include "FrameProtocol.h"
+#include "MicroBatcher.h"
+
+/** Longest request line accepted */
+#define MAX_LINE (16 * 1024)
+
+/** A line with only this asks for the stats of the worker */
+#define STATS_REQUEST "STATS"
+
+/**
+ * The stats of this worker process, as answered to a STATS request (a
+ *   frame without sentences, or a STATS_REQUEST line): one line per
+ *   counter or histogram
+ * @param batcher The queue of the worker, if any
+ */
+std::string statsReport(srl::MicroBatcher * batcher);
+
+/**
+ * A draining worker closes the connections idle for this many 
+ *   milliseconds, instead of waiting for more requests; the client
+ *   reconnects to a new worker
+ */
+#define DRAIN_IDLE_MS 200
+
+/** A line with only this asks the supervisor to reload the models */
+#define RELOAD_REQUEST "RELOAD"
+
+/**
+ * Answers a RELOAD_REQUEST line: signals the supervisor of this worker,
+ *   if the server runs with --allow-reload
+ */
+std::string requestReload();
+
+/**
+ * Serves all the connections of one worker process from a single thread
+ * The sockets are non-blocking and watched with epoll: requests are
+ *   parsed as their bytes arrive, in either protocol of the server (lines
+ *   or frames, detected by their first bytes), and each complete request
+ *   is handed to a MicroBatcher, whose threads label it. The labeling
+ *   threads pass the results back through a pipe that wakes up the loop,
+ *   which writes them with writev() as the sockets accept them.
+ * An idle connection costs one Connection object and one descriptor, so
+ *   thousands of keep-alive connections need no thread or process each.
+ */
+class EventServer
+{
+ public:
+  /**
+   * @param listenSock The listening socket, shared with the other workers;
+   *                   it must have been created non-blocking
+   * @param maxPending Stop reading a connection while this many of its
+   *                   requests, including STATS and RELOAD requests,
+   *                   are not answered yet
+   * @param requestTimeout Milliseconds a request may take from the moment
+   *                       it is read, after which it fails; 0 for none
+   * @param batcher Labels the requests; owned by the caller
+   */
+  EventServer(int listenSock, 
+	      int maxPending, 
+	      double requestTimeout,
+	      srl::MicroBatcher & batcher);
+
+  ~EventServer();
+
+  /** Runs the event loop; returns once drained */
+  void run();
+
+  /**
+   * Stops accepting connections: run() returns once the open connections
+   *   are answered and idle for DRAIN_IDLE_MS. Can be called from a signal
+   *   handler.
+   */
+  void drain();
+
+ private:
+  EventServer(const EventServer &);
+  EventServer & operator = (const EventServer &);
+
+  struct Connection;
+  class Job;
+
+  /** Called by the labeling threads when a job is done */
+  void complete(Job * job);
+
+  void accept();
+
+  /** Reads what the socket has; false if the connection must close */
+  bool read(Connection * conn);
+
+  /** Turns the bytes read into jobs; false on a protocol error */
+  bool parse(Connection * conn);
+
+  bool parseLines(Connection * conn);
+
+  bool parseFrames(Connection * conn);
+
+  /** Queues the answer to this line, and the ones it held back */
+  void answerLine(Connection * conn, unsigned long line,
+		  const std::string & answer);
+
+  /** Sends the job to the batcher, or defers it if the queue is full */
+  void dispatch(Job * job);
+
+  /** Retries the deferred jobs, in order; fails the expired ones */
+  void dispatchDeferred();
+
+  /** Moves the finished jobs to the output of their connections */
+  void drainCompleted();
+
+  /** Writes as much output as the socket accepts; false on error */
+  bool write(Connection * conn);
+
+  /** Watches the socket for what the connection can do next */
+  void updateEvents(Connection * conn);
+
+  /** Closes the connection once it has nothing left to do */
+  void closeIfDone(Connection * conn);
+
+  /** Called by run() once drain() was called */
+  void stopAccepting();
+
+  /** Closes the connections with nothing to do for DRAIN_IDLE_MS */
+  void closeIdle();
+
+  void close(Connection * conn);
+
+  int mListenSock;
+
+  int mMaxPending;
+
+  double mRequestTimeout;
+
+  srl::MicroBatcher & mBatcher;
+
+  int mEpoll;
+
+  /** The labeling threads write a byte here for every finished job */
+  int mWakeRead;
+  int mWakeWrite;
+
+  /**
+   * Open connections, by id. Ids are never reused, so the results of a
+   *   closed connection are simply dropped.
+   */
+  std::map<unsigned long, Connection *> mConnections;
+
+  unsigned long mNextId;
+
+  /** Jobs that did not fit in the batcher queue yet */
+  std::list<Job *> mDeferred;
+
+  /** Set by drain() */
+  volatile sig_atomic_t mDraining;
+
+  /** Set once stopAccepting() was called */
+  bool mStopped;
+
+  /** Guards mCompleted, which the labeling threads fill */
+  pthread_mutex_t mMutex;
+
+  std::vector<Job *> mCompleted;
+};
+
+#endif
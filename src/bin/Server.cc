@@ -1,140 +1,1158 @@
-/* A simple server in the internet domain using TCP
-   The port number is passed as an argument */
+/**
+ * TCP server for the SRL system
+ * The models are loaded once, before any fork. Two modes are available:
+ *   --workers=N (N > 0): a supervisor forks N long-lived workers, which
+ *     accept connections on the shared listening socket. A connection
+ *     carries any number of requests, either one sentence per line, each
+ *     answered with its extended CoNLL output (which ends with an empty
+ *     line), or as frames (see FrameProtocol.h), detected by their magic.
+ *     Workers that die are restarted by the supervisor.
+ *     With --event-loop, each worker serves all its connections at once
+ *     from an epoll loop (see EventServer.h), instead of one at a time.
+ *     A STATS line, or a frame without sentences, is answered with the
+ *     counters and latency histograms of the worker (see PipelineStats.h).
+ *     With --request-timeout, a request not answered in time fails with
+ *     "Deadline expired": it is dropped if still queued, or its parse and
+ *     labeling stop where they are, and their partial frame is not sent.
+ *     Until then it runs at full quality: unlike the latency-budget of 
+ *     the shell, the timeout never reduces the parser effort or the beams.
+ *     SIGHUP to the supervisor (or a RELOAD line, with --allow-reload)
+ *     loads the models again, from the same directories, in a verifier
+ *     process that labels a probe sentence and exits. If the new models
+ *     work, the supervisor runs itself again with exec(), keeping its
+ *     process id, the listening socket and its workers. The new image
+ *     loads the models and starts its own workers; the old workers then
+ *     stop accepting connections, and close theirs once idle, so the
+ *     requests in flight finish on the old models, which are released
+ *     when the last old worker exits.
+ *   --workers=0 (default): one process is forked for each connection,
+ *     which answers a single request, read with one read() call.
+ */
 
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <pthread.h>
 #include <unistd.h>
-#include <sys/types.h> 
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
 #include <netinet/in.h>
 #include "Parameters.h"
 #include "Logger.h"
+#include "Exception.h"
 #include "Swirl.h"
+#include "FrameProtocol.h"
+#include "MicroBatcher.h"
+#include "EventServer.h"
+#include "PipelineStats.h"
 
 using namespace std;
 using namespace srl;
 
+/** Restart a worker at most once per second, if it keeps crashing */
+#define MIN_WORKER_LIFE 1
+
+static void usage(const char * name)
+{
+  CERR << "Usage: " << name << " [ <parameters> ] "
+       << " <srl model directory> <charniak model directory>\n";
+  CERR << "Valid parameters:\n"
+       << "\tverbose - Set verbosity level\n"
+       << "\tcase-insensitive - use case-insensitive models\n"
+       << "\tport - listen on this port (default 2718)\n"
+       << "\tworkers - serve persistent connections with this many "
+       << "pre-forked processes\n\t\t(default 0: fork one process per "
+       << "request)\n"
+       << "\tframe-threads - process the frames of a connection with this "
+       << "many threads per worker\n"
+       << "\tmax-pending-frames - stop reading a connection while this many "
+       << "of its frames are\n\t\tnot answered yet (default 16)\n"
+       << "\tbatch-size - label the sentences of pipelined frames in batches "
+       << "of up to this\n\t\tmany sentences (default 0: no batching)\n"
+       << "\tbatch-wait - close a batch this many milliseconds after its "
+       << "first sentence\n\t\tarrived (default 2)\n"
+       << "\tmax-queued - stop reading a connection while this many "
+       << "sentences wait for\n\t\ta batch (default 256)\n"
+       << "\tevent-loop - serve all the connections of a worker from one "
+       << "epoll loop; the\n\t\trequests are always batched (default "
+       << "batch size 32)\n"
+       << "\trequest-timeout - fail the requests not answered this many "
+       << "milliseconds after\n\t\tthey were read; the work in progress "
+       << "is abandoned, but never\n\t\tdegraded (default 0: no limit)\n"
+       << "\tallow-reload - accept RELOAD lines, which reload the models as "
+       << "SIGHUP does\n"
+       << "\treload-probe - the sentence labeled to verify new models, in "
+       << "double quotes\n"
+       << "\tdrain-timeout - kill the old workers still busy this many "
+       << "seconds after a\n\t\treload (default 60)\n";
+}
+
 void s_error(const char *msg)
 {
-    perror(msg);
-    exit(1);
+  perror(msg);
+  exit(1);
 }
 
-static const char* parseAndClassifyString(char *txt)
+/** Milliseconds a request may take after it was read; 0 for no limit */
+static double requestTimeout = 0;
+
+/** Set by SIGHUP in a worker: finish the requests read, then exit */
+static volatile sig_atomic_t draining = 0;
+
+/** The signal mask of the workers, and of the new process of a reload */
+static sigset_t workerMask;
+
+/**
+ * Waits until the descriptor is readable
+ * A blocking worker keeps SIGHUP blocked, except during this wait, so a
+ *   drain request can not arrive between checking draining and blocking
+ * @param timeout In milliseconds, or -1 for none
+ * @return As poll(); -1 with EINTR after a signal
+ */
+static int waitReadable(int fd, int timeout)
 {
-    TreePtr tree;
-    std::ostringstream stream;
-    std::string str;
-    const char* result;
+  struct pollfd p;
+  p.fd = fd;
+  p.events = POLLIN;
+  struct timespec ts;
+  ts.tv_sec = timeout / 1000;
+  ts.tv_nsec = (timeout % 1000) * 1000000L;
+  return ppoll(& p, 1, (timeout >= 0 ? & ts : NULL), & workerMask);
+}
+
+/**
+ * Waits for the next request; a draining worker closes the connection
+ *   if the client sends nothing for DRAIN_IDLE_MS
+ * @return false if the connection should be closed
+ */
+static bool waitForRequest(int sock)
+{
+  while(true){
+    int n = waitReadable(sock, (draining ? DRAIN_IDLE_MS : -1));
+    if(n > 0) return true;
+    if(n == 0 || errno != EINTR) return false;
+  }
+}
 
+/**
+ * Labels one sentence with the given context
+ * @param arrival When the request was read (LatencyBudget::now() clock);
+ *                its deadline is requestTimeout after that
+ * @return FRAME_OK and the extended CoNLL output, or FRAME_FAILED and the
+ *         error message
+ */
+static FrameResult processSentence(SwirlContext & context, 
+				   const char * txt,
+				   double arrival)
+{
+  // the tokenizer does not accept empty sentences
+  if(strspn(txt, " \t\r\n") == strlen(txt)){
+    return FrameResult(FRAME_FAILED, "Empty sentence");
+  }
+
+  try{
     // classify all predicates in this sentence
-    tree = Swirl::parse(txt);
+    TreePtr tree;
+    if(requestTimeout > 0){
+      // the timeout only cuts the work short, it does not degrade it
+      LatencyBudget budget(requestTimeout, arrival, false);
+      if(budget.isExpired()){
+	// it waited too long already
+	PipelineStats::count(STAT_DEADLINE_EXPIRED);
+	return FrameResult(FRAME_FAILED, DEADLINE_EXPIRED_ERROR);
+      }
+      // a partial frame is no answer either
+      tree = context.parse(txt, budget);
+      if(budget.isCutShort()){
+	return FrameResult(FRAME_FAILED, DEADLINE_EXPIRED_ERROR);
+      }
+    } else {
+      tree = context.parse(txt);
+    }
 
     // dump extended CoNLL format
+    ostringstream stream;
     Swirl::serialize(tree, txt, stream);
-    str = stream.str();
-    result = str.c_str();
-    return result;
+    return FrameResult(FRAME_OK, stream.str());
+  } catch(Exception e){
+    return FrameResult(FRAME_FAILED, e.getMessage());
+  } catch(exception & e){
+    return FrameResult(FRAME_FAILED, e.what());
+  }
+}
+
+static string parseAndClassifyString(const char * txt)
+{
+  SwirlContext context(Swirl::getEngine());
+  FrameResult result = processSentence(context, txt, LatencyBudget::now());
+  if(result.status == FRAME_OK) return result.data;
+
+  CERR << "Failed to process sentence: " << txt << endl
+       << result.data << endl;
+
+  // an empty output, such that the client is not left waiting
+  return "\n";
+}
+
+/** Labeled to verify the models of a reload, unless --reload-probe is set */
+#define RELOAD_PROBE "3 The new models work ."
+
+/** Labels the probe sentence with the models just loaded */
+static bool verifyModels()
+{
+  String probe = RELOAD_PROBE;
+  Parameters::get("reload-probe", probe);
+  try{
+    SwirlContext context(Swirl::getEngine());
+    TreePtr tree = context.parse(probe.c_str());
+    if(tree == (const Tree *) NULL) return false;
+
+    ostringstream stream;
+    Swirl::serialize(tree, probe.c_str(), stream);
+    return ! stream.str().empty();
+  } catch(...){
+    return false;
+  }
+}
+
+/** Writes the whole buffer; false if the connection is gone */
+static bool writeAll(int sock, const string & data)
+{
+  size_t offset = 0;
+  while(offset < data.size()){
+    ssize_t n = write(sock, data.c_str() + offset, data.size() - offset);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    offset += n;
+  }
+  return true;
+}
+
+/**
+ * Reads newline-terminated requests from a socket
+ */
+class LineReader
+{
+ public:
+  LineReader(int sock, const string & initial) 
+    : mSock(sock), mBuffer(initial), mStart(0) {}
+
+  /**
+   * Fetches the next line, without its terminator
+   * @return false at the end of the connection, or if the line is
+   *         longer than MAX_LINE
+   */
+  bool next(string & line) {
+    while(true){
+      size_t end = mBuffer.find('\n', mStart);
+      if(end != string::npos){
+	line = mBuffer.substr(mStart, end - mStart);
+	if(! line.empty() && line[line.size() - 1] == '\r')
+	  line.erase(line.size() - 1);
+	mStart = end + 1;
+	return true;
+      }
+
+      if(mStart > 0){
+	mBuffer.erase(0, mStart);
+	mStart = 0;
+      }
+      if(mBuffer.size() > MAX_LINE){
+	CERR << "Request longer than " << MAX_LINE
+	     << " bytes. Closing connection." << endl;
+	return false;
+      }
+
+      if(! waitForRequest(mSock)) return false;
+
+      char chunk[4096];
+      ssize_t n = read(mSock, chunk, sizeof(chunk));
+      if(n < 0 && errno == EINTR) continue;
+      if(n == 0 && ! mBuffer.empty()){
+	// the last line before EOF needs no terminator
+	line.swap(mBuffer);
+	mBuffer.clear();
+	if(! line.empty() && line[line.size() - 1] == '\r')
+	  line.erase(line.size() - 1);
+	return true;
+      }
+      if(n <= 0) return false;
+      mBuffer.append(chunk, n);
+    }
+  }
+
+ private:
+  int mSock;
+  string mBuffer;
+  size_t mStart;
+};
+
+/**
+ * Serves framed connections, one at a time
+ * The calling thread reads the frames, and frameThreads threads, each
+ *   with its own SwirlContext, process them. Each response is sent as
+ *   soon as its frame is done, so with several threads responses may
+ *   come back out of order.
+ * With batchSize > 0, the sentences of the pending frames go through a
+ *   MicroBatcher instead, with frameThreads labeling threads.
+ */
+class FrameWorker
+{
+ public:
+  FrameWorker(int frameThreads, int maxPending,
+	      int batchSize, double batchWait, int maxQueued);
+
+  /**
+   * Serves one connection until the client closes it, or until an error
+   * @param initial Bytes already read from the connection
+   */
+  void serve(int sock, const string & initial);
+
+  /** NULL without batching */
+  MicroBatcher * getBatcher() { return mBatcher; }
+
+ private:
+  static void * work(void * worker);
+
+  void work();
+
+  /** Queues a frame; waits while too many frames are pending */
+  void submit(FrameRequest * request);
+
+  /** Sends the response of one frame, unless the connection is broken */
+  void respond(unsigned int id, const vector<FrameResult> & results);
+
+  friend class FrameJob;
+
+  int mMaxPending;
+
+  /** NULL without batching */
+  MicroBatcher * mBatcher;
+
+  int mSock;
+
+  pthread_mutex_t mMutex;
+
+  /** Broadcast every time the state below changes */
+  pthread_cond_t mChanged;
+
+  /** Frames read but not processed yet, with their arrival times */
+  list< pair<FrameRequest *, double> > mQueue;
+
+  /** Frames read but not answered yet */
+  int mPending;
+
+  /** Set when the connection can not be written anymore */
+  bool mBroken;
+
+  /** Serializes the responses */
+  pthread_mutex_t mWriteMutex;
+};
+
+/** A frame labeled by the micro-batcher */
+class FrameJob : public BatchJob
+{
+ public:
+  FrameJob(FrameWorker & worker, unsigned int id)
+    : mWorker(worker), mId(id) {}
+
+  void done() {
+    mWorker.respond(mId, results);
+    delete this;
+  }
+
+ private:
+  FrameWorker & mWorker;
+  unsigned int mId;
+};
+
+FrameWorker::FrameWorker(int frameThreads, int maxPending,
+			 int batchSize, double batchWait, int maxQueued)
+  : mMaxPending(maxPending), mBatcher(NULL), mSock(-1), mPending(0),
+    mBroken(false)
+{
+  pthread_mutex_init(& mMutex, NULL);
+  pthread_cond_init(& mChanged, NULL);
+  pthread_mutex_init(& mWriteMutex, NULL);
+
+  if(batchSize > 0){
+    mBatcher = new MicroBatcher(batchSize, batchWait, maxQueued, frameThreads);
+    return;
+  }
+
+  // the threads live as long as the worker process
+  for(int i = 0; i < frameThreads; i ++){
+    pthread_t t;
+    if(pthread_create(& t, NULL, work, this) != 0)
+      s_error("ERROR creating frame thread");
+    pthread_detach(t);
+  }
 }
 
+void * FrameWorker::work(void * worker)
+{
+  ((FrameWorker *) worker)->work();
+  return NULL;
+}
 
-void handle (int sock)
+void FrameWorker::work()
 {
-   int n;
-   char buffer[MAX_INPUT];
-    const char* processed;
-      
+  SwirlContext context(Swirl::getEngine());
 
-    bzero(buffer, MAX_INPUT);
-     n = read(sock, buffer, MAX_INPUT - 1);
-     if (n < 0) s_error("ERROR reading from socket");
-     printf("Here is the message: %s\n",buffer);
+  while(true){
+    pthread_mutex_lock(& mMutex);
+    while(mQueue.empty()) pthread_cond_wait(& mChanged, & mMutex);
+    FrameRequest * request = mQueue.front().first;
+    double arrival = mQueue.front().second;
+    mQueue.pop_front();
+    bool broken = mBroken;
+    pthread_mutex_unlock(& mMutex);
 
-     // parse
-     processed = parseAndClassifyString(buffer);
+    // nobody would read the response
+    vector<FrameResult> results;
+    if(! broken){
+      for(size_t i = 0; i < request->sentences.size(); i ++){
+	LOGH << "Request " << request->id << ": " 
+	     << request->sentences[i] << endl;
+	results.push_back
+	  (processSentence(context, request->sentences[i].c_str(), arrival));
+      }
+    }
 
-    cout << processed << endl;
-    cout << strlen(processed) << endl;
-     // respond
-     n = write(sock, processed, strlen(processed));
-     if (n < 0) s_error("ERROR writing to socket");
+    respond(request->id, results);
+    delete request;
+  }
 }
 
+void FrameWorker::respond(unsigned int id, const vector<FrameResult> & results)
+{
+  pthread_mutex_lock(& mMutex);
+  bool broken = mBroken;
+  int sock = mSock;
+  pthread_mutex_unlock(& mMutex);
 
-int main(int argc, char *argv[])
+  if(! broken){
+    FrameResponse response;
+    response.id = id;
+    response.results = results;
+    string frame;
+    encodeFrame(response, frame);
+
+    pthread_mutex_lock(& mWriteMutex);
+    broken = ! writeAll(sock, frame);
+    pthread_mutex_unlock(& mWriteMutex);
+  }
+
+  pthread_mutex_lock(& mMutex);
+  if(broken) mBroken = true;
+  mPending --;
+  pthread_cond_broadcast(& mChanged);
+  pthread_mutex_unlock(& mMutex);
+}
+
+void FrameWorker::submit(FrameRequest * request)
+{
+  // the deadline counts the wait for a free slot
+  double arrival = LatencyBudget::now();
+
+  pthread_mutex_lock(& mMutex);
+  while(mPending >= mMaxPending && ! mBroken){
+    pthread_cond_wait(& mChanged, & mMutex);
+  }
+  mPending ++;
+
+  // a frame without sentences asks for the stats
+  if(request->sentences.empty()){
+    pthread_mutex_unlock(& mMutex);
+    respond(request->id,
+	    vector<FrameResult>(1, FrameResult(FRAME_OK, 
+					       statsReport(mBatcher))));
+    delete request;
+    return;
+  }
+
+  if(mBatcher == NULL){
+    mQueue.push_back(make_pair(request, arrival));
+    pthread_cond_broadcast(& mChanged);
+    pthread_mutex_unlock(& mMutex);
+    return;
+  }
+  pthread_mutex_unlock(& mMutex);
+
+  for(size_t i = 0; i < request->sentences.size(); i ++){
+    LOGH << "Request " << request->id << ": " 
+	 << request->sentences[i] << endl;
+  }
+  FrameJob * job = new FrameJob(* this, request->id);
+  job->sentences.swap(request->sentences);
+  if(requestTimeout > 0) job->deadline = arrival + requestTimeout;
+  delete request;
+
+  // waits while too many sentences are queued for a batch
+  mBatcher->submit(job);
+}
+
+void FrameWorker::serve(int sock, const string & initial)
+{
+  pthread_mutex_lock(& mMutex);
+  mSock = sock;
+  mBroken = false;
+  pthread_mutex_unlock(& mMutex);
+
+  FrameDecoder decoder;
+  decoder.append(initial.data(), initial.size());
+
+  try{
+    while(true){
+      FrameRequest * request = new FrameRequest;
+      while(decoder.next(* request)){
+	submit(request);
+	request = new FrameRequest;
+      }
+      delete request;
+
+      pthread_mutex_lock(& mMutex);
+      bool broken = mBroken;
+      pthread_mutex_unlock(& mMutex);
+      if(broken || ! waitForRequest(sock)) break;
+
+      char chunk[4096];
+      ssize_t n = read(sock, chunk, sizeof(chunk));
+      if(n < 0 && errno == EINTR) continue;
+      if(n <= 0) break;
+      decoder.append(chunk, n);
+    }
+    if(decoder.pending() > 0){
+      CERR << "Connection closed in the middle of a frame." << endl;
+    }
+  } catch(exception & e){
+    CERR << "Closing connection: " << e.what() << endl;
+  }
+
+  // the responses of the frames already read are still sent
+  pthread_mutex_lock(& mMutex);
+  while(mPending > 0) pthread_cond_wait(& mChanged, & mMutex);
+  mSock = -1;
+  pthread_mutex_unlock(& mMutex);
+
+  if(mBatcher != NULL && Logger::getVerbosity() > 1){
+    mBatcher->printStats(Logger::logStream());
+  }
+}
+
+/** Created by the first framed connection of a worker */
+static FrameWorker * frameWorker = NULL;
+static int frameThreads = 1;
+static int maxPendingFrames = 16;
+static int batchSize = 0;
+static double batchWait = 2;
+static int maxQueued = 256;
+static bool eventLoop = false;
+
+/**
+ * In the event loop, the drain signal must interrupt epoll_wait() in the
+ *   main thread, so the helper threads are created with it blocked
+ */
+static void blockDrainSignal(bool block)
 {
-     int sockfd, newsockfd, portno, pid;
-     socklen_t clilen;
-     struct sockaddr_in serv_addr, cli_addr;
-     int n;
-
-    int idx = -1;
-
-    try{
-        idx = Parameters::read(argc, argv);
-    } catch(...){
-        CERR << "Exiting..." << endl;
-        exit(-1);
-    }
-
-    int verbosity = 0;
-    Parameters::get("verbose", verbosity);
-    Logger::setVerbosity(verbosity);
-
-    //String classifierType = "ab";
-    //Parameters::get("classifier", classifierType);
-
-    bool caseSensitive = true; // default: case sensitive
-    if(Parameters::contains("case-insensitive")) caseSensitive = false;
-
-    if(idx > argc - 2){
-        CERR << "wrong args" << endl;
-        exit(-1);
-    }
-
-    if(! Swirl::initialize(argv[idx + 0], argv[idx + 1], caseSensitive)){ 
-        cerr << "Failed to initialize SRL system!\n";
-        exit(1);
-    } 
-    cout << "Ready!" << endl;
-
-    // server code
-     sockfd = socket(AF_INET, SOCK_STREAM, 0);
-     if (sockfd < 0) 
-        s_error("ERROR opening socket");
-     bzero((char *) &serv_addr, sizeof(serv_addr));
-
-     portno = 2718;
-     Parameters::get("port", portno);
-
-     serv_addr.sin_family = AF_INET;
-     serv_addr.sin_addr.s_addr = INADDR_ANY;
-     serv_addr.sin_port = htons(portno);
-     if (bind(sockfd, (struct sockaddr *) &serv_addr,
-              sizeof(serv_addr)) < 0) 
-              s_error("ERROR on binding");
-     listen(sockfd,5);
-     clilen = sizeof(cli_addr);
-
-
-     while (1) {
-         newsockfd = accept(sockfd, 
-               (struct sockaddr *) &cli_addr, &clilen);
-         if (newsockfd < 0) 
-             s_error("ERROR on accept");
-         pid = fork();
-         if (pid < 0)
-             s_error("ERROR on fork");
-         if (pid == 0)  {
-             close(sockfd);
-             handle(newsockfd);
-             exit(0);
-         }
-         else close(newsockfd);
-     } /* end of while */
-     close(sockfd);
-     return 0; /* we never get here */
+  sigset_t set;
+  sigemptyset(& set);
+  sigaddset(& set, SIGHUP);
+  pthread_sigmask(block ? SIG_BLOCK : SIG_UNBLOCK, & set, NULL);
 }
 
+/** Answers all the requests of one connection, in either protocol */
+static void serveConnection(int sock)
+{
+  // the first bytes tell the protocol
+  string initial;
+  while(initial.size() < 4 && 
+	startsWithRequestMagic(initial.data(), initial.size())){
+    if(! waitForRequest(sock)) return;
+    char chunk[4096];
+    ssize_t n = read(sock, chunk, sizeof(chunk));
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return;
+    initial.append(chunk, n);
+  }
+
+  if(startsWithRequestMagic(initial.data(), initial.size())){
+    // the threads inherit the blocked drain signal
+    if(frameWorker == NULL){
+      frameWorker = new FrameWorker(frameThreads, maxPendingFrames,
+				    batchSize, batchWait, maxQueued);
+    }
+    frameWorker->serve(sock, initial);
+    return;
+  }
+
+  LineReader reader(sock, initial);
+  string line;
+  while(reader.next(line)){
+    if(line == STATS_REQUEST){
+      MicroBatcher * batcher = 
+	(frameWorker != NULL ? frameWorker->getBatcher() : NULL);
+      if(! writeAll(sock, statsReport(batcher) + "\n")) break;
+      continue;
+    }
+    if(line == RELOAD_REQUEST){
+      if(! writeAll(sock, requestReload())) break;
+      continue;
+    }
+
+    LOGH << "Request: " << line << endl;
+    if(! writeAll(sock, parseAndClassifyString(line.c_str()))) break;
+  }
+}
+
+/** Answers the single request of a connection, as the old server did */
+static void handle(int sock)
+{
+  char buffer[MAX_LINE];
+  int n;
+
+  do {
+    n = read(sock, buffer, MAX_LINE - 1);
+  } while(n < 0 && errno == EINTR);
+  if(n < 0) s_error("ERROR reading from socket");
+  buffer[n] = '\0';
+  LOGH << "Request: " << buffer << endl;
+
+  if(! writeAll(sock, parseAndClassifyString(buffer)))
+    s_error("ERROR writing to socket");
+}
+
+/** The event loop of this worker, if any */
+static EventServer * eventServer = NULL;
+
+static void drainHandler(int)
+{
+  draining = 1;
+  if(eventServer != NULL) eventServer->drain();
+}
+
+/** The loop of one pre-forked worker; exits once drained */
+static void workerLoop(int sockfd)
+{
+  // a client that disconnects early must not kill the worker
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGINT, SIG_DFL);
+  signal(SIGCHLD, SIG_DFL);
+
+  // no SA_RESTART: the blocking calls must return when we are drained
+  struct sigaction action;
+  memset(& action, 0, sizeof(action));
+  action.sa_handler = drainHandler;
+  sigemptyset(& action.sa_mask);
+  sigaction(SIGHUP, & action, NULL);
+  sigprocmask(SIG_SETMASK, & workerMask, NULL);
+
+  if(eventLoop){
+    blockDrainSignal(true);
+    MicroBatcher batcher(batchSize > 0 ? batchSize : 32,
+			 batchWait, maxQueued, frameThreads);
+    blockDrainSignal(false);
+    EventServer server(sockfd, maxPendingFrames, requestTimeout, batcher);
+    eventServer = & server;
+    if(draining) server.drain();
+    server.run();
+    exit(0);
+  }
+
+  // SIGHUP is only delivered in waitReadable()
+  sigset_t blocked = workerMask;
+  sigaddset(& blocked, SIGHUP);
+  sigprocmask(SIG_SETMASK, & blocked, NULL);
+
+  while(! draining){
+    if(waitReadable(sockfd, -1) <= 0) continue;
+
+    // the socket is non-blocking: another worker may have taken it
+    struct sockaddr_in cli_addr;
+    socklen_t clilen = sizeof(cli_addr);
+    int newsockfd = accept(sockfd, (struct sockaddr *) &cli_addr, &clilen);
+    if(newsockfd < 0){
+      if(errno == EINTR || errno == ECONNABORTED || 
+	 errno == EAGAIN || errno == EWOULDBLOCK) continue;
+      s_error("ERROR on accept");
+    }
+
+    serveConnection(newsockfd);
+    close(newsockfd);
+  }
+  exit(0);
+}
+
+/** Set by SIGTERM and SIGINT */
+static volatile sig_atomic_t stopping = 0;
+
+/** Set by SIGHUP: load the models again */
+static volatile sig_atomic_t reloadRequested = 0;
+
+static void supervisorHandler(int signal)
+{
+  if(signal == SIGHUP) reloadRequested = 1;
+  else if(signal == SIGTERM || signal == SIGINT) stopping = 1;
+  // SIGCHLD only ends the wait
+}
+
+/** Arguments of this process, passed on when it runs itself again */
+static char ** serverArgv = NULL;
+
+/** The program of this process, so that it keeps its name in ps */
+static string serverPath;
+
+/**
+ * A field of a /proc file of this process, in kB, e.g. "VmHWM:" of 
+ *   status; 0 if not available
+ */
+static long procMemory(pid_t pid, const char * file, const char * field)
+{
+  ostringstream path;
+  path << "/proc/" << pid << "/" << file;
+  ifstream is(path.str().c_str());
+  string line;
+  size_t length = strlen(field);
+  while(getline(is, line)){
+    if(line.compare(0, length, field) == 0) return atol(line.c_str() + length);
+  }
+  return 0;
+}
+
+/** Memory of a process, with the pages it shares counted in proportion */
+static long processMemory(pid_t pid)
+{
+  long kb = procMemory(pid, "smaps_rollup", "Pss:");
+  if(kb == 0) kb = procMemory(pid, "status", "VmRSS:");
+  return kb;
+}
+
+static pid_t startWorker(int sockfd)
+{
+  pid_t pid = fork();
+  if(pid < 0) s_error("ERROR on fork");
+  if(pid == 0){
+    workerLoop(sockfd);
+    exit(0);
+  }
+  return pid;
+}
+
+/** The arguments that the server only passes to itself */
+static bool isInternalArgument(const char * arg)
+{
+  return (strncmp(arg, "--listen-fd=", 12) == 0 ||
+	  strncmp(arg, "--drain-workers=", 16) == 0 ||
+	  strcmp(arg, "--verify-models") == 0);
+}
+
+/**
+ * Replaces the image of this process with this program, started with
+ *   the given internal arguments and the original ones
+ * Returns only if exec() failed
+ */
+static void execServer(const vector<string> & internal)
+{
+  vector<char *> args;
+  args.push_back(serverArgv[0]);
+  for(size_t i = 0; i < internal.size(); i ++){
+    args.push_back((char *) internal[i].c_str());
+  }
+  for(int i = 1; serverArgv[i] != NULL; i ++){
+    if(! isInternalArgument(serverArgv[i])) args.push_back(serverArgv[i]);
+  }
+  args.push_back(NULL);
+
+  execv(serverPath.c_str(), & args[0]);
+  perror("ERROR on exec");
+}
+
+/**
+ * Loads the models again in a new process, which labels the probe
+ *   sentence and exits with status 0 if the new models work
+ * @return The new process, or 0 if it could not be started
+ */
+static pid_t startVerifier()
+{
+  pid_t pid = fork();
+  if(pid < 0){
+    perror("ERROR on fork");
+    return 0;
+  }
+  if(pid > 0) return pid;
+
+  // never outlive the supervisor
+  prctl(PR_SET_PDEATHSIG, SIGTERM);
+  sigprocmask(SIG_SETMASK, & workerMask, NULL);
+  execServer(vector<string>(1, "--verify-models"));
+  _exit(1);
+}
+
+/**
+ * Runs this program again in this process, so the process id of the 
+ *   server does not change. The new image loads the models, starts its
+ *   workers, and then drains the given workers, which stay its children.
+ * The signals stay blocked across exec(), so a SIGTERM received while 
+ *   the new image loads stops it once it supervises.
+ * Returns only if exec() failed
+ */
+static void restartServer(int sockfd, const vector<pid_t> & oldWorkers)
+{
+  ostringstream listenArg;
+  listenArg << "--listen-fd=" << sockfd;
+  ostringstream drainArg;
+  drainArg << "--drain-workers=";
+  for(size_t i = 0; i < oldWorkers.size(); i ++){
+    if(i > 0) drainArg << ",";
+    drainArg << oldWorkers[i];
+  }
+
+  vector<string> internal;
+  internal.push_back(listenArg.str());
+  internal.push_back(drainArg.str());
+  execServer(internal);
+}
+
+/**
+ * Reports the memory used while a reload holds both model sets, which 
+ *   is its peak
+ * @param loaded The peak resident memory of the verifier, in kB
+ */
+static void reportReloadMemory(const vector<pid_t> & workers,
+			       long loaded)
+{
+  long current = processMemory(getpid());
+  for(size_t i = 0; i < workers.size(); i ++){
+    current += processMemory(workers[i]);
+  }
+  CERR << "New models verified. Peak memory during the reload: about "
+       << (current + loaded) / 1024 << " MB (current models "
+       << current / 1024 << " MB, new models " << loaded / 1024
+       << " MB at their peak)." << endl;
+}
+
+/**
+ * Keeps workerCount workers alive, until SIGTERM or SIGINT. A reload
+ *   that verifies the new models restarts this process in place.
+ * @param oldWorkers The workers of the previous image, after a reload:
+ *                   they finish the requests they have read, and exit
+ */
+static void superviseWorkers(int sockfd, int workerCount,
+			     vector<pid_t> oldWorkers)
+{
+  //
+  // the signals are blocked, except while waiting, so that none 
+  //   arrives between checking the flags and waiting
+  // no SA_RESTART: the wait must return
+  //
+  struct sigaction action;
+  memset(& action, 0, sizeof(action));
+  action.sa_handler = supervisorHandler;
+  sigemptyset(& action.sa_mask);
+  int signals[] = { SIGTERM, SIGINT, SIGHUP, SIGCHLD };
+  sigset_t blocked;
+  sigemptyset(& blocked);
+  for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i ++){
+    sigaction(signals[i], & action, NULL);
+    sigaddset(& blocked, signals[i]);
+  }
+  sigprocmask(SIG_BLOCK, & blocked, & workerMask);
+  // after a reload they were blocked across exec() already
+  for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i ++){
+    sigdelset(& workerMask, signals[i]);
+  }
+
+  vector<pid_t> workers(workerCount);
+  vector<time_t> started(workerCount);
+  for(int i = 0; i < workerCount; i ++){
+    workers[i] = startWorker(sockfd);
+    started[i] = time(NULL);
+  }
+  CERR << "Process " << getpid() << " started " << workerCount
+       << " workers." << endl;
+
+  // the old workers stop accepting connections, and exit once idle
+  int drainTimeout = 60;
+  Parameters::get("drain-timeout", drainTimeout);
+  time_t drainDeadline = time(NULL) + drainTimeout;
+  bool drainKilled = false;
+  for(size_t i = 0; i < oldWorkers.size(); i ++) kill(oldWorkers[i], SIGHUP);
+
+  pid_t verifier = 0;
+  while(! stopping){
+    int status = 0;
+    struct rusage usage;
+    pid_t pid = wait4(-1, & status, WNOHANG, & usage);
+    if(pid < 0 && errno != ECHILD) s_error("ERROR on waitpid");
+    if(pid <= 0){
+      if(reloadRequested){
+	reloadRequested = 0;
+	if(verifier != 0){
+	  CERR << "A reload is in progress already." << endl;
+	} else {
+	  CERR << "Reloading the models..." << endl;
+	  verifier = startVerifier();
+	}
+	continue;
+      }
+
+      if(oldWorkers.empty()){
+	sigsuspend(& workerMask);
+	continue;
+      }
+
+      // idle persistent connections would hold an old worker forever
+      if(! drainKilled && time(NULL) >= drainDeadline){
+	CERR << "Killing " << oldWorkers.size() 
+	     << " old workers still busy..." << endl;
+	for(size_t i = 0; i < oldWorkers.size(); i ++){
+	  kill(oldWorkers[i], SIGTERM);
+	}
+	drainKilled = true;
+      }
+      struct timespec tick = { 1, 0 };
+      ppoll(NULL, 0, & tick, & workerMask);
+      continue;
+    }
+
+    if(pid == verifier){
+      verifier = 0;
+      if(! WIFEXITED(status) || WEXITSTATUS(status) != 0){
+	CERR << "Reload failed. Keeping the current models." << endl;
+	continue;
+      }
+      reportReloadMemory(workers, usage.ru_maxrss);
+
+      // the requests in flight finish on the current models
+      vector<pid_t> draining(oldWorkers);
+      draining.insert(draining.end(), workers.begin(), workers.end());
+      CERR << "Restarting process " << getpid() 
+	   << " on the new models..." << endl;
+      restartServer(sockfd, draining);
+      CERR << "Keeping the current models." << endl;
+      continue;
+    }
+
+    vector<pid_t>::iterator old = 
+      find(oldWorkers.begin(), oldWorkers.end(), pid);
+    if(old != oldWorkers.end()){
+      oldWorkers.erase(old);
+      if(oldWorkers.empty()){
+	CERR << "Old workers drained. Released the old models." << endl;
+      }
+      continue;
+    }
+
+    for(int i = 0; i < workerCount; i ++){
+      if(workers[i] != pid) continue;
+
+      if(WIFSIGNALED(status)){
+	CERR << "Worker " << pid << " killed by signal "
+	     << WTERMSIG(status) << ". Restarting..." << endl;
+      } else {
+	CERR << "Worker " << pid << " exited with status "
+	     << WEXITSTATUS(status) << ". Restarting..." << endl;
+      }
+
+      // do not spin if the worker dies right away
+      if(time(NULL) - started[i] < MIN_WORKER_LIFE) sleep(MIN_WORKER_LIFE);
+      if(stopping) break;
+
+      workers[i] = startWorker(sockfd);
+      started[i] = time(NULL);
+    }
+  }
+
+  CERR << "Stopping workers..." << endl;
+  for(int i = 0; i < workerCount; i ++) kill(workers[i], SIGTERM);
+  for(size_t i = 0; i < oldWorkers.size(); i ++) kill(oldWorkers[i], SIGTERM);
+  if(verifier != 0) kill(verifier, SIGTERM);
+  while(waitpid(-1, NULL, 0) > 0 || errno == EINTR);
+}
+
+/** Forks one process per connection; never returns */
+static void forkPerRequest(int sockfd)
+{
+  // the children are reaped automatically
+  signal(SIGCHLD, SIG_IGN);
+
+  while (1) {
+    // the listening socket is non-blocking
+    struct pollfd fd;
+    fd.fd = sockfd;
+    fd.events = POLLIN;
+    if(poll(& fd, 1, -1) <= 0) continue;
+
+    struct sockaddr_in cli_addr;
+    socklen_t clilen = sizeof(cli_addr);
+    int newsockfd = accept(sockfd, (struct sockaddr *) &cli_addr, &clilen);
+    if (newsockfd < 0){
+      if(errno == EINTR || errno == ECONNABORTED ||
+	 errno == EAGAIN || errno == EWOULDBLOCK) continue;
+      s_error("ERROR on accept");
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+      s_error("ERROR on fork");
+    if (pid == 0)  {
+      close(sockfd);
+      handle(newsockfd);
+      exit(0);
+    }
+    else close(newsockfd);
+  } /* end of while */
+}
+
+int main(int argc, char *argv[])
+{
+  int sockfd, portno;
+  struct sockaddr_in serv_addr;
+
+  int idx = -1;
+  serverArgv = argv;
+  char path[4096];
+  ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  serverPath = (length > 0 ? string(path, length) : "/proc/self/exe");
+
+  try{
+    idx = Parameters::read(argc, argv);
+  } catch(...){
+    CERR << "Exiting..." << endl;
+    exit(-1);
+  }
+
+  if(Parameters::contains(W("help"))){
+    usage(argv[0]);
+    exit(-1);
+  }
+
+  int verbosity = 0;
+  Parameters::get("verbose", verbosity);
+  Logger::setVerbosity(verbosity);
+
+  bool caseSensitive = true; // default: case sensitive
+  if(Parameters::contains("case-insensitive")) caseSensitive = false;
+
+  int workerCount = 0; // default: one process per request
+  Parameters::get("workers", workerCount);
+  if(workerCount < 0){
+    cerr << "Invalid number of workers: " << workerCount << endl;
+    exit(-1);
+  }
+
+  // the event loop runs in the workers
+  if(Parameters::contains("event-loop")){
+    eventLoop = true;
+    if(workerCount == 0) workerCount = 1;
+  }
+
+  Parameters::get("frame-threads", frameThreads);
+  Parameters::get("max-pending-frames", maxPendingFrames);
+  if(frameThreads < 1 || maxPendingFrames < 1){
+    cerr << "Invalid frame threads or pending frames!" << endl;
+    exit(-1);
+  }
+
+  Parameters::get("batch-size", batchSize);
+  Parameters::get("batch-wait", batchWait);
+  Parameters::get("max-queued", maxQueued);
+  Parameters::get("request-timeout", requestTimeout);
+  if(batchSize < 0 || batchWait < 0 || maxQueued < 1){
+    cerr << "Invalid batch size, batch wait, or queue size!" << endl;
+    exit(-1);
+  }
+
+  //
+  // internal arguments of a reload: the verifier only loads the models
+  //   and labels the probe; the restarted supervisor inherits the 
+  //   listening socket and the workers to drain
+  //
+  bool verifyOnly = Parameters::contains("verify-models");
+  int listenFd = -1;
+  Parameters::get("listen-fd", listenFd);
+  vector<pid_t> oldWorkers;
+  String drainList;
+  Parameters::get("drain-workers", drainList);
+  istringstream drainStream(drainList.c_str());
+  pid_t oldWorker;
+  char comma;
+  while(drainStream >> oldWorker){
+    oldWorkers.push_back(oldWorker);
+    drainStream >> comma;
+  }
+
+  if(idx > argc - 2){
+    usage(argv[0]);
+    exit(-1);
+  }
+
+  // loaded once, and shared by all processes forked below
+  if(! Swirl::initialize(argv[idx + 0], argv[idx + 1], caseSensitive)){
+    cerr << "Failed to initialize SRL system!\n";
+    // the model files changed since they were verified: nobody would
+    //   supervise the old workers
+    for(size_t i = 0; i < oldWorkers.size(); i ++){
+      kill(oldWorkers[i], SIGHUP);
+    }
+    exit(1);
+  }
+
+  // the old models keep serving if the new ones do not work
+  if(verifyOnly){
+    if(! verifyModels()){
+      cerr << "The new models failed to label the probe sentence!" << endl;
+      exit(1);
+    }
+    exit(0);
+  }
+
+  // server code
+  if(listenFd >= 0){
+    sockfd = listenFd;
+  } else {
+    // non-blocking, so that a worker never blocks in accept() while the
+    //   connection it was woken up for goes to another worker
+    sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0)
+      s_error("ERROR opening socket");
+    int reuse = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, & reuse, sizeof(reuse));
+    bzero((char *) &serv_addr, sizeof(serv_addr));
+
+    portno = 2718;
+    Parameters::get("port", portno);
+
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_addr.s_addr = INADDR_ANY;
+    serv_addr.sin_port = htons(portno);
+    if (bind(sockfd, (struct sockaddr *) &serv_addr,
+	     sizeof(serv_addr)) < 0)
+      s_error("ERROR on binding");
+    listen(sockfd, SOMAXCONN);
+  }
+  cout << "Ready!" << endl;
+
+  if(workerCount > 0){
+    superviseWorkers(sockfd, workerCount, oldWorkers);
+  } else {
+    forkPerRequest(sockfd);
+  }
+
+  close(sockfd);
+  return 0;
+}
@@ -5,6 +5,7 @@
  */
 
 #include <iostream>
+#include <cstdlib>
 #include <vector>
 
 #include "Parameters.h"
@@ -0,0 +1,52 @@
+/**
+ * This program compiles the lexicon of a trained model into the binary
+ *   snapshot (lexicon.frozen) loaded at inference time
+ */
+
+#include <iostream>
+#include <cstdlib>
+
+#include "Lexicon.h"
+#include "Parameters.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+static void usage(const char * name)
+{
+  CERR << "Usage: " << name << " <srl model directory>" << endl;
+}
+
+int main(int argc,
+	 char ** argv)
+{
+  int idx = -1;
+
+  try{
+    idx = Parameters::read(argc, argv);
+  } catch(...){
+    CERR << "Exiting..." << endl;
+    exit(-1);
+  }
+
+  if(Parameters::contains(W("help")) || idx > argc - 1){
+    usage(argv[0]);
+    exit(-1);
+  }
+
+  string modelPath = argv[idx];
+
+  try{
+    // a stale snapshot would be loaded instead of the text files
+    Lexicon::removeFrozen(modelPath);
+    Lexicon::initialize(modelPath, true);
+    Lexicon::saveFrozen(modelPath);
+  } catch(...){
+    CERR << "Exception caught in main. Exiting..." << endl;
+    exit(-1);
+  }
+
+  cerr << "Saved " << modelPath << "/lexicon.frozen" << endl;
+  return 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * Microbenchmark: the open-addressing StringMap vs. the old node-based map
+ * Uses the word and lemma counts from a SwiRL model directory as keys.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <sys/time.h>
+
+#include "Constants.h"
+#include "CharUtils.h"
+#include "StringMap.h"
+#include "HashStringMap.h"
+
+using namespace std;
+using namespace srl;
+
+static void usage(const char * name)
+{
+  CERR << "Usage: " << name << " <srl model directory> [<lookup rounds>]\n";
+}
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(& tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void readCounts(const String & fileName,
+		       vector<String> & keys,
+		       vector<int> & counts)
+{
+  ifstream is(fileName.c_str());
+  if(! is){
+    cerr << "Can not open file: " << fileName << endl;
+    exit(-1);
+  }
+
+  char line[MAX_CONLL_LINE];
+  while(is.getline(line, MAX_CONLL_LINE)){
+    vector<String> tokens;
+    simpleTokenize(line, tokens, " \t\n\r");
+    if(tokens.size() == 2){
+      keys.push_back(tokens[0]);
+      counts.push_back(strtol(tokens[1].c_str(), NULL, 10));
+    }
+  }
+}
+
+template <class M>
+static void bench(const char * name,
+		  const vector<String> & keys,
+		  const vector<int> & counts,
+		  const vector<String> & misses,
+		  int rounds)
+{
+  double start = now();
+  M * map = new M();
+  for(size_t i = 0; i < keys.size(); i ++){
+    map->set(keys[i].c_str(), counts[i]);
+  }
+  double loaded = now();
+
+  long long sum = 0;
+  for(int r = 0; r < rounds; r ++){
+    for(size_t i = 0; i < keys.size(); i ++){
+      int count = 0;
+      if(map->get(keys[i].c_str(), count)) sum += count;
+    }
+  }
+  double hits = now();
+
+  int found = 0;
+  for(int r = 0; r < rounds; r ++){
+    for(size_t i = 0; i < misses.size(); i ++){
+      if(map->contains(misses[i].c_str())) found ++;
+    }
+  }
+  double missed = now();
+
+  delete map;
+  double freed = now();
+
+  double lookups = (double) keys.size() * rounds;
+  cout << name << ":\n"
+       << "\tinsert " << keys.size() << " keys: "
+       << (loaded - start) * 1000.0 << " ms\n"
+       << "\thit lookups: " << (hits - loaded) * 1e9 / lookups << " ns/op"
+       << " (checksum " << sum << ")\n"
+       << "\tmiss lookups: " << (missed - hits) * 1e9 / lookups << " ns/op"
+       << " (false hits " << found << ")\n"
+       << "\tdestroy: " << (freed - missed) * 1000.0 << " ms\n";
+}
+
+int main(int argc,
+	 char ** argv)
+{
+  if(argc < 2){
+    usage(argv[0]);
+    exit(-1);
+  }
+
+  String modelPath = argv[1];
+  int rounds = 20;
+  if(argc > 2) rounds = strtol(argv[2], NULL, 10);
+
+  vector<String> keys;
+  vector<int> counts;
+  readCounts(mergeStrings(modelPath, "/word.counts"), keys, counts);
+  readCounts(mergeStrings(modelPath, "/lemma.counts"), keys, counts);
+
+  // the same keys with a suffix that never appears in the data
+  vector<String> misses;
+  for(size_t i = 0; i < keys.size(); i ++) misses.push_back(keys[i] + "#");
+
+  cout << "Loaded " << keys.size() << " keys, "
+       << rounds << " lookup rounds.\n";
+
+  bench< HashStringMap<int> >("HashStringMap (node-based)",
+			      keys, counts, misses, rounds);
+  bench< StringMap<int> >("StringMap (open addressing)",
+			  keys, counts, misses, rounds);
+
+  return 0;
+}
@@ -24,7 +24,9 @@ static void usage(const char * name)
   CERR << "Valid parameters:" << endl 
        << "\tverbose - Set verbosity level" << endl
        << "\tclassifier = ab | svm" << endl
-       << "\tcase-insensitive - use case-insensitive models" << endl;
+       << "\tcase-insensitive - use case-insensitive models" << endl
+       << "\texact-inference - find the best frame with A* search, "
+       << "instead of the beam" << endl;
 }
 
 int main(int argc,
@@ -52,6 +54,8 @@ int main(int argc,
   bool caseSensitive = true; // default: case sensitive
   if(Parameters::contains("case-insensitive")) caseSensitive = false;
 
+  if(Parameters::contains("exact-inference")) Tree::setExactInference(true);
+
   if(idx > argc - 2){
     usage(argv[0]);
     exit(-1);
@@ -155,6 +159,7 @@ int main(int argc,
     }
     
     CERR << "Done. Processed " << count - 1 << " sentences." << endl;
+    Tree::printInferenceStats(CERR);
     if(verbosity > 0) Tree::dumpScoringStats(Logger::logStream());
 
   } catch(Exception e){
@@ -22,7 +22,9 @@ static void usage(const char * name)
   CERR << "Usage: " << name << " [ <parameters> ] " 
        << " <input parsed file with args> <model directory>" <<  endl;
   CERR << "Valid parameters:" << endl
-       << "\tcase-insensitive - generate case-insensitive models" << endl;
+       << "\tcase-insensitive - generate case-insensitive models" << endl
+       << "\tfeature-hash-bits - hash features into 2^N indices, no lexicon" << endl
+       << "\tfeature-hash-collisions - report collisions of hashed features" << endl;
   CERR << "Note: use the convertToTreebank program to generate the parse/arg file" << endl;
   CERR << endl;
 }
@@ -83,6 +85,11 @@ int main(int argc,
 
   Lexicon::initialize(modelPath, false);
 
+  int hashBits = 0;
+  Parameters::get("feature-hash-bits", hashBits);
+  Lexicon::setFeatureHashBits(hashBits, 
+			      Parameters::contains("feature-hash-collisions"));
+
   TreePtr tree;
   vector<TreePtr> sentence;
   int count = 0;
@@ -131,6 +138,10 @@ int main(int argc,
       RASSERT(featStream, "Failed to create feature lexicon stream!");
       Lexicon::saveFeatureLexicon(featStream);
       featStream.close();
+      Lexicon::saveFeatureHashing(modelPath);
+      Lexicon::reportFeatureHashing(cerr);
+      // a snapshot of the old feature lexicon would hide the new one
+      Lexicon::removeFrozen(modelPath);
     } // GENERATE_SAMPLE_FILE
 
   } catch(Exception e){
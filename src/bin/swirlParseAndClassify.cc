@@ -4,7 +4,15 @@
  */
 
 #include <iostream>
+#include <sstream>
+#include <cstdlib>
 #include <cstring>
+#include <cstdio>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
  
 #include "Constants.h"
 #include "Parameters.h"
@@ -14,12 +22,18 @@
 #include "Logger.h"
 #include "Swirl.h"
 #include "Oracle.h"
+#include "PipelineStats.h"
+#include "FrameProtocol.h"
+#include "MicroBatcher.h"
  
 using namespace std;
 using namespace srl;
 
 #define MAX_LINE (16 * 1024)
 
+/** Sentences of a data file read at a time, so large files fit in memory */
+#define FILE_CHUNK 4096
+
 static void usage(const char * name)
 {
   CERR << "Usage: " << name << " [ <parameters> ] " 
@@ -28,40 +42,128 @@ static void usage(const char * name)
   CERR << "Valid parameters:\n"
        << "\tverbose - Set verbosity level\n"
        << "\tno-prompt - do not display the shell prompt\n"
+       << "\tframed - instead of the shell, read request frames from stdin "
+       << "and write\n\t\tresponse frames with compact argument records "
+       << "to stdout\n"
+       << "\trecords - in framed mode, answer with result records, which "
+       << "also hold the\n\t\ttokens, lemmas and POS tags\n"
+       << "\tbatch-size - in framed mode, label the sentences in batches of "
+       << "up to this many\n\t\tsentences (default 32)\n"
+       << "\tbatch-wait - in framed mode, close a batch this many "
+       << "milliseconds after its\n\t\tfirst sentence arrived (default 2)\n"
+       << "\tmax-queued - in framed mode, stop reading stdin while this many "
+       << "sentences\n\t\twait for a batch (default 256)\n"
        << "\tcase-insensitive - use case-insensitive models\n" 
-       << "\tgold-props - run in oracle mode using these gold propositions\n";
+       << "\tgold-props - run in oracle mode using these gold propositions\n"
+       << "\tpredicate-threads - classify the predicates of a sentence "
+       << "using this many threads\n"
+       << "\tlabel-threads - label this many sentences of the data file "
+       << "at the same time\n"
+       << "\tformat-threads - format the output of this many sentences of "
+       << "the data file\n\t\tat the same time (default 1)\n"
+       << "\texact-inference - find the best frame with A* search, "
+       << "instead of the beam\n"
+       << "\tlatency-budget - in the shell, try to process each sentence "
+       << "in this many milliseconds\n"
+       << "\tcache-size - in the shell, reuse the outputs of up to this many "
+       << "sentences\n\t\t(the Treebank output is not displayed)\n"
+       << "\tcache-file - keep the cached outputs in this file, across runs\n"
+       << "\tlabels - in the shell, consider only these comma-separated "
+       << "argument labels\n"
+       << "\tstats-interval - display the counters and latency histograms "
+       << "of each stage\n\t\tevery this many seconds, and at the end\n";
+}
+
+/** Seconds between two dumps of the pipeline stats; 0 for never */
+static int statsInterval = 0;
+static time_t lastStatsDump = 0;
+
+/**
+ * Dumps the pipeline stats to stderr, if statsInterval seconds passed
+ *   since the last dump, or if forced
+ */
+static void dumpStats(bool force)
+{
+  if(statsInterval <= 0) return;
+  time_t now = time(NULL);
+  if(! force && now - lastStatsDump < statsInterval) return;
+  lastStatsDump = now;
+
+  CERR << "Pipeline stats:" << endl;
+  PipelineStats::print(CERR);
 }
 
+/**
+ * Dumps the CoNLL output of each sentence, in input order
+ */
+class FileCallback : public SwirlBatchCallback
+{
+ public:
+  /**
+   * @param sentences The chunk of the data file being processed
+   * @param first Position of the chunk in the file
+   */
+  FileCallback(const vector<string> & sentences, size_t first)
+    : mSentences(sentences), mFirst(first) {}
+
+  void emit(size_t index,
+	    const TreePtr & tree,
+	    const string & output)
+  {
+    RVASSERT(tree != (const Tree *) NULL,
+	     "Failed to parse line: " << mSentences[index]);
+
+    // dump CoNLL format
+    cout << output;
+
+    if((mFirst + index + 1) % 100 == 0){
+      CERR << "Processed " << mFirst + index + 1 << " sentences..." << endl;
+    }
+    dumpStats(false);
+  }
+
+ private:
+  const vector<string> & mSentences;
+  size_t mFirst;
+};
+
 static void processFile(IStream & treeStream,
-			const vector<OracleSentence *> & goldProps)
+			const vector<OracleSentence *> & goldProps,
+			int labelThreads,
+			int formatThreads)
 {
-  // full parse of the current sentence
-  TreePtr tree;
-  int count = 1;
+  vector<string> sentences;
+  vector<OracleSentence *> chunkProps;
   char line[MAX_LINE];
+  size_t processed = 0;
   
   try{
-    while(treeStream.getline(line, MAX_LINE) != NULL){
-      // classify all predicates in this sentence
-      OracleSentence * oracleSent = NULL;
-      if(count <= (int) goldProps.size()) oracleSent = goldProps[count - 1];
-      if(oracleSent == NULL) tree = Swirl::parse(line);
-      else tree = Swirl::oracleParse(line, oracleSent);
-      RVASSERT(tree != (const Tree *) NULL,
-	       "Failed to parse line: " << line);
-      
-      // dump CoNLL format
-      Swirl::displayProps(tree, cout, false);
-      
-      if(count % 100 == 0){
-	CERR << "Processed " << count << " sentences..." << endl;
+    while(true){
+      sentences.clear();
+      while(sentences.size() < FILE_CHUNK &&
+	    treeStream.getline(line, MAX_LINE) != NULL){
+	sentences.push_back(line);
+      }
+      if(sentences.empty()) break;
+
+      chunkProps.clear();
+      for(size_t i = processed;
+	  i < processed + sentences.size() && i < goldProps.size(); i ++){
+	chunkProps.push_back(goldProps[i]);
       }
-      
-      // increment number of processed sentences
-      count ++;
+
+      // parsing, labeling and output overlap, but the output keeps the
+      //   order of the input
+      FileCallback callback(sentences, processed);
+      Swirl::parseBatch(sentences, callback, labelThreads, 
+			4 * (labelThreads + formatThreads) + 4, & chunkProps,
+			formatThreads);
+      processed += sentences.size();
     }
     
-    CERR << "Done. Processed " << count - 1 << " sentences." << endl;
+    CERR << "Done. Processed " << processed << " sentences." << endl;
+    Tree::printInferenceStats(CERR);
+    dumpStats(true);
     
   } catch(Exception e){
     CERR << e.getMessage() << endl
@@ -75,7 +177,10 @@ static void processFile(IStream & treeStream,
   if(goldProps.size() > 0) Tree::printOracleStats(cerr);
 }
 
-static void interactiveShell(bool showPrompt)
+static void interactiveShell(bool showPrompt, 
+			     double latencyBudget,
+			     ResultCache * cache,
+			     const SwirlFilter & filter)
 {
   TreePtr tree;
   char line[MAX_LINE];
@@ -89,19 +194,253 @@ static void interactiveShell(bool showPrompt)
   while(cin.getline(line, MAX_LINE) != NULL){
     if(strlen(line) == 0) break;
 
-    // classify all predicates in this sentence
-    tree = Swirl::parse(line);
+    LatencyBudget budget(latencyBudget);
+    LatencyBudget * budgetPointer = (latencyBudget > 0 ? & budget : NULL);
+
+    if(cache != NULL){
+      // repeats of a sentence are not parsed again
+      Swirl::serialize(line, * cache, cout, budgetPointer, & filter);
+    } else {
+      // classify all predicates in this sentence
+      tree = Swirl::parse(line, filter, budgetPointer);
+
+      // dump extended Treebank format if used in the interactive shell
+      if(tree != (const Tree *) NULL && showPrompt){
+	tree->serialize(cout);
+	cout << "\n\n";
+      }
+
+      // dump extended CoNLL format
+      Swirl::serialize(tree, line, cout);
+    }
 
-    // dump extended Treebank format if used in the interactive shell
-    if(tree != (const Tree *) NULL && showPrompt){
-      tree->serialize(cout);
-      cout << "\n\n";
+    const vector<string> & degradations = budget.getDegradations();
+    if(degradations.size() > 0){
+      CERR << "Degraded to fit " << latencyBudget << " ms:";
+      for(size_t i = 0; i < degradations.size(); i ++){
+	CERR << " " << degradations[i];
+      }
+      CERR << " (" << budget.getElapsed() << " ms)" << endl;
     }
 
-    // dump extended CoNLL format
-    Swirl::serialize(tree, line, cout);
+    dumpStats(false);
     if(showPrompt) cout << "SRL> ";
   }
+  dumpStats(true);
+}
+
+static void putInt(string & out, unsigned int value)
+{
+  unsigned int n = htonl(value);
+  out.append((const char *) & n, 4);
+}
+
+/**
+ * Formats each result as a compact argument record, instead of the
+ *   extended CoNLL text. All integers are 32-bit, in network byte order:
+ *   token count;
+ *   predicate count, then the position of each predicate;
+ *   argument count, then for each argument: predicate position, first
+ *   and last token (inclusive), probability (bits of an IEEE float),
+ *   label length, and label bytes.
+ */
+class ArgumentBatcher : public MicroBatcher
+{
+ public:
+  ArgumentBatcher(int maxBatch, double maxWait, int maxQueued, 
+		  int labelThreads)
+    : MicroBatcher(maxBatch, maxWait, maxQueued, labelThreads) {}
+
+ protected:
+  void format(const TreePtr & tree,
+	      const string & sentence,
+	      ostream & os)
+  {
+    RVASSERT(tree != (const Tree *) NULL, "Failed to parse sentence!");
+
+    vector<int> predicates;
+    vector<ArgumentSpan> args;
+    Swirl::getArguments(tree, predicates, args);
+
+    string record;
+    putInt(record, tree->getRightPosition() + 1);
+    putInt(record, predicates.size());
+    for(size_t i = 0; i < predicates.size(); i ++){
+      putInt(record, predicates[i]);
+    }
+    putInt(record, args.size());
+    for(size_t i = 0; i < args.size(); i ++){
+      putInt(record, args[i].predicate);
+      putInt(record, args[i].start);
+      putInt(record, args[i].end);
+      float prob = (float) args[i].prob;
+      unsigned int bits;
+      memcpy(& bits, & prob, 4);
+      putInt(record, bits);
+      putInt(record, args[i].label.size());
+      record.append(args[i].label);
+    }
+    os << record;
+  }
+};
+
+/**
+ * Formats each result as a compact binary record (see ResultRecord.h),
+ *   which also carries the tokens, their lemmas and their POS tags
+ */
+class RecordBatcher : public MicroBatcher
+{
+ public:
+  RecordBatcher(int maxBatch, double maxWait, int maxQueued, 
+		int labelThreads)
+    : MicroBatcher(maxBatch, maxWait, maxQueued, labelThreads) {}
+
+ protected:
+  void format(const TreePtr & tree,
+	      const string & sentence,
+	      ostream & os)
+  {
+    RVASSERT(tree != (const Tree *) NULL, "Failed to parse sentence!");
+
+    string record;
+    Swirl::encodeResult(tree, record);
+    os << record;
+  }
+};
+
+/** Serializes the writes of response frames to stdout */
+static pthread_mutex_t outputMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** The original stdout, which only carries the response frames */
+static int frameOutput = 1;
+
+/** Frames submitted but not answered yet, guarded by outputMutex */
+static int pendingFrames = 0;
+static pthread_cond_t frameAnswered = PTHREAD_COND_INITIALIZER;
+
+static void writeFrame(const FrameResponse & response)
+{
+  string frame;
+  encodeFrame(response, frame);
+
+  pthread_mutex_lock(& outputMutex);
+  size_t offset = 0;
+  while(offset < frame.size()){
+    ssize_t n = write(frameOutput, frame.c_str() + offset,
+		      frame.size() - offset);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0){
+      // the wrapper is gone; nobody is left to answer
+      CERR << "Failed to write response frame. Exiting..." << endl;
+      exit(-1);
+    }
+    offset += n;
+  }
+  pthread_mutex_unlock(& outputMutex);
+}
+
+/** A request frame from stdin, answered as soon as it is labeled */
+class StdioJob : public BatchJob
+{
+ public:
+  StdioJob(unsigned int id) : mId(id) {}
+
+  void done() {
+    FrameResponse response;
+    response.id = mId;
+    response.results = results;
+    writeFrame(response);
+
+    pthread_mutex_lock(& outputMutex);
+    pendingFrames --;
+    pthread_cond_signal(& frameAnswered);
+    pthread_mutex_unlock(& outputMutex);
+
+    delete this;
+  }
+
+ private:
+  unsigned int mId;
+};
+
+/**
+ * Reads request frames from stdin until EOF, and answers each with a
+ *   response frame on stdout (see FrameProtocol.h), whose results are
+ *   formatted by the Batcher: argument records (see ArgumentBatcher), or
+ *   result records (see RecordBatcher). The frames go through a
+ *   MicroBatcher, so the wrapper can keep many sentences in flight;
+ *   the responses may come back in any order.
+ */
+template <class Batcher>
+static void framedShell(int labelThreads,
+			int batchSize,
+			double batchWait,
+			int maxQueued)
+{
+  //
+  // the parser and the tree code print diagnostics to stdout, which
+  //   would corrupt the frames: they keep a private copy of stdout, and
+  //   everything else written to stdout goes to stderr
+  //
+  cout.flush();
+  fflush(stdout);
+  frameOutput = dup(1);
+  if(frameOutput < 0 || dup2(2, 1) < 0){
+    perror("ERROR redirecting stdout");
+    exit(-1);
+  }
+
+  Batcher batcher(batchSize, batchWait, maxQueued, labelThreads);
+  FrameDecoder decoder;
+  char buffer[64 * 1024];
+
+  try{
+    while(true){
+      ssize_t n = read(0, buffer, sizeof(buffer));
+      if(n < 0 && errno == EINTR) continue;
+      if(n <= 0) break;
+      decoder.append(buffer, n);
+
+      FrameRequest request;
+      while(decoder.next(request)){
+	// a frame without sentences asks for the stats
+	if(request.sentences.empty()){
+	  ostringstream os;
+	  os << "queue_depth " << batcher.getQueueDepth() << "\n";
+	  PipelineStats::print(os);
+	  FrameResponse response;
+	  response.id = request.id;
+	  response.results.push_back(FrameResult(FRAME_OK, os.str()));
+	  writeFrame(response);
+	  continue;
+	}
+
+	StdioJob * job = new StdioJob(request.id);
+	job->sentences.swap(request.sentences);
+	pthread_mutex_lock(& outputMutex);
+	pendingFrames ++;
+	pthread_mutex_unlock(& outputMutex);
+	// waits while too many sentences are queued
+	batcher.submit(job);
+      }
+      dumpStats(false);
+    }
+    if(decoder.pending() > 0){
+      CERR << "Input closed in the middle of a frame." << endl;
+    }
+  } catch(exception & e){
+    CERR << "Closing input: " << e.what() << endl;
+  }
+
+  // the frames already read are still answered
+  pthread_mutex_lock(& outputMutex);
+  while(pendingFrames > 0){
+    pthread_cond_wait(& frameAnswered, & outputMutex);
+  }
+  pthread_mutex_unlock(& outputMutex);
+
+  batcher.printStats(CERR);
+  dumpStats(true);
 }
 
 int main(int argc,
@@ -132,9 +471,64 @@ int main(int argc,
   bool showPrompt = true;
   if(Parameters::contains("no-prompt")) showPrompt = false;
 
+  bool framed = Parameters::contains("framed");
+  int batchSize = 32;
+  Parameters::get("batch-size", batchSize);
+  double batchWait = 2;
+  Parameters::get("batch-wait", batchWait);
+  int maxQueued = 256;
+  Parameters::get("max-queued", maxQueued);
+  if(batchSize < 1 || batchWait < 0 || maxQueued < 1){
+    cerr << "Invalid batch size, batch wait, or queue size!" << endl;
+    exit(-1);
+  }
+
   bool caseSensitive = true; // default: case sensitive
   if(Parameters::contains("case-insensitive")) caseSensitive = false;
 
+  if(Parameters::contains("exact-inference")) Tree::setExactInference(true);
+
+  int predicateThreads = 1; // default: no threads
+  Parameters::get("predicate-threads", predicateThreads);
+  if(predicateThreads < 1){
+    cerr << "Invalid number of predicate threads: " << predicateThreads << endl;
+    exit(-1);
+  }
+  Tree::setPredicateThreads(predicateThreads);
+
+  int labelThreads = 1;
+  Parameters::get("label-threads", labelThreads);
+  if(labelThreads < 1){
+    cerr << "Invalid number of label threads: " << labelThreads << endl;
+    exit(-1);
+  }
+
+  int formatThreads = 1;
+  Parameters::get("format-threads", formatThreads);
+  if(formatThreads < 1){
+    cerr << "Invalid number of format threads: " << formatThreads << endl;
+    exit(-1);
+  }
+
+  Parameters::get("stats-interval", statsInterval);
+  lastStatsDump = time(NULL);
+
+  double latencyBudget = 0; // default: no limit
+  Parameters::get("latency-budget", latencyBudget);
+
+  int cacheSize = 0; // default: no cache
+  Parameters::get("cache-size", cacheSize);
+  String cacheFile;
+  Parameters::get("cache-file", cacheFile);
+
+  SwirlFilter filter;
+  String labels;
+  if(Parameters::get("labels", labels)){
+    vector<String> tokens;
+    simpleTokenize(labels, tokens, ",");
+    for(size_t i = 0; i < tokens.size(); i ++) filter.addLabel(tokens[i]);
+  }
+
   //
   // if the gold propositions are given we're running in oracle mode, i.e.,
   //   we are gathering various statistics and computing the score upper limits
@@ -168,9 +562,32 @@ int main(int argc,
       cerr << "Can not open file: " << treeFile << endl;
       exit(-1);
     }
-    processFile(treeStream, goldProps);
+    processFile(treeStream, goldProps, labelThreads, formatThreads);
+  } else if(framed){
+    if(Parameters::contains("records")){
+      framedShell<RecordBatcher>(labelThreads, batchSize, batchWait, 
+				 maxQueued);
+    } else {
+      framedShell<ArgumentBatcher>(labelThreads, batchSize, batchWait, 
+				   maxQueued);
+    }
   } else {
-    interactiveShell(showPrompt);
+    ResultCache * cache = NULL;
+    if(cacheSize > 0){
+      cache = new ResultCache(cacheSize);
+      if(! cacheFile.empty() && ! cache->open(cacheFile.c_str())){
+	cerr << "Can not open file: " << cacheFile 
+	     << " (not writable, or not a cache file)" << endl;
+	exit(-1);
+      }
+    }
+
+    interactiveShell(showPrompt, latencyBudget, cache, filter);
+
+    if(cache != NULL){
+      cache->printStats(CERR);
+      delete cache;
+    }
   }
   
   return 0;
@@ -56,6 +56,11 @@ public:
     int     extraTime; //if no parse is found on regular time;
     static  Item*    dummyItem;
     static float timeFactor;
+    /* wall clock time, in ms, after which parse() stops popping edges,
+       and keeps the best parse found so far, if any; 0 for none */
+    static double deadline;
+    /* set by parse() if it stopped at the deadline */
+    static bool  deadlineExpired;
     static float    denomProbs[MAXSENTLEN];  
     void            check();
     static void     setPosStarts();
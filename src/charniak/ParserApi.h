@@ -24,6 +24,24 @@ public:
   /** Parses one sentence and returns the best solution */
   static srl::TreePtr parse(const char * sentence);
 
+  /**
+   * Same as above, with a fraction (0, 1] of the usual parser effort:
+   *   the edge budgets Bchart::timeFactor and ChartBase::ruleiCountTimeout_
+   *   are scaled down for this sentence only
+   */
+  static srl::TreePtr parse(const char * sentence,
+			    double effort);
+
+  /**
+   * Same as above, but the parser stops popping edges at the deadline
+   *   (wall clock time in ms, see Bchart::deadline; 0 for none), and
+   *   returns the best parse found by then. If it had found none, the
+   *   sentence fails.
+   */
+  static srl::TreePtr parse(const char * sentence,
+			    double effort,
+			    double deadline);
+
  private:
   static int MAX_SENT_LEN;
 };
@@ -18,9 +18,13 @@ class AdaBoostClassifier: public Classifier {
 
   virtual bool isInitialized() const { return (_classifier != NULL); }
 
-  virtual ~AdaBoostClassifier() {};
+  virtual ~AdaBoostClassifier() { delete _classifier; }
 
  private:
+  /** Owns its model */
+  AdaBoostClassifier(const AdaBoostClassifier &);
+  AdaBoostClassifier & operator = (const AdaBoostClassifier &);
+
   bAdaBoost * _classifier;
 };
 
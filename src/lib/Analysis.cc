@@ -213,7 +213,7 @@ void Tree::countCommaIs(const std::vector< RCIPtr<srl::Tree> > & sentence)
 {
   for(list<Argument>::iterator it = _arguments.begin();
       it != _arguments.end(); it ++){
-    if((* it).getType() == "I" && getLabel() == ","){
+    if((* it).getType() == "I" && getLabelId() == LABEL_COMMA){
       _commaICount ++;
     }
   }
@@ -239,7 +239,7 @@ bool Tree::checkLluis(const std::vector< RCIPtr<srl::Tree> > & sentence)
 	    "Chosen phrase is not a predicate!");
 
     const Tree * s = pred->_parent;
-    while(s != NULL && s->getLabel().substr(0, 1) != "S")
+    while(s != NULL && ! s->hasLabelCategory(LABEL_IS_CLAUSE))
       s = s->_parent;
 
     if(s != NULL){
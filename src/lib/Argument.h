@@ -84,6 +84,25 @@ namespace srl {
      */
     double _prob;
   };
+
+  /**
+   * One predicted argument of a predicate, as a span of terminals, i.e.,
+   *   an argument of the CoNLL output without its text matrix
+   */
+  struct ArgumentSpan {
+    /** Predicate position in the terminal vector */
+    int predicate;
+
+    /** Name e.g. A0, AM-TMP */
+    String label;
+
+    /** First and last terminal of the argument, inclusive */
+    int start;
+    int end;
+
+    /** Probability of the argument, as in Argument::getProb() */
+    double prob;
+  };
 }
 
 #endif
@@ -13,9 +13,9 @@ BankTreeProducer::BankTreeProducer()
 static void gatherVerbParticles(vector<TreePtr> sentence)
 {
   for(size_t i = 0; i < sentence.size() - 1; i ++){
-    if(sentence[i]->getLabel().substr(0, 2) == "VB" &&
+    if(sentence[i]->hasLabelCategory(LABEL_IS_VERB) &&
        (// sentence[i + 1]->getLabel().substr(0, 2) == "IN" ||
-	sentence[i + 1]->getLabel().substr(0, 2) == "RP")){
+	sentence[i + 1]->getLabel().compare(0, 2, "RP") == 0)){
       Lexicon::addVerbParticle(sentence[i]->getHeadLemma(),
 			       sentence[i + 1]->getHeadLemma());
     }
@@ -122,66 +122,12 @@ void BankTreeProducer::preprocess(srl::TreePtr edge,
   
   // cout << "Tree initially:" << endl << * edge; cin.get();
   
-  // Collins head heuristics
-  edge->setHead();
-  
-  // Surdeanu, ACL2003 content word heuristics
-  // head must be set!
-  edge->detectContentWords();
-  
-  // sentence terminal positions
-  edge->setPositions();
-  
-  // detect lemmas if not already set
-  edge->detectLemmas(false);
-  
-  // extract sequence of terminals
-  sentence.clear();
-  generateSentence(edge, sentence);
-  
-  // detect voice
-  edge->detectPredicateVoices(sentence);
-  
-  // detect auxiliary verbs (needed for the distance features)
-  edge->detectAuxVerbs();
-  
-  // detect POS contexts
-  edge->detectPOSContexts(sentence);
-  
-  // detect temporal-specific terminals
-  edge->detectTemporalTerminals();
-  
-  // mark the inclusion of several semantic categories
-  edge->detectIncludes();
-  
-  // count commas
-  edge->countCommas();
-  
-  // detect the governing category for NPs: S or VP?
-  edge->detectGoverningCategory();
-  
-  // detect the sequence of children labels
-  edge->detectChildrenPath();
-  
-  // detect sibling contexts
-  edge->detectSiblingPaths();
-  
-  // detect head word suffixes
-  edge->detectSuffixes(caseSensitive);
-  
-  // detect B-A nodes for all I-As
-  edge->detectArgumentBegins(edge.operator->());
-  
-  // detect the types of B labels: single, term, incorrect
-  edge->detectBTypes();
-  
-  // detect left/right siblings for all edges
-  edge->detectSiblings();
-  
-  // generate the feature sets for each phrase
-  // here we detect only local arg/pred features
+  // heads, content words, positions, lemmas, the sequence of terminals,
+  // voices, aux verbs, POS contexts, includes, governing categories,
+  // children and sibling paths, suffixes, argument begins and B types,
+  // siblings, and the local arg/pred feature sets, in two traversals
   // path-based features are detected outside, as they depend on the PA tuple
-  edge->generateFeatureSets(sentence, caseSensitive);
+  edge->preprocess(sentence, caseSensitive);
 }
 
 TreePtr BankTreeProducer::create(IStream & treeStream, 
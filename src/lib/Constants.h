@@ -65,5 +65,11 @@
  */
 #define GLOBAL_BEAM 15
 
+/**
+ * Exact inference: how many frames may the A* search expand per predicate,
+ *   before falling back to the global beam?
+ */
+#define ASTAR_MAX_EXPANSIONS 100000
+
 #endif
 
@@ -0,0 +1,143 @@
+
+#include <iostream>
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "FrameProtocol.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+#define REQUEST_MAGIC 0x53524c51 // "SRLQ"
+#define RESPONSE_MAGIC 0x53524c52 // "SRLR"
+
+static void putInt(string & out, unsigned int value)
+{
+  unsigned int n = htonl(value);
+  out.append((const char *) & n, 4);
+}
+
+static unsigned int getInt(const string & in, size_t offset)
+{
+  unsigned int n;
+  memcpy(& n, in.data() + offset, 4);
+  return ntohl(n);
+}
+
+/** Writes the header of a frame whose payload follows at offset start */
+static void putHeader(string & out, size_t start,
+		      unsigned int magic, unsigned int id, unsigned int count)
+{
+  string header;
+  putInt(header, magic);
+  putInt(header, id);
+  putInt(header, count);
+  putInt(header, (unsigned int) (out.size() - start));
+  out.insert(start, header);
+}
+
+void srl::encodeFrame(const FrameRequest & request, std::string & out)
+{
+  size_t start = out.size();
+  for(size_t i = 0; i < request.sentences.size(); i ++){
+    putInt(out, (unsigned int) request.sentences[i].size());
+    out.append(request.sentences[i]);
+  }
+  putHeader(out, start, REQUEST_MAGIC, request.id,
+	    (unsigned int) request.sentences.size());
+}
+
+void srl::encodeFrame(const FrameResponse & response, std::string & out)
+{
+  size_t start = out.size();
+  for(size_t i = 0; i < response.results.size(); i ++){
+    putInt(out, (unsigned int) response.results[i].status);
+    putInt(out, (unsigned int) response.results[i].data.size());
+    out.append(response.results[i].data);
+  }
+  putHeader(out, start, RESPONSE_MAGIC, response.id,
+	    (unsigned int) response.results.size());
+}
+
+bool srl::startsWithRequestMagic(const char * data, size_t size)
+{
+  static const char magic[] = "SRLQ";
+  if(size > 4) size = 4;
+  return memcmp(data, magic, size) == 0;
+}
+
+void FrameDecoder::append(const char * data, size_t size)
+{
+  // drop the frames already decoded, once they are the bulk of the buffer
+  if(_start > 0 && _start >= _buffer.size() / 2){
+    _buffer.erase(0, _start);
+    _start = 0;
+  }
+  _buffer.append(data, size);
+}
+
+bool FrameDecoder::nextFrame(unsigned int magic,
+			     unsigned int & id,
+			     unsigned int & count,
+			     size_t & payload)
+{
+  if(pending() < FRAME_HEADER_SIZE) return false;
+
+  RVASSERT(getInt(_buffer, _start) == magic, "Invalid frame magic!");
+  id = getInt(_buffer, _start + 4);
+  count = getInt(_buffer, _start + 8);
+  payload = getInt(_buffer, _start + 12);
+  RVASSERT(payload <= MAX_FRAME_SIZE,
+	   "Frame too large: " << payload << " bytes");
+
+  return pending() >= FRAME_HEADER_SIZE + payload;
+}
+
+bool FrameDecoder::next(FrameRequest & request)
+{
+  unsigned int count;
+  size_t payload;
+  if(! nextFrame(REQUEST_MAGIC, request.id, count, payload)) return false;
+
+  size_t offset = _start + FRAME_HEADER_SIZE;
+  size_t end = offset + payload;
+  request.sentences.clear();
+  for(unsigned int i = 0; i < count; i ++){
+    RVASSERT(offset + 4 <= end, "Truncated request frame!");
+    size_t length = getInt(_buffer, offset);
+    offset += 4;
+    RVASSERT(length <= end - offset, "Truncated request frame!");
+    request.sentences.push_back(_buffer.substr(offset, length));
+    offset += length;
+  }
+  RVASSERT(offset == end, "Extra bytes in request frame!");
+
+  _start = end;
+  return true;
+}
+
+bool FrameDecoder::next(FrameResponse & response)
+{
+  unsigned int count;
+  size_t payload;
+  if(! nextFrame(RESPONSE_MAGIC, response.id, count, payload)) return false;
+
+  size_t offset = _start + FRAME_HEADER_SIZE;
+  size_t end = offset + payload;
+  response.results.clear();
+  for(unsigned int i = 0; i < count; i ++){
+    RVASSERT(offset + 8 <= end, "Truncated response frame!");
+    int status = (int) getInt(_buffer, offset);
+    size_t length = getInt(_buffer, offset + 4);
+    offset += 8;
+    RVASSERT(length <= end - offset, "Truncated response frame!");
+    response.results.push_back(FrameResult(status,
+					   _buffer.substr(offset, length)));
+    offset += length;
+  }
+  RVASSERT(offset == end, "Extra bytes in response frame!");
+
+  _start = end;
+  return true;
+}
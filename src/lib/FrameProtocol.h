@@ -0,0 +1,105 @@
+
+#ifndef SRL_FRAME_PROTOCOL_H
+#define SRL_FRAME_PROTOCOL_H
+
+#include <string>
+#include <vector>
+
+namespace srl {
+
+  /**
+   * Framed request/response protocol of the SRL server
+   * Every frame starts with a 16-byte header of four 32-bit integers in
+   *   network byte order: magic ("SRLQ" for requests, "SRLR" for
+   *   responses), request id, item count, and payload length in bytes.
+   * Request items are sentences: 32-bit length + bytes.
+   * Response items are results, in the order of the sentences of the
+   *   request: 32-bit status + 32-bit length + bytes (the extended CoNLL
+   *   output if the status is FRAME_OK, an error message otherwise).
+   * A request without sentences asks for the stats of the server; its
+   *   response has one result, with the stats as text.
+   * A client may send many requests without waiting for responses; the
+   *   responses carry the id of their request, and may come back in any
+   *   order.
+   */
+
+  /** Size of the frame header, in bytes */
+  const size_t FRAME_HEADER_SIZE = 16;
+
+  /** Frames with larger payloads are rejected */
+  const size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+  enum FrameStatus {
+    FRAME_OK = 0,
+    FRAME_FAILED = 1
+  };
+
+  struct FrameRequest {
+    unsigned int id;
+    std::vector<std::string> sentences;
+  };
+
+  struct FrameResult {
+    FrameResult() : status(FRAME_OK) {}
+    FrameResult(int s, const std::string & d) : status(s), data(d) {}
+
+    int status;
+    std::string data;
+  };
+
+  struct FrameResponse {
+    unsigned int id;
+    std::vector<FrameResult> results;
+  };
+
+  /** Appends the encoded frame to out */
+  void encodeFrame(const FrameRequest & request, std::string & out);
+  void encodeFrame(const FrameResponse & response, std::string & out);
+
+  /**
+   * Can the stream that starts with these bytes be a request frame?
+   * True for fewer than 4 bytes that match the start of the magic.
+   */
+  bool startsWithRequestMagic(const char * data, size_t size);
+
+  /**
+   * Splits a byte stream into frames
+   * Bytes are added as they are read; a frame may span several reads,
+   *   and a read may hold several frames. Malformed frames throw
+   *   std::runtime_error, after which the stream can not be resynced.
+   */
+  class FrameDecoder {
+
+  public:
+    FrameDecoder() : _start(0) {}
+
+    void append(const char * data, size_t size);
+
+    /** Decodes the next complete request; false if there is none yet */
+    bool next(FrameRequest & request);
+
+    /** Decodes the next complete response; false if there is none yet */
+    bool next(FrameResponse & response);
+
+    /** Bytes received but not decoded yet */
+    size_t pending() const { return _buffer.size() - _start; }
+
+  private:
+    /**
+     * Checks the header of the next frame
+     * @return false if the frame is not complete yet
+     */
+    bool nextFrame(unsigned int magic,
+		   unsigned int & id,
+		   unsigned int & count,
+		   size_t & payload);
+
+    std::string _buffer;
+
+    /** Start of the first frame not decoded yet */
+    size_t _start;
+  };
+
+} // end namespace srl
+
+#endif
@@ -0,0 +1,225 @@
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "Constants.h"
+#include "FrozenLexicon.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+#define FROZEN_LEXICON_VERSION 1
+
+/** Rounds up to a multiple of 4, such that all sections stay aligned */
+static size_t align4(size_t n)
+{
+  return (n + 3) & ~((size_t) 3);
+}
+
+unsigned int FrozenLexicon::hashKey(const Char * key)
+{
+  unsigned int h = 2166136261U;
+  for(; * key != 0; key ++){
+    h ^= (unsigned int) (unsigned char) * key;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+size_t FrozenLexicon::layout(const Header & h, size_t offsets[5])
+{
+  size_t size = align4(sizeof(Header));
+  offsets[0] = size;
+  size += h.entryCount * sizeof(Entry);
+  offsets[1] = size;
+  size += h.slotCount * sizeof(unsigned int);
+  offsets[2] = size;
+  size += h.particleCount * sizeof(unsigned int);
+  offsets[3] = size;
+  size += align4(h.frameCount * h.frameSize * sizeof(bool));
+  offsets[4] = size;
+  size += align4(h.poolSize);
+  return size;
+}
+
+void FrozenLexicon::attach()
+{
+  size_t offsets[5];
+  _header = (const Header *) _image;
+  layout(* _header, offsets);
+  _entries = (const Entry *) (_image + offsets[0]);
+  _slots = (const unsigned int *) (_image + offsets[1]);
+  _particles = (const unsigned int *) (_image + offsets[2]);
+  _frames = (const bool *) (_image + offsets[3]);
+  _pool = (const Char *) (_image + offsets[4]);
+}
+
+FrozenLexicon::FrozenLexicon(const Records & records)
+  : _image(NULL), _imageSize(0)
+{
+  Header h;
+  memset(& h, 0, sizeof(Header));
+  memcpy(h.magic, "SWLX", 4);
+  h.version = FROZEN_LEXICON_VERSION;
+  h.frameSize = MAX_NUMBERED_ARGS;
+
+  //
+  // first pass: sizes, and the entry ids of all particles
+  //
+  map<String, unsigned int> particleIds;
+  for(Records::const_iterator it = records.begin();
+      it != records.end(); it ++){
+    const Record & r = it->second;
+    h.entryCount ++;
+    h.poolSize += it->first.size() + 1;
+    h.particleCount += r.particles.size();
+    if(r.frame != NULL) h.frameCount ++;
+    for(size_t i = 0; i < r.particles.size(); i ++)
+      particleIds[r.particles[i]] = 0;
+  }
+
+  unsigned int id = 0;
+  for(Records::const_iterator it = records.begin();
+      it != records.end(); it ++, id ++){
+    map<String, unsigned int>::iterator pit = particleIds.find(it->first);
+    if(pit != particleIds.end()) pit->second = id + 1;
+  }
+
+  // keep the index at most half full
+  h.slotCount = 8;
+  while(h.slotCount < 2 * h.entryCount) h.slotCount *= 2;
+
+  size_t offsets[5];
+  _imageSize = layout(h, offsets);
+  _image = new char[_imageSize];
+  memset(_image, 0, _imageSize);
+  memcpy(_image, & h, sizeof(Header));
+  attach();
+
+  Entry * entries = (Entry *) (_image + offsets[0]);
+  unsigned int * slots = (unsigned int *) (_image + offsets[1]);
+  unsigned int * particles = (unsigned int *) (_image + offsets[2]);
+  bool * frames = (bool *) (_image + offsets[3]);
+  Char * pool = (Char *) (_image + offsets[4]);
+
+  //
+  // second pass: fill in the entries, the pool, and the tables
+  //
+  unsigned int poolOffset = 0, particleOffset = 0, frameOffset = 0;
+  id = 0;
+  for(Records::const_iterator it = records.begin();
+      it != records.end(); it ++, id ++){
+    const Record & r = it->second;
+    Entry & e = entries[id];
+
+    e.key = poolOffset;
+    memcpy(pool + poolOffset, it->first.c_str(), it->first.size() + 1);
+    poolOffset += it->first.size() + 1;
+    e.hash = hashKey(it->first.c_str());
+
+    e.wordCount = r.wordCount;
+    e.lemmaCount = r.lemmaCount;
+    e.featureIndex = r.featureIndex;
+
+    e.flags = r.tmpFlags;
+    if(r.wordCount < UNKNOWN_WORD_THRESHOLD) e.flags |= UNKNOWN_WORD;
+    if(r.lemmaCount < UNKNOWN_LEMMA_THRESHOLD) e.flags |= UNKNOWN_LEMMA;
+    if(r.lemmaCount < UNKNOWN_PREDICATE_THRESHOLD) e.flags |= UNKNOWN_PRED;
+
+    e.frame = -1;
+    if(r.frame != NULL){
+      e.frame = frameOffset;
+      memcpy(frames + frameOffset * h.frameSize, r.frame,
+	     h.frameSize * sizeof(bool));
+      frameOffset ++;
+    }
+
+    e.particleStart = particleOffset;
+    for(size_t i = 0; i < r.particles.size(); i ++){
+      unsigned int pid = particleIds[r.particles[i]];
+      RVASSERT(pid > 0, "Particle " << r.particles[i] << " of verb "
+	       << it->first << " is not in the frozen lexicon");
+      particles[particleOffset ++] = pid - 1;
+    }
+    e.particleEnd = particleOffset;
+
+    unsigned int mask = h.slotCount - 1;
+    unsigned int slot = e.hash & mask;
+    while(slots[slot] != 0) slot = (slot + 1) & mask;
+    slots[slot] = id + 1;
+  }
+}
+
+FrozenLexicon::FrozenLexicon(const String & fileName)
+  : _image(NULL), _imageSize(0)
+{
+  ifstream is(fileName.c_str(), ios::in | ios::binary);
+  RVASSERT(is, "Can not open frozen lexicon: " << fileName);
+
+  Header h;
+  is.read((char *) & h, sizeof(Header));
+  RVASSERT(is && memcmp(h.magic, "SWLX", 4) == 0,
+	   "Invalid frozen lexicon: " << fileName);
+  RVASSERT(h.version == FROZEN_LEXICON_VERSION &&
+	   h.frameSize == MAX_NUMBERED_ARGS,
+	   "Incompatible frozen lexicon: " << fileName);
+
+  size_t offsets[5];
+  _imageSize = layout(h, offsets);
+  _image = new char[_imageSize];
+  is.seekg(0, ios::beg);
+  is.read(_image, _imageSize);
+  if(! is || (size_t) is.gcount() != _imageSize){
+    delete [] _image;
+    _image = NULL;
+    RVASSERT(false, "Truncated frozen lexicon: " << fileName);
+  }
+
+  attach();
+}
+
+FrozenLexicon::~FrozenLexicon()
+{
+  delete [] _image;
+}
+
+void FrozenLexicon::save(const String & fileName) const
+{
+  ofstream os(fileName.c_str(), ios::out | ios::binary);
+  RVASSERT(os, "Can not create frozen lexicon: " << fileName);
+  os.write(_image, _imageSize);
+  RVASSERT(os, "Failed to write frozen lexicon: " << fileName);
+}
+
+const FrozenLexicon::Entry * FrozenLexicon::find(const Char * key) const
+{
+  unsigned int hash = hashKey(key);
+  unsigned int mask = _header->slotCount - 1;
+  for(unsigned int slot = hash & mask; _slots[slot] != 0;
+      slot = (slot + 1) & mask){
+    const Entry * e = & _entries[_slots[slot] - 1];
+    if(e->hash == hash && strcmp(_pool + e->key, key) == 0) return e;
+  }
+  return NULL;
+}
+
+const bool * FrozenLexicon::getFrame(const Char * lemma) const
+{
+  const Entry * e = find(lemma);
+  if(e == NULL || e->frame < 0) return NULL;
+  return _frames + e->frame * _header->frameSize;
+}
+
+bool FrozenLexicon::isVerbParticle(const Char * verb,
+				   const Char * particle) const
+{
+  const Entry * e = find(verb);
+  if(e == NULL) return false;
+  for(unsigned int i = e->particleStart; i < e->particleEnd; i ++){
+    if(strcmp(_pool + _entries[_particles[i]].key, particle) == 0)
+      return true;
+  }
+  return false;
+}
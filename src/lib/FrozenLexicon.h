@@ -0,0 +1,167 @@
+/**
+ * @file FrozenLexicon.h
+ * Read-only snapshot of the lexicon used at inference time
+ */
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include "Wide.h"
+
+#ifndef FROZEN_LEXICON_H
+#define FROZEN_LEXICON_H
+
+namespace srl {
+
+  /**
+   * All the per-string data that the classifiers read from the lexicon
+   *   (word/lemma counts, temporal markers, feature indices, verb frames,
+   *   and verb particles), compiled into one contiguous, immutable image.
+   * The image contains: a header, one Entry per distinct string sorted by
+   *   string, an open-addressing index over the entries, the particle
+   *   and frame tables, and the string pool, in the same order as entries.
+   * Lookups are one hash probe (plus linear probing on collisions) and do
+   *   not allocate. Since the image is never modified after construction,
+   *   one snapshot can be shared by any number of threads.
+   * The image is saved as is, in the native byte order, so snapshot files
+   *   are not portable across architectures.
+   */
+  class FrozenLexicon {
+
+  public:
+
+    /** Precomputed flags for each entry */
+    enum EntryFlags {
+      UNKNOWN_WORD = 1,
+      UNKNOWN_LEMMA = 2,
+      UNKNOWN_PRED = 4,
+      TMP_NN = 8,
+      TMP_NNP = 16,
+      TMP_IN = 32,
+      TMP_RB = 64
+    };
+
+    /** Fixed-size record for one string */
+    class Entry {
+    public:
+      /** Offset of the 0-terminated string in the pool */
+      unsigned int key;
+      unsigned int hash;
+      int wordCount;
+      int lemmaCount;
+      /** Feature index, -1 if this string is not a known feature */
+      int featureIndex;
+      /** Position in the frame table, -1 if this lemma has no frame */
+      int frame;
+      /** Particle range [particleStart, particleEnd) in the particle table */
+      unsigned int particleStart;
+      unsigned int particleEnd;
+      unsigned int flags;
+    };
+
+    /** Staging record, used only while compiling a snapshot */
+    class Record {
+    public:
+      Record() : wordCount(0), lemmaCount(0), tmpFlags(0),
+	featureIndex(-1), frame(NULL) {}
+
+      int wordCount;
+      int lemmaCount;
+      unsigned int tmpFlags;
+      int featureIndex;
+      const bool * frame;
+      std::vector<String> particles;
+    };
+
+    typedef std::map<String, Record> Records;
+
+    /** Compiles a snapshot from staging records */
+    FrozenLexicon(const Records & records);
+
+    /** Loads a snapshot previously written with save() */
+    FrozenLexicon(const String & fileName);
+
+    ~FrozenLexicon();
+
+    void save(const String & fileName) const;
+
+    /** Returns the entry for this string, or NULL if not found */
+    const Entry * find(const Char * key) const;
+
+    int getWordCount(const Char * word) const {
+      const Entry * e = find(word);
+      return (e != NULL ? e->wordCount : 0);
+    }
+
+    int getLemmaCount(const Char * lemma) const {
+      const Entry * e = find(lemma);
+      return (e != NULL ? e->lemmaCount : 0);
+    }
+
+    /**
+     * True if the string has all these flags
+     * Strings not in the snapshot have zero counts, hence they are unknown
+     */
+    bool hasFlags(const Char * key, unsigned int flags) const {
+      const Entry * e = find(key);
+      if(e == NULL) return ((flags & ~UNKNOWN_MASK) == 0);
+      return ((e->flags & flags) == flags);
+    }
+
+    int getFeatureIndex(const Char * feature) const {
+      const Entry * e = find(feature);
+      return (e != NULL ? e->featureIndex : -1);
+    }
+
+    /** The frame of this lemma, MAX_NUMBERED_ARGS flags, or NULL */
+    const bool * getFrame(const Char * lemma) const;
+
+    bool isVerbParticle(const Char * verb,
+			const Char * particle) const;
+
+    size_t size() const { return _header->entryCount; }
+
+    size_t imageSize() const { return _imageSize; }
+
+  private:
+    /** Not copyable: snapshots are shared through pointers */
+    FrozenLexicon(const FrozenLexicon &);
+    FrozenLexicon & operator = (const FrozenLexicon &);
+
+    enum { UNKNOWN_MASK = UNKNOWN_WORD | UNKNOWN_LEMMA | UNKNOWN_PRED };
+
+    class Header {
+    public:
+      char magic[4];
+      unsigned int version;
+      unsigned int frameSize;
+      unsigned int entryCount;
+      unsigned int slotCount;
+      unsigned int particleCount;
+      unsigned int frameCount;
+      unsigned int poolSize;
+    };
+
+    static unsigned int hashKey(const Char * key);
+
+    /** Offsets of the sections after the header; returns the image size */
+    static size_t layout(const Header & h, size_t offsets[5]);
+
+    /** Sets the section pointers into _image */
+    void attach();
+
+    char * _image;
+    size_t _imageSize;
+
+    const Header * _header;
+    const Entry * _entries;
+    const unsigned int * _slots;
+    const unsigned int * _particles;
+    const bool * _frames;
+    const Char * _pool;
+  };
+
+} // end namespace srl
+
+#endif
@@ -0,0 +1,129 @@
+
+#include <iostream>
+
+#include "Label.h"
+#include "StringMap.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+/** Label names, in LabelId order */
+static const Char * labelNames [] = {
+  "",
+  "CC", "CD", "DT", "EX", "FW", "IN",
+  "JJ", "JJR", "JJS", "LS", "MD",
+  "NN", "NNS", "NNP", "NNPS", "PDT", "POS",
+  "PRP", "PRP$", "RB", "RBR", "RBS", "RP",
+  "SYM", "TO", "UH",
+  "VB", "VBD", "VBG", "VBN", "VBP", "VBZ",
+  "WDT", "WP", "WP$", "WRB",
+  "AUX", "AUXG",
+  ",", ".", ":", "``", "''",
+  "#", "$", "LRB", "RRB",
+  "ADJP", "ADVP", "CONJP", "FRAG", "INTJ", "LST",
+  "NAC", "NP", "NX", "PP", "PRN", "PRT",
+  "QP", "RRC", "S", "SBAR", "SBARQ", "SINV",
+  "SQ", "UCP", "VP", "WHADJP", "WHADVP", "WHNP",
+  "WHPP", "X", "S1", "TOP",
+  NULL
+};
+
+/** Labels skipped by the label count features */
+static const Char * rareLabels [] = {
+  "S1", "TOP", "LST", "SYM", "LS", "SBARQ", "RRC", "SQ", "X", "SINV",
+  "UH", "INTJ", "WHADJP", "FRAG", "WP$", "FW", "EX", "NX", "UCP", "NAC",
+  "AUXG", "WHPP", "PDT", ".", "WHADVP", "WRB", NULL
+};
+
+static const Char * punctLabels [] = {
+  ",", ".", ":", "``", "''", "LRB", "RRB", NULL
+};
+
+static bool startsWith(const String & s, const Char * prefix)
+{
+  for(size_t i = 0; prefix[i] != 0; i ++){
+    if(i >= s.size() || s[i] != prefix[i]) return false;
+  }
+  return true;
+}
+
+static bool inList(const String & s, const Char ** list)
+{
+  for(int i = 0; list[i] != NULL; i ++){
+    if(s == list[i]) return true;
+  }
+  return false;
+}
+
+/** The category bits, computed from the label string */
+static unsigned short computeCategories(const String & label)
+{
+  unsigned short c = 0;
+  if(startsWith(label, "VB")) c |= LABEL_IS_VERB;
+  if(startsWith(label, "NN")) c |= LABEL_IS_NOUN;
+  if(startsWith(label, "JJ")) c |= LABEL_IS_ADJ;
+  if(startsWith(label, "RB")) c |= LABEL_IS_ADV;
+  if(startsWith(label, "AUX")) c |= LABEL_IS_AUX;
+  if(startsWith(label, "S")) c |= LABEL_IS_CLAUSE;
+  if(startsWith(label, "VP")) c |= LABEL_IS_VP;
+  if(startsWith(label, "NP")) c |= LABEL_IS_NP;
+  if(startsWith(label, "PP")) c |= LABEL_IS_PP;
+  if(inList(label, punctLabels)) c |= LABEL_IS_PUNCT;
+  if(inList(label, rareLabels)) c |= LABEL_IS_RARE;
+  return c;
+}
+
+/** Maps label names to LabelId */
+static StringMap<short> labelIds;
+
+static unsigned short labelCategories[LABEL_COUNT];
+
+/** Builds the table before main() runs, so it is read-only afterwards */
+class LabelTableInitializer {
+public:
+  LabelTableInitializer() {
+    for(int i = 0; labelNames[i] != NULL; i ++){
+      labelIds.set(labelNames[i], (short) i);
+      labelCategories[i] = computeCategories(labelNames[i]);
+    }
+    RVASSERT(labelIds.size() == LABEL_COUNT,
+	     "Label names do not match the LabelId values!");
+    labelCategories[LABEL_OTHER] = 0;
+  }
+};
+
+static LabelTableInitializer labelTableInitializer;
+
+void Label::lookup(const String & label,
+		   short & id,
+		   unsigned short & categories)
+{
+  if(labelIds.get(label.c_str(), id) == true){
+    categories = labelCategories[id];
+  } else {
+    id = LABEL_OTHER;
+    categories = computeCategories(label);
+  }
+}
+
+short Label::getId(const String & label)
+{
+  short id = LABEL_OTHER;
+  labelIds.get(label.c_str(), id);
+  return id;
+}
+
+unsigned short Label::getCategories(const String & label)
+{
+  short id;
+  unsigned short categories;
+  lookup(label, id, categories);
+  return categories;
+}
+
+const Char * Label::getName(short id)
+{
+  RVASSERT(id >= 0 && id < LABEL_COUNT, "Invalid label id: " << id);
+  return labelNames[id];
+}
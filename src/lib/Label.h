@@ -0,0 +1,78 @@
+
+#ifndef SRL_LABEL_H
+#define SRL_LABEL_H
+
+#include "Wide.h"
+
+namespace srl {
+
+  /**
+   * Ids of the Treebank POS tags and phrase labels, plus the extra labels
+   *   produced by Charniak's parser. Any other label is LABEL_OTHER.
+   */
+  enum LabelId {
+    LABEL_OTHER,
+    // POS tags
+    LABEL_CC, LABEL_CD, LABEL_DT, LABEL_EX, LABEL_FW, LABEL_IN,
+    LABEL_JJ, LABEL_JJR, LABEL_JJS, LABEL_LS, LABEL_MD,
+    LABEL_NN, LABEL_NNS, LABEL_NNP, LABEL_NNPS, LABEL_PDT, LABEL_POS,
+    LABEL_PRP, LABEL_PRP_S, LABEL_RB, LABEL_RBR, LABEL_RBS, LABEL_RP,
+    LABEL_SYM, LABEL_TO, LABEL_UH,
+    LABEL_VB, LABEL_VBD, LABEL_VBG, LABEL_VBN, LABEL_VBP, LABEL_VBZ,
+    LABEL_WDT, LABEL_WP, LABEL_WP_S, LABEL_WRB,
+    LABEL_AUX, LABEL_AUXG,
+    // punctuation
+    LABEL_COMMA, LABEL_PERIOD, LABEL_COLON, LABEL_LQUOTE, LABEL_RQUOTE,
+    LABEL_HASH, LABEL_DOLLAR, LABEL_LRB, LABEL_RRB,
+    // phrases
+    LABEL_ADJP, LABEL_ADVP, LABEL_CONJP, LABEL_FRAG, LABEL_INTJ, LABEL_LST,
+    LABEL_NAC, LABEL_NP, LABEL_NX, LABEL_PP, LABEL_PRN, LABEL_PRT,
+    LABEL_QP, LABEL_RRC, LABEL_S, LABEL_SBAR, LABEL_SBARQ, LABEL_SINV,
+    LABEL_SQ, LABEL_UCP, LABEL_VP, LABEL_WHADJP, LABEL_WHADVP, LABEL_WHNP,
+    LABEL_WHPP, LABEL_X, LABEL_S1, LABEL_TOP,
+    LABEL_COUNT
+  };
+
+  /**
+   * Category bits of a label.
+   * Most are prefix tests, such that labels with function tags
+   *   (e.g. NP-SBJ) fall in the same categories as the bare label.
+   */
+  enum LabelCategory {
+    LABEL_IS_VERB = 1,       // VB*
+    LABEL_IS_NOUN = 2,       // NN*
+    LABEL_IS_ADJ = 4,        // JJ*
+    LABEL_IS_ADV = 8,        // RB*
+    LABEL_IS_AUX = 16,       // AUX*
+    LABEL_IS_CLAUSE = 32,    // S* (this includes SYM, as the old tests did)
+    LABEL_IS_PUNCT = 64,     // , . : `` '' LRB RRB
+    LABEL_IS_VP = 128,       // VP*
+    LABEL_IS_NP = 256,       // NP*
+    LABEL_IS_PP = 512,       // PP*
+    LABEL_IS_RARE = 1024     // not used for the label count features
+  };
+
+  /**
+   * Interning table for syntactic labels.
+   * The table is built once, at static initialization, from the Treebank
+   *   tag set and is never modified afterwards; unknown labels are not
+   *   added, they get LABEL_OTHER and categories computed on the fly.
+   */
+  class Label {
+  public:
+    /** Fetches the id and category bits of this label */
+    static void lookup(const String & label,
+		       short & id,
+		       unsigned short & categories);
+
+    static short getId(const String & label);
+
+    static unsigned short getCategories(const String & label);
+
+    /** Label name for this id; empty for LABEL_OTHER */
+    static const Char * getName(short id);
+  };
+
+} // end namespace srl
+
+#endif
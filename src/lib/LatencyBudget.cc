@@ -0,0 +1,157 @@
+
+#include <sstream>
+#include <sys/time.h>
+
+#include "LatencyBudget.h"
+#include "Constants.h"
+#include "Mutex.h"
+#include "PipelineStats.h"
+
+using namespace std;
+using namespace srl;
+
+//
+// running averages of the stage costs at full quality, in ms per word,
+//   shared by all requests of this process
+//
+static double parseCost = 0;
+static double labelCost = 0;
+
+/** Guards the averages above */
+static Mutex costMutex;
+
+/** Weight of the last sentence in the running averages */
+#define COST_DECAY 0.1
+
+/** Never parse with less than this fraction of the usual effort */
+#define MIN_PARSER_EFFORT 0.05
+
+static void updateCost(double & cost, double perWord)
+{
+  MutexLock lock(costMutex);
+  if(cost == 0) cost = perWord;
+  else cost = (1 - COST_DECAY) * cost + COST_DECAY * perWord;
+}
+
+static double getCost(const double & cost)
+{
+  MutexLock lock(costMutex);
+  return cost;
+}
+
+double LatencyBudget::now()
+{
+  struct timeval tv;
+  gettimeofday(& tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/** Recorded when a stage ran past the deadline */
+#define DEADLINE_EXPIRED "deadline-expired"
+
+LatencyBudget::LatencyBudget(double milliseconds, 
+			     double start,
+			     bool degrade)
+  : _start(start > 0 ? start : now()), _limit(milliseconds), 
+    _degrade(degrade), _words(0), _stageStart(0), _degraded(false),
+    _cutShort(false)
+{
+}
+
+double LatencyBudget::getElapsed() const
+{
+  return now() - _start;
+}
+
+double LatencyBudget::startParsing(int words)
+{
+  _words = (words > 0 ? words : 1);
+  _stageStart = now();
+  _degraded = false;
+  if(! isLimited() || ! _degrade) return 1.0;
+
+  // the parser gets its share of the time left, SRL gets the rest
+  double expected = getCost(parseCost) * _words;
+  double labeling = getCost(labelCost) * _words;
+  double available = getRemaining() - labeling;
+  if(expected <= 0 || expected <= available) return 1.0;
+
+  double effort = available / expected;
+  if(effort < MIN_PARSER_EFFORT) effort = MIN_PARSER_EFFORT;
+  _degraded = true;
+
+  ostringstream os;
+  os << "parser-effort=" << effort;
+  _degradations.push_back(os.str());
+  return effort;
+}
+
+void LatencyBudget::checkExpired()
+{
+  if(! isExpired()) return;
+  // the stage was cut short: its time says nothing about its cost
+  _degraded = true;
+  if(_cutShort) return;
+  _cutShort = true;
+  _degradations.push_back(DEADLINE_EXPIRED);
+  PipelineStats::count(STAT_DEADLINE_EXPIRED);
+}
+
+void LatencyBudget::endParsing()
+{
+  checkExpired();
+  // degraded runs would underestimate the cost at full quality
+  if(! _degraded) updateCost(parseCost, (now() - _stageStart) / _words);
+}
+
+void LatencyBudget::startLabeling(int & localBeam, 
+				  double & localConfBeam,
+				  int & globalBeam)
+{
+  localBeam = LOCAL_COUNT_BEAM;
+  localConfBeam = LOCAL_CONF_BEAM;
+  globalBeam = GLOBAL_BEAM;
+  _stageStart = now();
+  _degraded = false;
+  if(! isLimited() || ! _degrade) return;
+
+  double expected = getCost(labelCost) * _words;
+  double available = getRemaining();
+  if(expected <= 0 || expected <= available) return;
+
+  // the beams shrink with the fraction of the expected time still left
+  double fraction = (available > 0 ? available / expected : 0);
+  int local = (int) (LOCAL_COUNT_BEAM * fraction);
+  double conf = LOCAL_CONF_BEAM * fraction;
+  int global = (int) (GLOBAL_BEAM * fraction);
+  if(local < 1) local = 1;
+  // a confidence ratio below 1 would drop the best label too
+  if(conf < 1.0) conf = 1.0;
+  if(global < 1) global = 1;
+  _degraded = true;
+
+  if(local < localBeam){
+    localBeam = local;
+    ostringstream os;
+    os << "local-beam=" << local;
+    _degradations.push_back(os.str());
+  }
+  if(conf < localConfBeam){
+    localConfBeam = conf;
+    ostringstream os;
+    os << "local-conf-beam=" << conf;
+    _degradations.push_back(os.str());
+  }
+  if(global < globalBeam){
+    globalBeam = global;
+    ostringstream os;
+    os << "global-beam=" << global;
+    _degradations.push_back(os.str());
+  }
+}
+
+void LatencyBudget::endLabeling()
+{
+  checkExpired();
+  if(! _degraded) updateCost(labelCost, (now() - _stageStart) / _words);
+}
@@ -0,0 +1,111 @@
+
+#ifndef SRL_LATENCY_BUDGET_H
+#define SRL_LATENCY_BUDGET_H
+
+#include <vector>
+#include <string>
+
+namespace srl {
+
+  /**
+   * Time allowed to process one sentence, split between parsing and SRL
+   * Before each stage, the controller compares the time the stage usually
+   *   takes (averaged over the sentences seen so far, per word) with the
+   *   time left. If the stage would not fit, it reduces the parser effort,
+   *   or the SRL beams, in proportion, and records the degradation.
+   */
+  class LatencyBudget {
+
+  public:
+    /**
+     * milliseconds <= 0 means no limit
+     * @param start When the clock started, as returned by now(); 0 (the
+     *              default) starts it now. Servers start it when the 
+     *              request arrives, so the time it waited counts.
+     * @param degrade If false, only the deadline is enforced: the stages 
+     *                run at full quality until it cuts them short, as 
+     *                for the request timeouts of the servers
+     */
+    LatencyBudget(double milliseconds, 
+		  double start = 0,
+		  bool degrade = true);
+
+    bool isLimited() const { return _limit > 0; }
+
+    /** Wall clock, in milliseconds */
+    static double now();
+
+    /** The deadline, on the now() clock; 0 if there is no limit */
+    double getDeadline() const { return (isLimited() ? _start + _limit : 0); }
+
+    /**
+     * Has the deadline passed? The parser and the classifier check it
+     *   as they go, and abandon the rest of their work once it has
+     */
+    bool isExpired() const { return isLimited() && getRemaining() <= 0; }
+
+    /** Milliseconds since this object was created */
+    double getElapsed() const;
+
+    /** Milliseconds left; negative if the deadline has passed */
+    double getRemaining() const { return _limit - getElapsed(); }
+
+    /**
+     * Starts the parsing stage of a sentence with this many words
+     * @return The parser effort, in (0, 1]
+     */
+    double startParsing(int words);
+
+    /** Ends the parsing stage; records if it ran out of time */
+    void endParsing();
+
+    /**
+     * Starts the SRL stage; sets the beams to use for classification
+     *   (LOCAL_COUNT_BEAM, LOCAL_CONF_BEAM and GLOBAL_BEAM if there is 
+     *   enough time)
+     */
+    void startLabeling(int & localBeam, 
+		       double & localConfBeam,
+		       int & globalBeam);
+
+    /** Ends the SRL stage; records if it ran out of time */
+    void endLabeling();
+
+    /**
+     * The degradations applied so far, e.g. "global-beam=5", or
+     *   "deadline-expired" if a stage was cut short
+     */
+    const std::vector<std::string> & getDegradations() const {
+      return _degradations;
+    }
+
+    /** 
+     * Did the deadline cut a stage short? The result is then partial, 
+     *   or missing
+     */
+    bool isCutShort() const { return _cutShort; }
+
+  private:
+    /** Records that the deadline cut the current stage short, once */
+    void checkExpired();
+
+    double _start;
+    double _limit;
+
+    /** May the stages be degraded to fit the deadline? */
+    bool _degrade;
+
+    int _words;
+    double _stageStart;
+
+    /** Was the current stage degraded? */
+    bool _degraded;
+
+    bool _cutShort;
+
+    std::vector<std::string> _degradations;
+  };
+
+} // end namespace srl
+
+#endif
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cstdio>
 
 #include "Constants.h"
 #include "CharUtils.h"
@@ -26,12 +27,20 @@ StringMap<int> Lexicon::_tmpRB;
 StringMap<FeatureData *> Lexicon::_features;
 int Lexicon::_featureIndex = 1;
 
+int Lexicon::_featureHashBits = 0;
+vector<int> Lexicon::_hashedFreqs;
+vector<unsigned int> Lexicon::_hashedFingerprints;
+int Lexicon::_hashCollisions = 0;
+int Lexicon::_hashCollidedBuckets = 0;
+
 StringMap<bool *> Lexicon::_frames;
 
 StringMap<StringMap<int> *> Lexicon::_validLabels;
 
 StringMap<std::vector<VerbParticle> *> Lexicon::_verbParticles;
 
+FrozenLexicon * Lexicon::_frozen = NULL;
+
 int Lexicon::maxTokenDistance = 0;
 
 Lexicon::Lexicon()
@@ -40,6 +49,8 @@ Lexicon::Lexicon()
 
 int Lexicon::getWordCount(const Char * word)
 {
+  if(_frozen != NULL) return _frozen->getWordCount(word);
+
   int count;
   if(_wordCounts.get(word, count) == true){
     return count;
@@ -50,8 +61,8 @@ int Lexicon::getWordCount(const Char * word)
 
 void Lexicon::addWordCount(const String & word)
 {
-  RCIPtr< StringMapEntry<int> > value = _wordCounts.get(word.c_str());
-  if(value.operator->() == NULL){
+  StringMapEntry<int> * value = _wordCounts.get(word.c_str());
+  if(value == NULL){
     _wordCounts.set(word.c_str(), 1);
   } else{
     value->setValue(value->getValue() + 1);
@@ -60,6 +71,8 @@ void Lexicon::addWordCount(const String & word)
 
 int Lexicon::getLemmaCount(const Char * word)
 {
+  if(_frozen != NULL) return _frozen->getLemmaCount(word);
+
   int count;
   if(_lemmaCounts.get(word, count) == true){
     return count;
@@ -70,8 +83,8 @@ int Lexicon::getLemmaCount(const Char * word)
 
 void Lexicon::addLemmaCount(const String & word)
 {
-  RCIPtr< StringMapEntry<int> > value = _lemmaCounts.get(word.c_str());
-  if(value.operator->() == NULL){
+  StringMapEntry<int> * value = _lemmaCounts.get(word.c_str());
+  if(value == NULL){
     _lemmaCounts.set(word.c_str(), 1);
   } else{
     value->setValue(value->getValue() + 1);
@@ -80,8 +93,8 @@ void Lexicon::addLemmaCount(const String & word)
 
 void Lexicon::addArgLabelCount(const String & label)
 {
-  RCIPtr< StringMapEntry<int> > value = _labelCounts.get(label.c_str());
-  if(value.operator->() == NULL){
+  StringMapEntry<int> * value = _labelCounts.get(label.c_str());
+  if(value == NULL){
     _labelCounts.set(label.c_str(), 1);
   } else{
     value->setValue(value->getValue() + 1);
@@ -90,9 +103,9 @@ void Lexicon::addArgLabelCount(const String & label)
 
 void Lexicon::addSyntacticLabelCount(const String & label)
 {
-  RCIPtr< StringMapEntry<int> > value = 
+  StringMapEntry<int> * value = 
     _syntacticLabelCounts.get(label.c_str());
-  if(value.operator->() == NULL){
+  if(value == NULL){
     _syntacticLabelCounts.set(label.c_str(), 1);
   } else{
     value->setValue(value->getValue() + 1);
@@ -101,9 +114,9 @@ void Lexicon::addSyntacticLabelCount(const String & label)
 
 void Lexicon::addBICount(const String & label)
 {
-  RCIPtr< StringMapEntry<int> > value = 
+  StringMapEntry<int> * value = 
     _biCounts.get(label.c_str());
-  if(value.operator->() == NULL){
+  if(value == NULL){
     _biCounts.set(label.c_str(), 1);
   } else{
     value->setValue(value->getValue() + 1);
@@ -160,6 +173,9 @@ static bool goodParticle(const VerbParticle & part)
 
 void Lexicon::saveCounts(const String & path)
 {
+  // the snapshot is compiled from these counts
+  removeFrozen(path);
+
   string wname = mergeStrings(path, "/word.counts");
   ofstream ws(wname.c_str());
   RVASSERT(ws, "Can not create word count stream!");
@@ -262,11 +278,6 @@ void Lexicon::loadCounts(const String & path)
   ifstream ls(lname.c_str());
   RVASSERT(ls, "Can not open lemma count stream!");
 
-  string sname = mergeStrings(path, "/label.counts");
-  ifstream ss(sname.c_str());
-  RVASSERT(ss, "Can not open label count stream!");
-  
-
   char line[MAX_STATS_LINE];
 
   // load word counts
@@ -295,18 +306,7 @@ void Lexicon::loadCounts(const String & path)
 
   cerr << "Loaded " << _lemmaCounts.size() << " lemmas." << endl;
 
-  // load syntactic label counts
-  while(ss.getline(line, MAX_STATS_LINE)){
-    vector<String> tokens;
-    simpleTokenize(line, tokens, " \t\n\r");
-    if(tokens.size() == 2){
-      int count = strtol(tokens[1].c_str(), NULL, 10);
-      RVASSERT(count > 0, "Invalid count for lemma " << tokens[0]);
-      _syntacticLabelCounts.set(tokens[0].c_str(), count);
-    }
-  }
-  cerr << "Loaded " << _syntacticLabelCounts.size() 
-       << " syntactic labels." << endl;
+  loadLabelCounts(path);
 
   string pname = mergeStrings(path, "/verb.particles");
   ifstream ps(pname.c_str());
@@ -324,6 +324,28 @@ void Lexicon::loadCounts(const String & path)
   }
 }
 
+void Lexicon::loadLabelCounts(const String & path)
+{
+  string sname = mergeStrings(path, "/label.counts");
+  ifstream ss(sname.c_str());
+  RVASSERT(ss, "Can not open label count stream!");
+
+  char line[MAX_STATS_LINE];
+
+  // load syntactic label counts
+  while(ss.getline(line, MAX_STATS_LINE)){
+    vector<String> tokens;
+    simpleTokenize(line, tokens, " \t\n\r");
+    if(tokens.size() == 2){
+      int count = strtol(tokens[1].c_str(), NULL, 10);
+      RVASSERT(count > 0, "Invalid count for lemma " << tokens[0]);
+      _syntacticLabelCounts.set(tokens[0].c_str(), count);
+    }
+  }
+  cerr << "Loaded " << _syntacticLabelCounts.size() 
+       << " syntactic labels." << endl;
+}
+
 void Lexicon::loadTmps(const String & path)
 {
   string tname = mergeStrings(path, "/words.temporal");
@@ -352,6 +374,9 @@ void Lexicon::loadTmps(const String & path)
 
 bool Lexicon::isTmpNN(const Char * word)
 {
+  if(_frozen != NULL) 
+    return _frozen->hasFlags(word, FrozenLexicon::TMP_NN);
+
   int count;
   if(_tmpNN.get(word, count) == true) return true;
   return false;
@@ -359,6 +384,9 @@ bool Lexicon::isTmpNN(const Char * word)
 
 bool Lexicon::isTmpNNP(const Char * word)
 {
+  if(_frozen != NULL) 
+    return _frozen->hasFlags(word, FrozenLexicon::TMP_NNP);
+
   int count;
   if(_tmpNNP.get(word, count) == true) return true;
   return false;
@@ -366,6 +394,9 @@ bool Lexicon::isTmpNNP(const Char * word)
 
 bool Lexicon::isTmpIN(const Char * word)
 {
+  if(_frozen != NULL) 
+    return _frozen->hasFlags(word, FrozenLexicon::TMP_IN);
+
   int count;
   if(_tmpIN.get(word, count) == true) return true;
   return false;
@@ -373,6 +404,9 @@ bool Lexicon::isTmpIN(const Char * word)
 
 bool Lexicon::isTmpRB(const Char * word)
 {
+  if(_frozen != NULL) 
+    return _frozen->hasFlags(word, FrozenLexicon::TMP_RB);
+
   int count;
   if(_tmpRB.get(word, count) == true) return true;
   return false;
@@ -400,6 +434,19 @@ public:
 
 void Lexicon::saveFeatureLexicon(std::ostream & os)
 {
+  //
+  // in hashing mode we save the bucket frequencies instead of the features
+  // the format is unchanged, so feature filtering works as before
+  //
+  if(useFeatureHashing()){
+    for(size_t i = 0; i < _hashedFreqs.size(); i ++){
+      if(_hashedFreqs[i] > 0){
+	os << "#" << i + 1 << " " << i + 1 << " " << _hashedFreqs[i] << endl;
+      }
+    }
+    return;
+  }
+
   vector<SavedFeature> orderedFeatures;
   // orderedFeatures.resize(_featureIndex - 1);
 
@@ -463,9 +510,109 @@ void Lexicon::loadFeatureLexicon(const String & path)
   cerr << "Read " << count - 1 << " features." << endl;
 }
 
+/** 64-bit FNV-1a hash of a feature string */
+static unsigned long long hashFeature(const String & feature)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  for(size_t i = 0; i < feature.size(); i ++){
+    h ^= (unsigned long long) (unsigned char) feature[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+void Lexicon::setFeatureHashBits(int bits, bool trackCollisions)
+{
+  RVASSERT(bits >= 0 && bits <= 30, 
+	   "Invalid number of feature hash bits: " << bits);
+  _featureHashBits = bits;
+  _hashedFreqs.clear();
+  _hashedFingerprints.clear();
+  _hashCollisions = 0;
+  _hashCollidedBuckets = 0;
+  if(bits > 0 && trackCollisions){
+    _hashedFingerprints.resize(1 << bits, 0);
+  }
+}
+
+void Lexicon::saveFeatureHashing(const String & path)
+{
+  string hname = mergeStrings(path, "/feature.hash");
+  if(! useFeatureHashing()){
+    // make sure a stale setup does not hijack the lexicon at runtime
+    remove(hname.c_str());
+    return;
+  }
+  ofstream hs(hname.c_str());
+  RVASSERT(hs, "Can not create feature hash stream!");
+  hs << _featureHashBits << endl;
+}
+
+bool Lexicon::loadFeatureHashing(const String & path)
+{
+  string hname = mergeStrings(path, "/feature.hash");
+  ifstream hs(hname.c_str());
+  if(! hs) return false;
+
+  int bits = 0;
+  hs >> bits;
+  RVASSERT(bits > 0, "Invalid feature hash setup in: " << hname);
+  setFeatureHashBits(bits, false);
+  cerr << "Using hashed features with " << bits << " bits." << endl;
+  return true;
+}
+
+void Lexicon::reportFeatureHashing(std::ostream & os)
+{
+  if(! useFeatureHashing()) return;
+
+  int used = 0;
+  for(size_t i = 0; i < _hashedFreqs.size(); i ++)
+    if(_hashedFreqs[i] > 0) used ++;
+
+  os << "Feature hashing: " << used << " of " << (1 << _featureHashBits)
+     << " buckets used." << endl;
+  if(_hashedFingerprints.size() > 0){
+    os << "Feature hashing: " << _hashCollisions 
+       << " colliding feature occurrences in " << _hashCollidedBuckets
+       << " buckets." << endl;
+  }
+}
+
 int Lexicon::getFeatureIndex(const String & feature,
 			     bool create)
 {
+  if(useFeatureHashing()){
+    unsigned long long h = hashFeature(feature);
+    size_t bucket = (size_t) (h & ((1ULL << _featureHashBits) - 1));
+
+    if(create == true){
+      if(_hashedFreqs.empty()) _hashedFreqs.resize(1 << _featureHashBits, 0);
+      _hashedFreqs[bucket] ++;
+
+      if(_hashedFingerprints.size() > 0){
+	// the high bits are independent of the bucket
+	// 0 marks empty buckets, 1 marks buckets that already collided
+	unsigned int fp = (unsigned int) (h >> 33) + 2;
+	if(_hashedFingerprints[bucket] == 0){
+	  _hashedFingerprints[bucket] = fp;
+	} else if(_hashedFingerprints[bucket] != fp){
+	  // count each bucket once: flip its fingerprint to the reserved 1
+	  if(_hashedFingerprints[bucket] != 1) _hashCollidedBuckets ++;
+	  _hashedFingerprints[bucket] = 1;
+	  _hashCollisions ++;
+	}
+      }
+    }
+
+    return (int) bucket + 1;
+  }
+
+  if(_frozen != NULL){
+    RVASSERT(create == false, "Can not add features to a frozen lexicon!");
+    return _frozen->getFeatureIndex(feature.c_str());
+  }
+
   FeatureData * fd;
   if(_features.get(feature.c_str(), fd) == true){
     if(create == true) fd->_freq ++;
@@ -517,8 +664,10 @@ void Lexicon::loadArgFrames(const String & path)
   cerr << "Read " << count - 1 << " verb frames." << endl;  
 }
 
-bool * Lexicon::getFrame(const String & lemma)
+const bool * Lexicon::getFrame(const String & lemma)
 {
+  if(_frozen != NULL) return _frozen->getFrame(lemma.c_str());
+
   bool * frame = NULL;
   if(_frames.get(lemma.c_str(), frame) == true) return frame;
   return NULL;
@@ -558,6 +707,9 @@ void Lexicon::addVerbParticle(const String & verb,
 bool Lexicon::isVerbParticle(const String & verb,
 			     const String & particle)
 {
+  if(_frozen != NULL) 
+    return _frozen->isVerbParticle(verb.c_str(), particle.c_str());
+
   vector<VerbParticle> * particles = NULL;
   if(_verbParticles.get(verb.c_str(), particles) == false) return false;
   for(size_t i = 0; i < particles->size(); i ++)
@@ -625,18 +777,129 @@ void Lexicon::addThresholdValue(vector<String> & feats,
   }
 }
 
+void Lexicon::freeze()
+{
+  RVASSERT(_frozen == NULL, "The lexicon is already frozen!");
+
+  FrozenLexicon::Records records;
+
+  for(StringMap<int>::const_iterator it = _wordCounts.begin();
+      it != _wordCounts.end(); it ++){
+    records[(* it).second->getKey()].wordCount = (* it).second->getValue();
+  }
+  for(StringMap<int>::const_iterator it = _lemmaCounts.begin();
+      it != _lemmaCounts.end(); it ++){
+    records[(* it).second->getKey()].lemmaCount = (* it).second->getValue();
+  }
+
+  StringMap<int> * tmps[] = { & _tmpNN, & _tmpNNP, & _tmpIN, & _tmpRB };
+  unsigned int tmpFlags[] = { FrozenLexicon::TMP_NN, FrozenLexicon::TMP_NNP,
+			      FrozenLexicon::TMP_IN, FrozenLexicon::TMP_RB };
+  for(int i = 0; i < 4; i ++){
+    for(StringMap<int>::const_iterator it = tmps[i]->begin();
+	it != tmps[i]->end(); it ++){
+      records[(* it).second->getKey()].tmpFlags |= tmpFlags[i];
+    }
+  }
+
+  for(StringMap<FeatureData *>::const_iterator it = _features.begin();
+      it != _features.end(); it ++){
+    records[(* it).second->getKey()].featureIndex = 
+      (* it).second->getValue()->_index;
+  }
+
+  for(StringMap<bool *>::const_iterator it = _frames.begin();
+      it != _frames.end(); it ++){
+    records[(* it).second->getKey()].frame = (* it).second->getValue();
+  }
+
+  for(StringMap<vector<VerbParticle> *>::const_iterator it = 
+	_verbParticles.begin();
+      it != _verbParticles.end(); it ++){
+    const vector<VerbParticle> * particles = (* it).second->getValue();
+    for(size_t i = 0; i < particles->size(); i ++){
+      records[(* it).second->getKey()].particles.push_back
+	((* particles)[i]._word);
+      // the particle strings must be in the pool as well
+      records[(* particles)[i]._word];
+    }
+  }
+
+  _frozen = new FrozenLexicon(records);
+  cerr << "Froze the lexicon: " << _frozen->size() << " strings in " 
+       << _frozen->imageSize() << " bytes." << endl;
+
+  //
+  // the snapshot now owns all this data
+  //
+  for(StringMap<FeatureData *>::const_iterator it = _features.begin();
+      it != _features.end(); it ++) delete (* it).second->getValue();
+  for(StringMap<bool *>::const_iterator it = _frames.begin();
+      it != _frames.end(); it ++) delete [] (* it).second->getValue();
+  for(StringMap<vector<VerbParticle> *>::const_iterator it = 
+	_verbParticles.begin();
+      it != _verbParticles.end(); it ++) delete (* it).second->getValue();
+  _wordCounts.clear();
+  _lemmaCounts.clear();
+  for(int i = 0; i < 4; i ++) tmps[i]->clear();
+  _features.clear();
+  _frames.clear();
+  _verbParticles.clear();
+}
+
+void Lexicon::saveFrozen(const String & path)
+{
+  RVASSERT(_frozen != NULL, "The lexicon must be frozen before saving!");
+  string fname = mergeStrings(path, "/lexicon.frozen");
+  _frozen->save(fname);
+}
+
+bool Lexicon::loadFrozen(const String & path)
+{
+  string fname = mergeStrings(path, "/lexicon.frozen");
+  ifstream fs(fname.c_str());
+  if(! fs) return false;
+  fs.close();
+
+  RVASSERT(_frozen == NULL, "The lexicon is already frozen!");
+  _frozen = new FrozenLexicon(fname);
+  cerr << "Loaded frozen lexicon with " << _frozen->size() 
+       << " strings." << endl;
+  return true;
+}
+
+void Lexicon::removeFrozen(const String & path)
+{
+  string fname = mergeStrings(path, "/lexicon.frozen");
+  remove(fname.c_str());
+}
+
 void Lexicon::initialize(const String & modelPath, 
 			 bool testing)
 {
   cerr << "Loading stats..." << endl;
+
+  // the snapshot replaces everything but the syntactic label counts
+  if(testing && Lexicon::loadFrozen(modelPath)){
+    Lexicon::loadLabelCounts(modelPath);
+    Lexicon::loadFeatureHashing(modelPath);
+    return;
+  }
+
   Lexicon::loadCounts(modelPath);
   Lexicon::loadTmps(modelPath);
   
   if(testing){
-    cerr << "Loading feature dictionary..." << endl;
-    Lexicon::loadFeatureLexicon(modelPath);
+    // models trained with hashed features do not need the lexicon
+    if(! Lexicon::loadFeatureHashing(modelPath)){
+      cerr << "Loading feature dictionary..." << endl;
+      Lexicon::loadFeatureLexicon(modelPath);
+    }
 
     cerr << "Loading argument frames..." << endl;
     Lexicon::loadArgFrames(modelPath);
+
+    // nothing is added at inference time
+    Lexicon::freeze();
   }
 }
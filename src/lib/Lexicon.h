@@ -14,6 +14,7 @@
 #include "Constants.h"
 #include "Pair.h"
 #include "StringMap.h"
+#include "FrozenLexicon.h"
 #include "Wide.h"
 
 #ifndef LEXICON_H
@@ -50,15 +51,21 @@ class Lexicon : public RCObject
   static void addWordCount(const String & word);
   static int getWordCount(const Char * word);
   static bool isUnknownWord(const String & word) { 
+    if(_frozen != NULL) 
+      return _frozen->hasFlags(word.c_str(), FrozenLexicon::UNKNOWN_WORD);
     return (getWordCount(word.c_str()) < UNKNOWN_WORD_THRESHOLD);
   }
 
   static void addLemmaCount(const String & word);
   static int getLemmaCount(const Char * word);
   static bool isUnknownLemma(const String & word) { 
+    if(_frozen != NULL) 
+      return _frozen->hasFlags(word.c_str(), FrozenLexicon::UNKNOWN_LEMMA);
     return (getLemmaCount(word.c_str()) < UNKNOWN_LEMMA_THRESHOLD);
   }
   static bool isUnknownPred(const String & word) { 
+    if(_frozen != NULL) 
+      return _frozen->hasFlags(word.c_str(), FrozenLexicon::UNKNOWN_PRED);
     return (getLemmaCount(word.c_str()) < UNKNOWN_PREDICATE_THRESHOLD);
   }
 
@@ -83,8 +90,44 @@ class Lexicon : public RCObject
   static void saveFeatureLexicon(std::ostream & os);
   static void loadFeatureLexicon(const String & path);
 
+  /**
+   * Enables feature hashing: feature strings are mapped to the indices
+   *   [1, 2^bits] using a 64-bit hash, and the feature lexicon is not used.
+   * bits = 0 disables hashing (the default).
+   * @param trackCollisions If true, keeps a 32-bit fingerprint per bucket
+   *                        to count collisions during sample generation
+   */
+  static void setFeatureHashBits(int bits, bool trackCollisions = false);
+  static int getFeatureHashBits() { return _featureHashBits; }
+  static bool useFeatureHashing() { return (_featureHashBits > 0); }
+
+  /** Saves the hashing setup (feature.hash) next to the models */
+  static void saveFeatureHashing(const String & path);
+  /** Loads feature.hash, if present. Returns true if hashing was enabled */
+  static bool loadFeatureHashing(const String & path);
+
+  /** Reports bucket occupancy and collision counts (training only) */
+  static void reportFeatureHashing(std::ostream & os);
+
   static void loadArgFrames(const String & path);
-  static bool * getFrame(const String & lemma);
+  static const bool * getFrame(const String & lemma);
+
+  /**
+   * Compiles the word/lemma counts, temporal words, feature lexicon,
+   *   verb frames, and verb particles into a read-only FrozenLexicon,
+   *   and releases the mutable maps. All lookups go to the snapshot after
+   *   this call; counts can no longer be added.
+   */
+  static void freeze();
+  static bool isFrozen() { return (_frozen != NULL); }
+  static const FrozenLexicon * getFrozen() { return _frozen; }
+
+  /** Saves the snapshot as lexicon.frozen in the model directory */
+  static void saveFrozen(const String & path);
+  /** Loads lexicon.frozen, if present. Returns true if it was loaded */
+  static bool loadFrozen(const String & path);
+  /** Removes a lexicon.frozen that no longer matches the models */
+  static void removeFrozen(const String & path);
 
   static const StringMap<int> & getSyntacticLabelCounts() 
     { return _syntacticLabelCounts; }
@@ -141,6 +184,15 @@ class Lexicon : public RCObject
   static StringMap<FeatureData *> _features;
   static int _featureIndex;
 
+  /** Feature hashing: log2 of the index space, 0 if disabled */
+  static int _featureHashBits;
+  /** Per-bucket frequencies, replace FeatureData::_freq (training only) */
+  static std::vector<int> _hashedFreqs;
+  /** Per-bucket fingerprints, only if collisions are tracked */
+  static std::vector<unsigned int> _hashedFingerprints;
+  static int _hashCollisions;
+  static int _hashCollidedBuckets;
+
   /** Verb frames */
   static StringMap<bool *> _frames;
 
@@ -152,6 +204,11 @@ class Lexicon : public RCObject
 
   /** Counts for B args that have I conts */
   static StringMap<int> _biCounts;
+
+  /** Read-only snapshot, NULL until freeze() or loadFrozen() */
+  static FrozenLexicon * _frozen;
+
+  static void loadLabelCounts(const String & path);
 };
 
 typedef RCIPtr<srl::Lexicon> LexiconPtr;
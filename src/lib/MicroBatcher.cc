@@ -0,0 +1,339 @@
+
+#include <sstream>
+#include <stdexcept>
+#include <sys/time.h>
+
+#include "MicroBatcher.h"
+#include "Swirl.h"
+#include "AssertLocal.h"
+#include "Exception.h"
+#include "Logger.h"
+#include "PipelineStats.h"
+
+using namespace std;
+using namespace srl;
+
+static double now()
+{
+  return LatencyBudget::now();
+}
+
+/** The sentence has no tokens at all */
+static bool isEmpty(const string & sentence)
+{
+  return sentence.find_first_not_of(" \t\r\n") == string::npos;
+}
+
+MicroBatcher::MicroBatcher(int maxBatch,
+			   double maxWait,
+			   int maxQueued,
+			   int labelThreads)
+  : _maxBatch(maxBatch), _maxWait(maxWait), _maxQueued(maxQueued),
+    _pipeline(NULL), _queued(0), _stopping(false),
+    _batchCount(0), _sentenceCount(0), _maxDepth(0), _totalWait(0),
+    _expiredCount(0)
+{
+  RVASSERT(maxBatch > 0, "Invalid batch size: " << maxBatch);
+  RVASSERT(maxQueued > 0, "Invalid queue size: " << maxQueued);
+  RVASSERT(labelThreads > 0,
+	   "Invalid number of labeling threads: " << labelThreads);
+
+  // room for a whole batch, while the one before it finishes
+  _pipeline = new SwirlPipeline(Swirl::getEngine(), labelThreads, 1,
+				maxBatch + 2 * labelThreads + 2);
+
+  pthread_mutex_init(& _mutex, NULL);
+  pthread_cond_init(& _changed, NULL);
+
+  int error = pthread_create(& _thread, NULL, work, this);
+  if(error != 0) delete _pipeline;
+  RVASSERT(error == 0, "Failed to create batcher thread: " << error);
+}
+
+MicroBatcher::~MicroBatcher()
+{
+  pthread_mutex_lock(& _mutex);
+  _stopping = true;
+  pthread_cond_broadcast(& _changed);
+  pthread_mutex_unlock(& _mutex);
+
+  pthread_join(_thread, NULL);
+
+  // the jobs fed to the pipeline complete normally
+  delete _pipeline;
+
+  for(list<QueuedJob>::iterator it = _queue.begin();
+      it != _queue.end(); it ++){
+    fail(it->job, "Server shutting down");
+  }
+
+  pthread_cond_destroy(& _changed);
+  pthread_mutex_destroy(& _mutex);
+}
+
+bool MicroBatcher::admits(const BatchJob * job) const
+{
+  return (_queued == 0 || _queued + job->sentences.size() <= _maxQueued);
+}
+
+void MicroBatcher::enqueue(BatchJob * job)
+{
+  QueuedJob q;
+  q.job = job;
+  q.arrival = now();
+  _queue.push_back(q);
+  _queued += job->sentences.size();
+  if(_queued > _maxDepth) _maxDepth = _queued;
+  pthread_cond_broadcast(& _changed);
+}
+
+void MicroBatcher::submit(BatchJob * job)
+{
+  pthread_mutex_lock(& _mutex);
+  while(! admits(job)) pthread_cond_wait(& _changed, & _mutex);
+  enqueue(job);
+  pthread_mutex_unlock(& _mutex);
+}
+
+bool MicroBatcher::trySubmit(BatchJob * job)
+{
+  pthread_mutex_lock(& _mutex);
+  bool admitted = admits(job);
+  if(admitted) enqueue(job);
+  pthread_mutex_unlock(& _mutex);
+  return admitted;
+}
+
+size_t MicroBatcher::getQueueDepth()
+{
+  pthread_mutex_lock(& _mutex);
+  size_t depth = _queued;
+  pthread_mutex_unlock(& _mutex);
+  return depth;
+}
+
+void MicroBatcher::printStats(std::ostream & os)
+{
+  pthread_mutex_lock(& _mutex);
+  os << "Micro-batching: " << _batchCount << " batches, "
+     << _sentenceCount << " sentences";
+  if(_batchCount > 0){
+    os << " (" << (double) _sentenceCount / _batchCount << " per batch, "
+       << _totalWait / _sentenceCount << " ms average queue wait)";
+  }
+  if(_expiredCount > 0){
+    os << ", " << _expiredCount << " sentences expired in the queue";
+  }
+  os << ", queue depth " << _queued << " (max " << _maxDepth << ")\n";
+  pthread_mutex_unlock(& _mutex);
+}
+
+void * MicroBatcher::work(void * batcher)
+{
+  ((MicroBatcher *) batcher)->work();
+  return NULL;
+}
+
+void MicroBatcher::work()
+{
+  vector<BatchJob *> batch;
+  vector<BatchJob *> expired;
+
+  pthread_mutex_lock(& _mutex);
+  while(true){
+    while(! _stopping && _queue.empty()){
+      pthread_cond_wait(& _changed, & _mutex);
+    }
+    if(_stopping) break;
+
+    //
+    // wait for the batch to fill up, or for its oldest sentence to
+    //   have waited long enough
+    //
+    double deadline = _queue.front().arrival + _maxWait;
+    while(! _stopping && _queued < (size_t) _maxBatch){
+      double left = deadline - now();
+      if(left <= 0) break;
+
+      struct timeval tv;
+      gettimeofday(& tv, NULL);
+      long usec = tv.tv_usec + (long) (left * 1000);
+      struct timespec ts;
+      ts.tv_sec = tv.tv_sec + usec / 1000000;
+      ts.tv_nsec = (usec % 1000000) * 1000;
+      pthread_cond_timedwait(& _changed, & _mutex, & ts);
+    }
+    if(_stopping) break;
+
+    //
+    // whole jobs, in arrival order, at least one
+    // the jobs whose client gave up already are dropped on the way
+    //
+    batch.clear();
+    expired.clear();
+    size_t size = 0;
+    double start = now();
+    while(! _queue.empty()){
+      BatchJob * job = _queue.front().job;
+      if(job->deadline > 0 && job->deadline <= start){
+	expired.push_back(job);
+	_queued -= job->sentences.size();
+	_expiredCount += job->sentences.size();
+	_queue.pop_front();
+	continue;
+      }
+      if(! batch.empty() && size + job->sentences.size() > (size_t) _maxBatch)
+	break;
+      double wait = start - _queue.front().arrival;
+      _totalWait += wait * job->sentences.size();
+      PipelineStats::record(STAT_QUEUE_WAIT,
+			    (unsigned long long) (wait * 1000));
+      batch.push_back(job);
+      size += job->sentences.size();
+      _queue.pop_front();
+    }
+    _queued -= size;
+    if(! batch.empty()){
+      _batchCount ++;
+      _sentenceCount += size;
+      LOGH << "Batch of " << size << " sentences, " << _queued
+	   << " sentences still queued" << endl;
+    }
+    if(! expired.empty()){
+      LOGH << expired.size() << " jobs expired in the queue" << endl;
+    }
+    // there is room in the queue again
+    pthread_cond_broadcast(& _changed);
+    pthread_mutex_unlock(& _mutex);
+
+    for(size_t i = 0; i < expired.size(); i ++){
+      for(size_t j = 0; j < expired[i]->sentences.size(); j ++)
+	PipelineStats::count(STAT_DEADLINE_EXPIRED);
+      fail(expired[i], DEADLINE_EXPIRED_ERROR);
+    }
+    if(! batch.empty()) process(batch);
+
+    pthread_mutex_lock(& _mutex);
+  }
+  pthread_mutex_unlock(& _mutex);
+}
+
+void MicroBatcher::format(const srl::TreePtr & tree,
+			  const std::string & sentence,
+			  std::ostream & os)
+{
+  Swirl::serialize(tree, sentence.c_str(), os);
+}
+
+/**
+ * Stores the outputs of the pipeline in one job, and completes the job
+ *   after its last sentence. Deletes itself then.
+ */
+class MicroBatcher::JobCallback : public SwirlBatchCallback
+{
+ public:
+  JobCallback(MicroBatcher & batcher,
+	      BatchJob * job,
+	      size_t remaining)
+    : mBatcher(batcher), mJob(job), mRemaining(remaining) {}
+
+  void format(const srl::TreePtr & tree,
+	      const std::string & sentence,
+	      std::ostream & os) {
+    mBatcher.format(tree, sentence, os);
+  }
+
+  double getDeadline(size_t /* index */) {
+    return mJob->deadline;
+  }
+
+  void emit(size_t index,
+	    const srl::TreePtr & tree,
+	    const std::string & output) {
+    FrameResult & result = mJob->results[index];
+    double deadline = mJob->deadline;
+    if(tree != (const Tree *) NULL){
+      result = FrameResult(FRAME_OK, output);
+    } else if(deadline > 0 && deadline <= now()){
+      result = FrameResult(FRAME_FAILED, DEADLINE_EXPIRED_ERROR);
+    } else {
+      // not parsed: the pipeline did not format it
+      result = mBatcher.label(TreePtr(), mJob->sentences[index]);
+    }
+    complete();
+  }
+
+  /** One bad sentence does not fail the others of its job */
+  void fail(size_t index, const std::string & error) {
+    mJob->results[index] = FrameResult(FRAME_FAILED, error);
+    complete();
+  }
+
+ private:
+  /** Called on the emit thread only, so mRemaining needs no lock */
+  void complete() {
+    if(-- mRemaining == 0){
+      mJob->done();
+      delete this;
+    }
+  }
+
+  MicroBatcher & mBatcher;
+  BatchJob * mJob;
+  size_t mRemaining;
+};
+
+FrameResult MicroBatcher::label(const srl::TreePtr & tree,
+				const std::string & sentence)
+{
+  try{
+    ostringstream os;
+    format(tree, sentence, os);
+    return FrameResult(FRAME_OK, os.str());
+  } catch(Exception e){
+    return FrameResult(FRAME_FAILED, e.getMessage());
+  } catch(exception & e){
+    return FrameResult(FRAME_FAILED, e.what());
+  }
+}
+
+void MicroBatcher::fail(BatchJob * job, const std::string & error)
+{
+  job->results.assign(job->sentences.size(), 
+		      FrameResult(FRAME_FAILED, error));
+  job->done();
+}
+
+void MicroBatcher::process(const std::vector<BatchJob *> & jobs)
+{
+  vector<size_t> positions;
+  for(size_t j = 0; j < jobs.size(); j ++){
+    BatchJob * job = jobs[j];
+
+    //
+    // empty sentences fail right away, since the tokenizer does not
+    //   accept them
+    //
+    job->results.assign(job->sentences.size(), FrameResult());
+    positions.clear();
+    for(size_t i = 0; i < job->sentences.size(); i ++){
+      if(isEmpty(job->sentences[i])){
+	job->results[i] = FrameResult(FRAME_FAILED, "Empty sentence");
+      } else {
+	positions.push_back(i);
+      }
+    }
+    // nothing to label in this job
+    if(positions.empty()){
+      job->done();
+      continue;
+    }
+
+    // the job may be done, and gone, once its last sentence is submitted
+    JobCallback * callback = new JobCallback(* this, job, positions.size());
+    for(size_t i = 0; i < positions.size(); i ++){
+      _pipeline->submit(job->sentences[positions[i]], * callback, 
+			positions[i]);
+    }
+  }
+}
@@ -0,0 +1,161 @@
+
+#ifndef SRL_MICRO_BATCHER_H
+#define SRL_MICRO_BATCHER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <list>
+#include <pthread.h>
+
+#include "Tree.h"
+#include "FrameProtocol.h"
+
+/** The error of the sentences abandoned at their deadline */
+#define DEADLINE_EXPIRED_ERROR "Deadline expired"
+
+class SwirlPipeline;
+
+namespace srl {
+
+  /**
+   * A group of sentences submitted to a MicroBatcher together, e.g. the
+   *   sentences of one request frame
+   */
+  class BatchJob {
+
+  public:
+    BatchJob() : deadline(0) {}
+
+    virtual ~BatchJob() {}
+
+    /**
+     * Called once all results are set: on the emit thread of the 
+     *   pipeline, or on the batcher thread if no sentence of the job was
+     *   labeled. The batcher does not use the job after this call.
+     */
+    virtual void done() = 0;
+
+    std::vector<std::string> sentences;
+
+    /**
+     * When the client stops waiting, on the LatencyBudget::now() clock;
+     *   0 (the default) for never. A job still queued at its deadline
+     *   fails without being labeled, and one in progress is cut short.
+     */
+    double deadline;
+
+    /** One result per sentence, set by the batcher */
+    std::vector<FrameResult> results;
+  };
+
+  /**
+   * Gathers the sentences of the jobs submitted within a short window into
+   *   batches, which are fed to one SwirlPipeline together: the parser
+   *   thread then runs back to back over the batch, while the labeling
+   *   threads overlap with it. The pipeline lives as long as the batcher,
+   *   so a batch does not wait for the previous one to drain, nor for 
+   *   threads to start.
+   * A batch starts with the oldest queued sentence, and closes when it has
+   *   maxBatch sentences, or maxWait milliseconds after that sentence
+   *   arrived. Jobs are not split across batches.
+   * At most maxQueued sentences wait for a batch; submit() blocks beyond
+   *   that (a larger job is admitted only into an empty queue).
+   */
+  class MicroBatcher {
+
+  public:
+    MicroBatcher(int maxBatch,
+		 double maxWait,
+		 int maxQueued,
+		 int labelThreads);
+
+    /** Waits for the sentences in the pipeline; the queued jobs fail */
+    ~MicroBatcher();
+
+    /** Admits a job, waiting while the queue is full */
+    void submit(BatchJob * job);
+
+    /** Same as submit(), but returns false instead of waiting */
+    bool trySubmit(BatchJob * job);
+
+    /** Sentences admitted but not in a batch yet */
+    size_t getQueueDepth();
+
+    void printStats(std::ostream & os);
+
+  protected:
+    /**
+     * Formats the result of one sentence; called from the formatting
+     *   threads of the pipeline, so it must not modify shared state
+     * @param tree NULL if the sentence could not be parsed
+     */
+    virtual void format(const srl::TreePtr & tree,
+			const std::string & sentence,
+			std::ostream & os);
+
+  private:
+    MicroBatcher(const MicroBatcher &);
+    MicroBatcher & operator = (const MicroBatcher &);
+
+    struct QueuedJob {
+      BatchJob * job;
+      /** Arrival time, in milliseconds */
+      double arrival;
+    };
+
+    class JobCallback;
+
+    static void * work(void * batcher);
+
+    void work();
+
+    /** Feeds all the sentences of these jobs to the pipeline */
+    void process(const std::vector<BatchJob *> & jobs);
+
+    /** Fails all the sentences of a job, and completes it */
+    void fail(BatchJob * job, const std::string & error);
+
+    /** Formats one result, catching the errors */
+    FrameResult label(const srl::TreePtr & tree, const std::string & sentence);
+
+    /** Can this job enter the queue now? Called with _mutex locked */
+    bool admits(const BatchJob * job) const;
+
+    void enqueue(BatchJob * job);
+
+    int _maxBatch;
+    double _maxWait;
+    size_t _maxQueued;
+
+    /** Parses, labels, and formats the batches, in order */
+    SwirlPipeline * _pipeline;
+
+    pthread_t _thread;
+
+    pthread_mutex_t _mutex;
+
+    /** Broadcast every time the queue changes */
+    pthread_cond_t _changed;
+
+    std::list<QueuedJob> _queue;
+
+    /** Sentences in _queue */
+    size_t _queued;
+
+    bool _stopping;
+
+    //
+    // stats, guarded by _mutex
+    //
+    size_t _batchCount;
+    size_t _sentenceCount;
+    size_t _maxDepth;
+    double _totalWait;
+    /** Sentences dropped from the queue at their deadline */
+    size_t _expiredCount;
+  };
+
+} // end namespace srl
+
+#endif
@@ -0,0 +1,42 @@
+
+#ifndef SRL_MUTEX_H
+#define SRL_MUTEX_H
+
+#include <pthread.h>
+
+namespace srl {
+
+  /** Non-recursive pthread mutex */
+  class Mutex {
+
+  public:
+    Mutex() { pthread_mutex_init(& _mutex, NULL); }
+    ~Mutex() { pthread_mutex_destroy(& _mutex); }
+
+    void lock() { pthread_mutex_lock(& _mutex); }
+    void unlock() { pthread_mutex_unlock(& _mutex); }
+
+  private:
+    Mutex(const Mutex &);
+    Mutex & operator = (const Mutex &);
+
+    pthread_mutex_t _mutex;
+  };
+
+  /** Holds a Mutex for the lifetime of this object */
+  class MutexLock {
+
+  public:
+    MutexLock(Mutex & m) : _mutex(m) { _mutex.lock(); }
+    ~MutexLock() { _mutex.unlock(); }
+
+  private:
+    MutexLock(const MutexLock &);
+    MutexLock & operator = (const MutexLock &);
+
+    Mutex & _mutex;
+  };
+
+} // end namespace srl
+
+#endif
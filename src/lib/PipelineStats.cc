@@ -0,0 +1,184 @@
+
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "PipelineStats.h"
+#include "Mutex.h"
+
+using namespace std;
+using namespace srl;
+
+static const char * HISTOGRAM_NAMES[STAT_HISTOGRAM_COUNT] = {
+  "tokenize_us",
+  "parse_us",
+  "preprocess_us",
+  "features_us",
+  "scoring_us",
+  "reranking_us",
+  "serialize_us",
+  "queue_wait_us",
+  "sentence_words"
+};
+
+static const char * COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+  "sentences",
+  "parse_failures",
+  "cache_hits",
+  "cache_misses",
+  "deadline_expired"
+};
+
+void Histogram::clear()
+{
+  memset(_counts, 0, sizeof(_counts));
+  _count = 0;
+  _sum = 0;
+  _max = 0;
+}
+
+void Histogram::add(const Histogram & other)
+{
+  for(int i = 0; i < HISTOGRAM_BUCKETS; i ++) _counts[i] += other._counts[i];
+  _count += other._count;
+  _sum += other._sum;
+  if(other._max > _max) _max = other._max;
+}
+
+unsigned long long Histogram::highestOf(int bucket)
+{
+  if(bucket < HISTOGRAM_SUB_BUCKETS) return bucket;
+  int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+  unsigned long long lowest =
+    ((unsigned long long) (bucket % HISTOGRAM_SUB_BUCKETS +
+			   HISTOGRAM_SUB_BUCKETS)) << shift;
+  return lowest + (1ULL << shift) - 1;
+}
+
+unsigned long long Histogram::getPercentile(double p) const
+{
+  if(_count == 0) return 0;
+
+  // rank of the value, starting at 1
+  unsigned long long rank = (unsigned long long) (p / 100.0 * _count + 0.5);
+  if(rank < 1) rank = 1;
+  if(rank > _count) rank = _count;
+
+  unsigned long long seen = 0;
+  for(int i = 0; i < HISTOGRAM_BUCKETS; i ++){
+    seen += _counts[i];
+    if(seen >= rank){
+      unsigned long long value = highestOf(i);
+      return (value < _max ? value : _max);
+    }
+  }
+  return _max;
+}
+
+/** What one thread records */
+struct StatShard {
+  Histogram histograms[STAT_HISTOGRAM_COUNT];
+  unsigned long long counters[STAT_COUNTER_COUNT];
+
+  StatShard() { clear(); }
+
+  void clear() {
+    for(int i = 0; i < STAT_HISTOGRAM_COUNT; i ++) histograms[i].clear();
+    for(int i = 0; i < STAT_COUNTER_COUNT; i ++) counters[i] = 0;
+  }
+};
+
+/** Guards the two lists below */
+static Mutex shardMutex;
+
+/** All the shards ever created; they are never freed */
+static vector<StatShard *> allShards;
+
+/** Shards of finished threads */
+static vector<StatShard *> freeShards;
+
+static pthread_key_t shardKey;
+static pthread_once_t shardKeyOnce = PTHREAD_ONCE_INIT;
+
+static void releaseShard(void * shard)
+{
+  MutexLock lock(shardMutex);
+  freeShards.push_back((StatShard *) shard);
+}
+
+static void createShardKey()
+{
+  pthread_key_create(& shardKey, releaseShard);
+}
+
+static StatShard * getShard()
+{
+  pthread_once(& shardKeyOnce, createShardKey);
+  StatShard * shard = (StatShard *) pthread_getspecific(shardKey);
+  if(shard != NULL) return shard;
+
+  {
+    MutexLock lock(shardMutex);
+    if(! freeShards.empty()){
+      shard = freeShards.back();
+      freeShards.pop_back();
+    } else {
+      shard = new StatShard;
+      allShards.push_back(shard);
+    }
+  }
+  pthread_setspecific(shardKey, shard);
+  return shard;
+}
+
+void PipelineStats::record(StatHistogram histogram, unsigned long long value)
+{
+  getShard()->histograms[histogram].record(value);
+}
+
+void PipelineStats::count(StatCounter counter, unsigned long long n)
+{
+  getShard()->counters[counter] += n;
+}
+
+void PipelineStats::print(std::ostream & os)
+{
+  StatShard total;
+  {
+    MutexLock lock(shardMutex);
+    for(size_t i = 0; i < allShards.size(); i ++){
+      for(int j = 0; j < STAT_HISTOGRAM_COUNT; j ++)
+	total.histograms[j].add(allShards[i]->histograms[j]);
+      for(int j = 0; j < STAT_COUNTER_COUNT; j ++)
+	total.counters[j] += allShards[i]->counters[j];
+    }
+  }
+
+  for(int i = 0; i < STAT_COUNTER_COUNT; i ++){
+    os << COUNTER_NAMES[i] << " " << total.counters[i] << "\n";
+  }
+  for(int i = 0; i < STAT_HISTOGRAM_COUNT; i ++){
+    const Histogram & h = total.histograms[i];
+    os << HISTOGRAM_NAMES[i]
+       << " count " << h.getCount()
+       << " mean " << h.getMean()
+       << " p50 " << h.getPercentile(50)
+       << " p90 " << h.getPercentile(90)
+       << " p99 " << h.getPercentile(99)
+       << " max " << h.getMax() << "\n";
+  }
+}
+
+void PipelineStats::reset()
+{
+  MutexLock lock(shardMutex);
+  for(size_t i = 0; i < allShards.size(); i ++) allShards[i]->clear();
+}
+
+unsigned long long PipelineStats::now()
+{
+  struct timeval tv;
+  gettimeofday(& tv, NULL);
+  return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
@@ -0,0 +1,143 @@
+
+#ifndef SRL_PIPELINE_STATS_H
+#define SRL_PIPELINE_STATS_H
+
+#include <iostream>
+
+namespace srl {
+
+  /**
+   * The distributions recorded by PipelineStats
+   * All are latencies in microseconds, except STAT_SENTENCE_LENGTH, which
+   *   is in words
+   */
+  enum StatHistogram {
+    STAT_TOKENIZE = 0,
+    STAT_PARSE,
+    STAT_PREPROCESS,
+    STAT_FEATURES,
+    STAT_SCORING,
+    STAT_RERANKING,
+    STAT_SERIALIZE,
+    STAT_QUEUE_WAIT,
+    STAT_SENTENCE_LENGTH,
+    STAT_HISTOGRAM_COUNT
+  };
+
+  enum StatCounter {
+    STAT_SENTENCES = 0,
+    STAT_PARSE_FAILURES,
+    STAT_CACHE_HITS,
+    STAT_CACHE_MISSES,
+    STAT_DEADLINE_EXPIRED,
+    STAT_COUNTER_COUNT
+  };
+
+  /**
+   * Histogram of non-negative integers with log-linear buckets, in the
+   *   spirit of HdrHistogram: values below 2^HISTOGRAM_SUB_BITS are exact,
+   *   and every larger power of two is split into 2^HISTOGRAM_SUB_BITS
+   *   buckets, so a percentile is off by less than 1/16 of its value
+   */
+  class Histogram {
+
+  public:
+    Histogram() { clear(); }
+
+    void clear();
+
+    void record(unsigned long long value) {
+      _counts[bucketOf(value)] ++;
+      _count ++;
+      _sum += value;
+      if(value > _max) _max = value;
+    }
+
+    void add(const Histogram & other);
+
+    unsigned long long getCount() const { return _count; }
+
+    unsigned long long getMax() const { return _max; }
+
+    double getMean() const {
+      return (_count > 0 ? (double) _sum / _count : 0);
+    }
+
+    /**
+     * Smallest value v such that p percent of the values are <= v, up to
+     *   the resolution of the buckets
+     */
+    unsigned long long getPercentile(double p) const;
+
+  private:
+    static const int HISTOGRAM_SUB_BITS = 4;
+    static const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+    /** Larger values go to the last bucket */
+    static const int HISTOGRAM_MAX_BITS = 40;
+    static const int HISTOGRAM_BUCKETS =
+      (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+    static int bucketOf(unsigned long long value) {
+      if(value < (unsigned long long) HISTOGRAM_SUB_BUCKETS) return (int) value;
+      int msb = 63 - __builtin_clzll(value);
+      if(msb >= HISTOGRAM_MAX_BITS) return HISTOGRAM_BUCKETS - 1;
+      int shift = msb - HISTOGRAM_SUB_BITS;
+      return (shift + 1) * HISTOGRAM_SUB_BUCKETS +
+	(int) (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+    }
+
+    /** Largest value of this bucket */
+    static unsigned long long highestOf(int bucket);
+
+    unsigned long long _counts[HISTOGRAM_BUCKETS];
+    unsigned long long _count;
+    unsigned long long _sum;
+    unsigned long long _max;
+  };
+
+  /**
+   * Process-wide counters and latency histograms of the SRL pipeline
+   * Every thread records into its own shard, without locks; the shards are
+   *   merged when the stats are read. Reads are not synchronized with the
+   *   recording threads, so they may miss the last few events.
+   * The shard of a finished thread is kept, with its counts, and reused
+   *   by the next new thread.
+   */
+  class PipelineStats {
+
+  public:
+    static void record(StatHistogram histogram, unsigned long long value);
+
+    static void count(StatCounter counter, unsigned long long n = 1);
+
+    /** Displays the merged stats, one line per counter or histogram */
+    static void print(std::ostream & os);
+
+    /** Clears the stats of all threads */
+    static void reset();
+
+    /** Current time, in microseconds */
+    static unsigned long long now();
+  };
+
+  /** Records the time from its construction to its destruction */
+  class StatTimer {
+
+  public:
+    StatTimer(StatHistogram histogram)
+      : _histogram(histogram), _start(PipelineStats::now()) {}
+
+    ~StatTimer() {
+      // the wall clock may step back
+      unsigned long long end = PipelineStats::now();
+      PipelineStats::record(_histogram, (end > _start ? end - _start : 0));
+    }
+
+  private:
+    StatHistogram _histogram;
+    unsigned long long _start;
+  };
+
+} // end namespace srl
+
+#endif
@@ -0,0 +1,179 @@
+
+#include <cstdio>
+#include <vector>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "ResultCache.h"
+#include "PipelineStats.h"
+
+using namespace std;
+using namespace srl;
+
+//
+// The store starts with the STORE_MAGIC line, then each entry is 
+//   written as:
+//   <key length> <value length>\n<key><value>\n
+//
+
+/** First line of a store; change the version with the record format */
+#define STORE_MAGIC "SWIRL-RESULT-CACHE 1"
+
+ResultCache::ResultCache(size_t capacity)
+  : _capacity(capacity), _hits(0), _misses(0), _evictions(0), _loaded(0)
+{
+}
+
+ResultCache::Key ResultCache::hash(const std::string & str, Key seed)
+{
+  Key h = seed;
+  for(size_t i = 0; i < str.size(); i ++){
+    h ^= (unsigned char) str[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+bool ResultCache::open(const char * fileName)
+{
+  MutexLock lock(_mutex);
+
+  bool created = true;
+  ifstream is(fileName, ios::in | ios::binary);
+  if(is && is.peek() != EOF){
+    // anything but a store is left alone, since it is trimmed below
+    string header;
+    if(! getline(is, header) || header != STORE_MAGIC) return false;
+    // a store cut by a crash right after its magic starts over
+    created = is.eof();
+
+    // end of the last complete record
+    off_t good = (created ? 0 : (off_t) is.tellg());
+    vector<char> buffer;
+    while(getline(is, header)){
+      unsigned long keyLength = 0;
+      unsigned long length = 0;
+      if(sscanf(header.c_str(), "%lu %lu", & keyLength, & length) != 2) break;
+
+      buffer.resize(keyLength + length + 1);
+      if(! is.read(& buffer[0], keyLength + length + 1)) break;
+      // a record cut by a crash is dropped, with everything after it
+      if(buffer[keyLength + length] != '\n') break;
+
+      string key(& buffer[0], keyLength);
+      insert(hash(key), key, string(& buffer[0] + keyLength, length));
+      _loaded ++;
+      good = is.tellg();
+    }
+
+    // drop the partial record, such that new records can be read back
+    is.clear();
+    is.seekg(0, ios::end);
+    off_t end = is.tellg();
+    is.close();
+    if(good < end && truncate(fileName, good) != 0) return false;
+  }
+
+  _store.open(fileName, ios::out | ios::app | ios::binary);
+  if(created) _store << STORE_MAGIC << "\n" << flush;
+  return _store.good();
+}
+
+bool ResultCache::get(const std::string & key, std::string & value)
+{
+  Key h = hash(key);
+  MutexLock lock(_mutex);
+
+  // the same hash may come from another key
+  map<Key, EntryList::iterator>::iterator it = _index.find(h);
+  if(it == _index.end() || it->second->key != key){
+    _misses ++;
+    PipelineStats::count(STAT_CACHE_MISSES);
+    return false;
+  }
+
+  _entries.splice(_entries.begin(), _entries, it->second);
+  value = it->second->value;
+  _hits ++;
+  PipelineStats::count(STAT_CACHE_HITS);
+  return true;
+}
+
+void ResultCache::put(const std::string & key, const std::string & value)
+{
+  Key h = hash(key);
+  MutexLock lock(_mutex);
+
+  // several threads may have computed the same value
+  if(insert(h, key, value) == false) return;
+
+  if(_store.is_open()){
+    char header[64];
+    sprintf(header, "%lu %lu\n", (unsigned long) key.size(), 
+	    (unsigned long) value.size());
+    _store << header << key << value << "\n";
+    _store.flush();
+  }
+}
+
+bool ResultCache::insert(Key hash,
+			 const std::string & key,
+			 const std::string & value)
+{
+  if(_capacity == 0) return false;
+
+  // a key with the same hash is replaced: the newest entry wins
+  map<Key, EntryList::iterator>::iterator it = _index.find(hash);
+  if(it != _index.end()){
+    Entry & entry = * it->second;
+    bool changed = (entry.key != key || entry.value != value);
+    entry.key = key;
+    entry.value = value;
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return changed;
+  }
+
+  _entries.push_front(Entry());
+  _entries.front().hash = hash;
+  _entries.front().key = key;
+  _entries.front().value = value;
+  _index[hash] = _entries.begin();
+
+  if(_entries.size() > _capacity){
+    _index.erase(_entries.back().hash);
+    _entries.pop_back();
+    _evictions ++;
+  }
+
+  return true;
+}
+
+size_t ResultCache::size()
+{
+  MutexLock lock(_mutex);
+  return _entries.size();
+}
+
+size_t ResultCache::getHits()
+{
+  MutexLock lock(_mutex);
+  return _hits;
+}
+
+size_t ResultCache::getMisses()
+{
+  MutexLock lock(_mutex);
+  return _misses;
+}
+
+void ResultCache::printStats(std::ostream & os)
+{
+  MutexLock lock(_mutex);
+
+  size_t total = _hits + _misses;
+  os << "Result cache: " << _hits << " hits, " << _misses << " misses";
+  if(total > 0) os << " (" << (100.0 * _hits / total) << "% hit rate)";
+  os << ", " << _entries.size() << " entries, "
+     << _evictions << " evictions, "
+     << _loaded << " loaded from disk\n";
+}
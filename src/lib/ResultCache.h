@@ -0,0 +1,97 @@
+
+#ifndef SRL_RESULT_CACHE_H
+#define SRL_RESULT_CACHE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <list>
+#include <map>
+
+#include "Mutex.h"
+
+namespace srl {
+
+  /**
+   * LRU cache of the outputs of already processed sentences
+   * Keys are the normalized inputs. Entries are indexed by the 64-bit
+   *   hash of their key, and each entry keeps its key, so two inputs
+   *   with the same hash never share an output.
+   *   Optionally, every new entry is also appended to a file, which is
+   *   read back by open(), so the cache survives restarts. The file is
+   *   never rewritten: entries evicted from memory stay in it.
+   * All methods are thread safe.
+   */
+  class ResultCache {
+
+  public:
+    typedef unsigned long long Key;
+
+    /** Keeps at most capacity entries in memory */
+    ResultCache(size_t capacity);
+
+    /**
+     * Loads the entries stored in this file, and appends the new ones
+     *   to it; the file is created if it does not exist, or is empty
+     * @return false if the file can not be opened for writing, or if it
+     *         is not a store written by this class (its first line is 
+     *         checked before anything else is read); the file is then 
+     *         not modified
+     */
+    bool open(const char * fileName);
+
+    /** Fetches the output stored under key, and marks it as recently used */
+    bool get(const std::string & key, std::string & value);
+
+    /** Stores value under key, evicting the least recently used entry */
+    void put(const std::string & key, const std::string & value);
+
+    size_t size();
+
+    size_t getHits();
+    size_t getMisses();
+
+    void printStats(std::ostream & os);
+
+    /** FNV-1a hash of a string, continuing from the given hash */
+    static Key hash(const std::string & str, Key seed = HASH_SEED);
+
+    static const Key HASH_SEED = 14695981039346656037ULL;
+
+  private:
+    ResultCache(const ResultCache &);
+    ResultCache & operator = (const ResultCache &);
+
+    struct Entry {
+      Key hash;
+      std::string key;
+      std::string value;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    /** Inserts or updates an entry; must be called with _mutex locked */
+    bool insert(Key hash, const std::string & key, const std::string & value);
+
+    size_t _capacity;
+
+    /** The entries, most recently used first */
+    EntryList _entries;
+
+    /** The entries by the hash of their key */
+    std::map<Key, EntryList::iterator> _index;
+
+    /** Append-only store, if open() was called */
+    std::ofstream _store;
+
+    size_t _hits;
+    size_t _misses;
+    size_t _evictions;
+    size_t _loaded;
+
+    Mutex _mutex;
+  };
+
+} // end namespace srl
+
+#endif
@@ -0,0 +1,237 @@
+
+#include <iostream>
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "ResultRecord.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+#define RECORD_MAGIC 0x53524c41 // "SRLA"
+
+/** Largest count or id that fits in a 16-bit field */
+#define MAX_SHORT 0xffff
+
+static void putShort(string & out, unsigned int value)
+{
+  unsigned short n = htons((unsigned short) value);
+  out.append((const char *) & n, 2);
+}
+
+static void putInt(string & out, unsigned int value)
+{
+  unsigned int n = htonl(value);
+  out.append((const char *) & n, 4);
+}
+
+static unsigned int getShort(const char * data, size_t offset)
+{
+  unsigned short n;
+  memcpy(& n, data + offset, 2);
+  return ntohs(n);
+}
+
+static unsigned int getInt(const char * data, size_t offset)
+{
+  unsigned int n;
+  memcpy(& n, data + offset, 4);
+  return ntohl(n);
+}
+
+void ResultWriter::clear()
+{
+  _ids.clear();
+  _strings.clear();
+  _tokens.clear();
+  _predicates.clear();
+  _arguments.clear();
+}
+
+unsigned int ResultWriter::intern(const std::string & s)
+{
+  map<string, unsigned int>::iterator it = _ids.find(s);
+  if(it != _ids.end()) return it->second;
+
+  RVASSERT(_strings.size() < MAX_SHORT, "Too many strings in one record!");
+  unsigned int id = _strings.size();
+  it = _ids.insert(make_pair(s, id)).first;
+  _strings.push_back(& it->first);
+  return id;
+}
+
+void ResultWriter::addToken(const std::string & word,
+			    const std::string & lemma,
+			    const std::string & pos)
+{
+  RVASSERT(_tokens.size() / 3 < MAX_SHORT, "Too many tokens in one record!");
+  _tokens.push_back(intern(word));
+  _tokens.push_back(intern(lemma));
+  _tokens.push_back(intern(pos));
+}
+
+void ResultWriter::addPredicate(int position)
+{
+  _predicates.push_back(position);
+}
+
+void ResultWriter::addArgument(int predicate,
+			       const std::string & label,
+			       int start,
+			       int end,
+			       double prob)
+{
+  RecordArgument arg;
+  arg.predicate = predicate;
+  arg.label = intern(label);
+  arg.start = start;
+  arg.end = end;
+  arg.prob = (float) prob;
+  _arguments.push_back(arg);
+}
+
+void ResultWriter::encode(std::string & out) const
+{
+  RVASSERT(_predicates.size() <= MAX_SHORT && _arguments.size() <= MAX_SHORT,
+	   "Too many arguments in one record!");
+
+  putInt(out, RECORD_MAGIC);
+
+  putShort(out, _strings.size());
+  unsigned int end = 0;
+  for(size_t i = 0; i < _strings.size(); i ++){
+    end += _strings[i]->size();
+    putInt(out, end);
+  }
+  for(size_t i = 0; i < _strings.size(); i ++){
+    out.append(* _strings[i]);
+  }
+
+  putShort(out, _tokens.size() / 3);
+  for(size_t i = 0; i < _tokens.size(); i ++){
+    putShort(out, _tokens[i]);
+  }
+
+  putShort(out, _predicates.size());
+  for(size_t i = 0; i < _predicates.size(); i ++){
+    putShort(out, _predicates[i]);
+  }
+
+  putShort(out, _arguments.size());
+  for(size_t i = 0; i < _arguments.size(); i ++){
+    const RecordArgument & arg = _arguments[i];
+    putShort(out, arg.predicate);
+    putShort(out, arg.label);
+    putShort(out, arg.start);
+    putShort(out, arg.end);
+    unsigned int bits;
+    memcpy(& bits, & arg.prob, 4);
+    putInt(out, bits);
+  }
+}
+
+ResultReader::ResultReader(const char * data, size_t size)
+  : _data(data)
+{
+  size_t offset = 0;
+  RVASSERT(size >= 6 && getInt(data, 0) == RECORD_MAGIC,
+	   "Invalid record magic!");
+  offset += 4;
+
+  _stringCount = getShort(data, offset);
+  offset += 2;
+  _stringEnds = offset;
+  RVASSERT(4 * _stringCount <= size - offset, "Truncated record!");
+  offset += 4 * _stringCount;
+  _stringBytes = offset;
+  size_t previous = 0;
+  for(size_t i = 0; i < _stringCount; i ++){
+    size_t end = getInt(data, _stringEnds + 4 * i);
+    RVASSERT(end >= previous, "Invalid string table!");
+    previous = end;
+  }
+  RVASSERT(previous <= size - offset, "Truncated record!");
+  offset += previous;
+
+  RVASSERT(2 <= size - offset, "Truncated record!");
+  _tokenCount = getShort(data, offset);
+  offset += 2;
+  _tokens = offset;
+  RVASSERT(6 * _tokenCount <= size - offset, "Truncated record!");
+  offset += 6 * _tokenCount;
+  for(size_t i = 0; i < 3 * _tokenCount; i ++){
+    RVASSERT(getShort(data, _tokens + 2 * i) < _stringCount,
+	     "Invalid string id!");
+  }
+
+  RVASSERT(2 <= size - offset, "Truncated record!");
+  _predicateCount = getShort(data, offset);
+  offset += 2;
+  _predicates = offset;
+  RVASSERT(2 * _predicateCount <= size - offset, "Truncated record!");
+  offset += 2 * _predicateCount;
+  for(size_t i = 0; i < _predicateCount; i ++){
+    RVASSERT(getShort(data, _predicates + 2 * i) < _tokenCount,
+	     "Invalid predicate position!");
+  }
+
+  RVASSERT(2 <= size - offset, "Truncated record!");
+  _argumentCount = getShort(data, offset);
+  offset += 2;
+  _arguments = offset;
+  RVASSERT(12 * _argumentCount <= size - offset, "Truncated record!");
+  offset += 12 * _argumentCount;
+  for(size_t i = 0; i < _argumentCount; i ++){
+    size_t arg = _arguments + 12 * i;
+    RVASSERT(getShort(data, arg + 2) < _stringCount, "Invalid string id!");
+    size_t start = getShort(data, arg + 4);
+    size_t end = getShort(data, arg + 6);
+    RVASSERT(getShort(data, arg) < _tokenCount && 
+	     start <= end && end < _tokenCount,
+	     "Invalid argument span!");
+  }
+
+  _size = offset;
+}
+
+const char * ResultReader::getString(size_t id, size_t & length) const
+{
+  RVASSERT(id < _stringCount, "Invalid string id: " << id);
+  size_t start = (id > 0 ? getInt(_data, _stringEnds + 4 * (id - 1)) : 0);
+  length = getInt(_data, _stringEnds + 4 * id) - start;
+  return _data + _stringBytes + start;
+}
+
+std::string ResultReader::getString(size_t id) const
+{
+  size_t length;
+  const char * s = getString(id, length);
+  return string(s, length);
+}
+
+size_t ResultReader::tokenField(size_t token, size_t field) const
+{
+  RVASSERT(token < _tokenCount, "Invalid token: " << token);
+  return getShort(_data, _tokens + 6 * token + 2 * field);
+}
+
+int ResultReader::getPredicate(size_t index) const
+{
+  RVASSERT(index < _predicateCount, "Invalid predicate: " << index);
+  return getShort(_data, _predicates + 2 * index);
+}
+
+RecordArgument ResultReader::getArgument(size_t index) const
+{
+  RVASSERT(index < _argumentCount, "Invalid argument: " << index);
+  size_t offset = _arguments + 12 * index;
+  RecordArgument arg;
+  arg.predicate = getShort(_data, offset);
+  arg.label = getShort(_data, offset + 2);
+  arg.start = getShort(_data, offset + 4);
+  arg.end = getShort(_data, offset + 6);
+  unsigned int bits = getInt(_data, offset + 8);
+  memcpy(& arg.prob, & bits, 4);
+  return arg;
+}
@@ -0,0 +1,156 @@
+
+#ifndef SRL_RESULT_RECORD_H
+#define SRL_RESULT_RECORD_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace srl {
+
+  /**
+   * Compact binary record of the result of one sentence, an alternative
+   *   to the extended CoNLL text for programs that consume the results
+   * All integers are in network byte order:
+   *   magic ("SRLA", 32 bits);
+   *   string table: string count (16 bits), then the end offset of each
+   *     string in the bytes that follow (32 bits each), then the bytes;
+   *   token count (16 bits), then for each token the ids of its word,
+   *     lemma and POS tag in the string table (16 bits each);
+   *   predicate count (16 bits), then the position of each predicate
+   *     (16 bits each);
+   *   argument count (16 bits), then for each argument its predicate
+   *     position, the id of its label in the string table, its first and
+   *     last token (16 bits each), and its probability (the bits of an
+   *     IEEE float, 32 bits).
+   * Each string appears once in the table, so repeated lemmas, tags and
+   *   labels cost two bytes per use.
+   * This file does not depend on the rest of the SRL system: a consumer
+   *   can compile ResultRecord.cc alone to read the records.
+   */
+
+  /** One argument of a record */
+  struct RecordArgument {
+    /** Position of the predicate */
+    int predicate;
+
+    /** Id of the label in the string table */
+    int label;
+
+    /** First and last token, inclusive */
+    int start;
+    int end;
+
+    float prob;
+  };
+
+  /**
+   * Builds the record of one sentence
+   */
+  class ResultWriter {
+
+  public:
+    ResultWriter() {}
+
+    /** Starts a new record */
+    void clear();
+
+    void addToken(const std::string & word,
+		  const std::string & lemma,
+		  const std::string & pos);
+
+    void addPredicate(int position);
+
+    void addArgument(int predicate,
+		     const std::string & label,
+		     int start,
+		     int end,
+		     double prob);
+
+    /** Appends the record to out */
+    void encode(std::string & out) const;
+
+  private:
+    /** _strings points into the keys of _ids: not copyable */
+    ResultWriter(const ResultWriter &);
+    ResultWriter & operator = (const ResultWriter &);
+
+    /** Id of this string in the table, added if new */
+    unsigned int intern(const std::string & s);
+
+    std::map<std::string, unsigned int> _ids;
+
+    std::vector<const std::string *> _strings;
+
+    /** Word, lemma and POS ids of each token */
+    std::vector<unsigned int> _tokens;
+
+    std::vector<int> _predicates;
+
+    std::vector<RecordArgument> _arguments;
+  };
+
+  /**
+   * Reads one record in place: the data must outlive the reader
+   * The constructor checks the whole record, including that every
+   *   predicate and argument span is within the tokens, and throws
+   *   std::runtime_error if it is malformed; the accessors then read the
+   *   fields straight from the data.
+   */
+  class ResultReader {
+
+  public:
+    ResultReader(const char * data, size_t size);
+
+    /** Bytes of the record, which may be shorter than the data */
+    size_t getSize() const { return _size; }
+
+    size_t getStringCount() const { return _stringCount; }
+
+    /** A string of the table, not NUL-terminated */
+    const char * getString(size_t id, size_t & length) const;
+
+    std::string getString(size_t id) const;
+
+    size_t getTokenCount() const { return _tokenCount; }
+
+    size_t getWordId(size_t token) const { return tokenField(token, 0); }
+
+    size_t getLemmaId(size_t token) const { return tokenField(token, 1); }
+
+    size_t getPosId(size_t token) const { return tokenField(token, 2); }
+
+    size_t getPredicateCount() const { return _predicateCount; }
+
+    int getPredicate(size_t index) const;
+
+    size_t getArgumentCount() const { return _argumentCount; }
+
+    RecordArgument getArgument(size_t index) const;
+
+  private:
+    size_t tokenField(size_t token, size_t field) const;
+
+    const char * _data;
+
+    size_t _size;
+
+    size_t _stringCount;
+    /** Offset of the end offsets of the strings */
+    size_t _stringEnds;
+    /** Offset of the string bytes */
+    size_t _stringBytes;
+
+    size_t _tokenCount;
+    size_t _tokens;
+
+    size_t _predicateCount;
+    size_t _predicates;
+
+    size_t _argumentCount;
+    size_t _arguments;
+  };
+
+} // end namespace srl
+
+#endif
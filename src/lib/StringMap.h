@@ -1,8 +1,8 @@
 
-#include "RCIPtr.h"
-#include "HashMap.h"
-#include "CharArrayEqualFunc.h"
-#include "CharArrayHashFunc.h"
+#include <vector>
+#include <string>
+#include <utility>
+
 #include "Wide.h"
 
 #ifndef STRING_MAP_H
@@ -10,99 +10,212 @@
 
 namespace srl {
 
+  /**
+   * Bump allocator for the keys of a StringMap.
+   * Keys are never freed individually; all blocks go away with the arena.
+   * Blocks start small and double in size, such that the many tiny maps
+   *   (e.g. the per-phrase label counts) do not pay for a large block.
+   */
+  class StringArena {
+
+  public:
+    StringArena() : _current(NULL), _left(0), _nextBlockSize(MIN_BLOCK) {}
+
+    ~StringArena() { clear(); }
+
+    /** Copies the first len characters of s, plus a terminating 0 */
+    const Char * copy(const Char * s, size_t len) {
+      Char * out = NULL;
+
+      if(len + 1 > MAX_BLOCK / 4){
+	// long keys get their own block, the current one stays open
+	out = new Char[len + 1];
+	_blocks.push_back(out);
+      } else {
+	if(len + 1 > _left){
+	  while(_nextBlockSize < len + 1) _nextBlockSize *= 2;
+	  _current = new Char[_nextBlockSize];
+	  _blocks.push_back(_current);
+	  _left = _nextBlockSize;
+	  if(_nextBlockSize < MAX_BLOCK) _nextBlockSize *= 2;
+	}
+	out = _current;
+	_current += len + 1;
+	_left -= len + 1;
+      }
+
+      for(size_t i = 0; i < len; i ++) out[i] = s[i];
+      out[len] = 0;
+      return out;
+    }
+
+    void clear() {
+      for(size_t i = 0; i < _blocks.size(); i ++) delete [] _blocks[i];
+      _blocks.clear();
+      _current = NULL;
+      _left = 0;
+      _nextBlockSize = MIN_BLOCK;
+    }
+
+  private:
+    /** Not copyable: the owning map re-inserts its keys instead */
+    StringArena(const StringArena &);
+    StringArena & operator = (const StringArena &);
+
+    enum { MIN_BLOCK = 64, MAX_BLOCK = 8192 };
+
+    std::vector<Char *> _blocks;
+    Char * _current;
+    size_t _left;
+    size_t _nextBlockSize;
+  };
+
+  template <class T> class StringMap;
+
+  /**
+   * One slot of a StringMap.
+   * The key points into the map's arena; a NULL key marks an empty slot.
+   */
   template <class T>
-  class StringMapEntry : public RCObject {
+  class StringMapEntry {
 
   public:
-    StringMapEntry(Char * key,
-		   const T & value) {
-      _key = key;
-      _value = value;
-    };
+    StringMapEntry() : _key(NULL), _hash(0), _value() {}
 
-    Char * getKey() const { return _key; };
+    const Char * getKey() const { return _key; };
 
     const T & getValue() const { return _value; };
 
     void setValue(const T & v) { _value = v; };
 
-    ~StringMapEntry() {
-      delete [] _key;
-    };
-
   private:
-    Char * _key;
+    friend class StringMap<T>;
+
+    const Char * _key;
+    size_t _hash;
     T _value;
   };
 
+  /**
+   * Iterates over the occupied slots of a StringMap.
+   * (* it).second points to the entry, as with the old hash_map-based map.
+   */
+  template <class E>
+  class StringMapIterator {
+
+  public:
+    typedef std::pair<const Char *, E *> value_type;
+
+    StringMapIterator() : _slot(NULL), _end(NULL) {}
+
+    StringMapIterator(E * slot, E * end) : _slot(slot), _end(end) { skip(); }
+
+    value_type operator * () const {
+      return value_type(_slot->getKey(), _slot);
+    }
+
+    StringMapIterator & operator ++ () {
+      _slot ++;
+      skip();
+      return * this;
+    }
+
+    StringMapIterator operator ++ (int) {
+      StringMapIterator old(* this);
+      ++ (* this);
+      return old;
+    }
+
+    bool operator == (const StringMapIterator & other) const
+      { return _slot == other._slot; }
+
+    bool operator != (const StringMapIterator & other) const
+      { return _slot != other._slot; }
+
+  private:
+    void skip() {
+      while(_slot != _end && _slot->getKey() == NULL) _slot ++;
+    }
+
+    E * _slot;
+    E * _end;
+  };
+
+  /**
+   * Map from 0-terminated strings to values.
+   * Open addressing with linear probing: the values are stored inline in
+   *   the slot array, and the keys are copied into a bump arena owned by
+   *   the map. A lookup touches one slot array and one key.
+   * Entries can not be removed. Entry pointers returned by get() are
+   *   invalidated by the next insertion.
+   */
   template <class T>
   class StringMap {
 
   public:
 
-    typedef typename srl::HashMap<const Char *, RCIPtr< StringMapEntry<T> >,
-      srl::CharArrayHashFunc, srl::CharArrayEqualFunc>::iterator 
-      iterator;
+    typedef StringMapIterator< StringMapEntry<T> > iterator;
 
-    typedef typename srl::HashMap<const Char *, RCIPtr< StringMapEntry<T> >,
-      srl::CharArrayHashFunc, srl::CharArrayEqualFunc>::const_iterator 
-      const_iterator;
+    typedef StringMapIterator< const StringMapEntry<T> > const_iterator;
+
+    StringMap() : _size(0) {}
+
+    StringMap(const StringMap & other) : _size(0) { copyFrom(other); }
+
+    StringMap & operator = (const StringMap & other) {
+      if(& other != this){
+	clear();
+	copyFrom(other);
+      }
+      return * this;
+    }
 
     bool set(const Char * key, const T & value) {
-      if(contains(key)){
+      size_t len = 0;
+      size_t hash = hashKey(key, len);
+      if(_size > 0 && _slots[findSlot(key, hash)]._key != NULL){
 	return false;
       }
-      
-      int keyLen = 0;
-      for(; key[keyLen] != 0; keyLen ++);
-      
-      Char * newKey = new Char[keyLen + 1];
-      for(int i = 0; i < keyLen; i ++) newKey[i] = key[i];
-      newKey[keyLen] = '\0';
-      
-      RCIPtr< StringMapEntry<T> > p(new StringMapEntry<T>(newKey, value));
-      _map[p->getKey()] = p;
-      
+      insertNew(key, len, hash, value);
       return true;
     }
 
     bool overwrite(const Char * key, const T & value) {
-      if(contains(key)){
-	iterator it = _map.find(key);
-	(* it).second->setValue(value);
+      StringMapEntry<T> * e = get(key);
+      if(e != NULL){
+	e->_value = value;
 	return true;
-      } else {
-	return set(key, value);
       }
+      return set(key, value);
     }
 
     bool get(const Char * key, T & value) const {
-      const_iterator it;
-      
-      if((it = _map.find(key)) != _map.end()){
-	value = (* it).second->getValue();
+      const StringMapEntry<T> * e = get(key);
+      if(e != NULL){
+	value = e->_value;
 	return true;
       }
-      
       return false;
     }
 
-    RCIPtr< StringMapEntry<T> > get(const Char * key) const {
-      const_iterator it;
-      
-      if((it = _map.find(key)) != _map.end()){
-	return (* it).second;
-      }
-      
-      return RCIPtr< StringMapEntry<T> >();
+    /** Returns the entry for this key, or NULL if not found */
+    StringMapEntry<T> * get(const Char * key) {
+      if(_size == 0) return NULL;
+      size_t len = 0;
+      StringMapEntry<T> & e = _slots[findSlot(key, hashKey(key, len))];
+      return (e._key != NULL ? & e : NULL);
+    }
+
+    /** Returns the entry for this key, or NULL if not found */
+    const StringMapEntry<T> * get(const Char * key) const {
+      if(_size == 0) return NULL;
+      size_t len = 0;
+      const StringMapEntry<T> & e = _slots[findSlot(key, hashKey(key, len))];
+      return (e._key != NULL ? & e : NULL);
     }
 
     bool contains(const Char * key) const {
-      if(_map.find(key) != _map.end()){
-	return true;
-      }
-      
-      return false;
+      return (get(key) != NULL);
     }
 
     void getKeys(std::vector<std::string> & keys) const {
@@ -111,24 +224,109 @@ namespace srl {
       }
     }
 
-    size_t size() const { return _map.size(); };
+    size_t size() const { return _size; };
+
+    bool empty() const { return (_size == 0); };
+
+    void clear() {
+      _slots.clear();
+      _arena.clear();
+      _size = 0;
+    }
+
+    const_iterator begin() const {
+      if(_slots.empty()) return const_iterator();
+      return const_iterator(& _slots[0], & _slots[0] + _slots.size());
+    };
 
-    bool empty() const { return _map.empty(); };
+    const_iterator end() const {
+      if(_slots.empty()) return const_iterator();
+      return const_iterator(& _slots[0] + _slots.size(),
+			    & _slots[0] + _slots.size());
+    };
 
-    const_iterator begin() const { return _map.begin(); };
+    iterator mbegin() {
+      if(_slots.empty()) return iterator();
+      return iterator(& _slots[0], & _slots[0] + _slots.size());
+    };
 
-    const_iterator end() const { return _map.end(); };
+    iterator mend() {
+      if(_slots.empty()) return iterator();
+      return iterator(& _slots[0] + _slots.size(),
+		      & _slots[0] + _slots.size());
+    };
 
-    iterator mbegin() { return _map.begin(); };
+  private:
 
-    iterator mend() { return _map.end(); };
+    /** 64-bit FNV-1a on 64-bit platforms, the 32-bit variant otherwise */
+    static size_t hashKey(const Char * key, size_t & len) {
+      size_t h = (sizeof(size_t) > 4 ?
+		  (size_t) 14695981039346656037ULL : (size_t) 2166136261UL);
+      size_t prime = (sizeof(size_t) > 4 ?
+		      (size_t) 1099511628211ULL : (size_t) 16777619UL);
+      for(len = 0; key[len] != 0; len ++){
+	h ^= (size_t) key[len];
+	h *= prime;
+      }
+      return h;
+    }
+
+    static bool equalKeys(const Char * s1, const Char * s2) {
+      for(; * s1 == * s2; s1 ++, s2 ++){
+	if(* s1 == 0) return true;
+      }
+      return false;
+    }
+
+    /** Slot holding this key, or the empty slot where it would go */
+    size_t findSlot(const Char * key, size_t hash) const {
+      size_t mask = _slots.size() - 1;
+      size_t i = hash & mask;
+      while(_slots[i]._key != NULL){
+	if(_slots[i]._hash == hash && equalKeys(_slots[i]._key, key)) break;
+	i = (i + 1) & mask;
+      }
+      return i;
+    }
+
+    void insertNew(const Char * key, size_t len, size_t hash, const T & value) {
+      // keep the load factor under 3/4
+      if((_size + 1) * 4 > _slots.size() * 3){
+	grow(_slots.empty() ? 8 : _slots.size() * 2);
+      }
+
+      StringMapEntry<T> & e = _slots[findSlot(key, hash)];
+      e._key = _arena.copy(key, len);
+      e._hash = hash;
+      e._value = value;
+      _size ++;
+    }
+
+    /** Rehashes into a table of the given size, a power of 2 */
+    void grow(size_t capacity) {
+      std::vector< StringMapEntry<T> > old(capacity);
+      old.swap(_slots);
+
+      size_t mask = capacity - 1;
+      for(size_t j = 0; j < old.size(); j ++){
+	if(old[j]._key == NULL) continue;
+	size_t i = old[j]._hash & mask;
+	while(_slots[i]._key != NULL) i = (i + 1) & mask;
+	_slots[i] = old[j];
+      }
+    }
+
+    void copyFrom(const StringMap & other) {
+      for(const_iterator it = other.begin(); it != other.end(); it ++){
+	set((* it).second->getKey(), (* it).second->getValue());
+      }
+    }
 
-  protected:
+    std::vector< StringMapEntry<T> > _slots;
 
-    srl::HashMap<const Char *, RCIPtr< StringMapEntry<T> >,
-      srl::CharArrayHashFunc,
-      srl::CharArrayEqualFunc> _map;
+    size_t _size;
 
+    StringArena _arena;
   };
 
 } // end namespace srl
@@ -2,6 +2,11 @@
  * Interface to the SRL classifier 
  */
 
+#include <algorithm>
+#include <sstream>
+#include <dirent.h>
+#include <sys/stat.h>
+
 #include "Swirl.h"
 #include "ParserApi.h"
 #include "Constants.h"
@@ -13,23 +18,72 @@
 #include "Logger.h"
 #include "Wnet.h"
 #include "BankTreeProducer.h"
+#include "PipelineStats.h"
+#include "ResultRecord.h"
 
 using namespace std;
 using namespace srl;
 
-bool Swirl::mCaseSensitive = true;
-bool Swirl::mIsInitialized = false;
+bool SwirlEngine::mModelsLoaded = false;
+std::string SwirlEngine::mLexiconDirectory;
+bool SwirlEngine::mLexiconFailed = false;
 
-bool Swirl::initialize(const char * srlDataDirectory,
-		       const char * parserDataDirectory,
-		       bool caseSensitive)
+SwirlEngine Swirl::mEngine;
+SwirlContext Swirl::mContext(Swirl::mEngine);
+
+/**
+ * Adds the names, sizes, and modification times of the files in this
+ *   directory to the hash
+ */
+static ResultCache::Key hashDirectory(const char * directory,
+				      ResultCache::Key hash)
 {
-  if(mIsInitialized){
+  vector<string> names;
+  DIR * dir = opendir(directory);
+  if(dir == NULL) return ResultCache::hash(directory, hash);
+  for(struct dirent * entry = readdir(dir); entry != NULL; 
+      entry = readdir(dir)){
+    names.push_back(entry->d_name);
+  }
+  closedir(dir);
+
+  // readdir() does not return the files in any particular order
+  sort(names.begin(), names.end());
+
+  for(size_t i = 0; i < names.size(); i ++){
+    string path = string(directory) + "/" + names[i];
+    struct stat info;
+    if(stat(path.c_str(), & info) != 0 || ! S_ISREG(info.st_mode)) continue;
+
+    ostringstream os;
+    os << names[i] << " " << info.st_size << " " << info.st_mtime << "\n";
+    hash = ResultCache::hash(os.str(), hash);
+  }
+  return hash;
+}
+
+bool SwirlEngine::initialize(const char * srlDataDirectory,
+			     const char * parserDataDirectory,
+			     bool caseSensitive)
+{
+  if(mModelsLoaded){
     cerr << "Already initialized.\n";
     return false;
   }
 
-  // load SRL models
+  // the lexicon can not be loaded twice: a retry after a later stage 
+  //   failed keeps it, so it must name the same directory
+  if(mLexiconFailed){
+    cerr << "The SRL lexicon failed to load. Can not retry.\n";
+    return false;
+  }
+  if(! mLexiconDirectory.empty() && mLexiconDirectory != srlDataDirectory){
+    cerr << "The SRL lexicon is already loaded from " 
+	 << mLexiconDirectory << ".\n";
+    return false;
+  }
+
+  // load SRL models; they replace those of a failed call
   cerr << "Loading models..." << endl;
   Tree::loadClassifierModels(srlDataDirectory); 
   mCaseSensitive = caseSensitive;
@@ -44,7 +98,13 @@ bool Swirl::initialize(const char * srlDataDirectory,
   }
 
   // initialize SRL lexicon
-  Lexicon::initialize(srlDataDirectory, true);
+  if(mLexiconDirectory.empty()){
+    // a lexicon loaded halfway can be neither used nor loaded again
+    mLexiconFailed = true;
+    Lexicon::initialize(srlDataDirectory, true);
+    mLexiconFailed = false;
+    mLexiconDirectory = srlDataDirectory;
+  }
 
   // initialize Charniak's parser
   if(! ParserApi::initialize(parserDataDirectory, ! caseSensitive)){
@@ -55,10 +115,48 @@ bool Swirl::initialize(const char * srlDataDirectory,
   // reset oracle stats, if necessary
   Tree::resetOracleStats();
 
+  mModelVersion = hashDirectory(srlDataDirectory, ResultCache::HASH_SEED);
+  mModelVersion = hashDirectory(parserDataDirectory, mModelVersion);
+  mModelVersion = ResultCache::hash(caseSensitive ? "cs" : "ci", 
+				    mModelVersion);
+
+  // only now, such that a failed initialization can be retried
+  mModelsLoaded = true;
   mIsInitialized = true;
   return true;
 }
 
+srl::TreePtr SwirlEngine::parseSyntax(const char * words, 
+				      int wordCount,
+				      srl::LatencyBudget * budget)
+{
+  MutexLock lock(mParserMutex);
+
+  // the wait for the parser counts against the budget too
+  double effort = 1.0;
+  double deadline = 0;
+  if(budget != NULL){
+    effort = budget->startParsing(wordCount);
+    deadline = budget->getDeadline();
+  }
+  TreePtr tree;
+  {
+    StatTimer timer(STAT_PARSE);
+    tree = ParserApi::parse(words, effort, deadline);
+  }
+  if(budget != NULL) budget->endParsing();
+  return tree;
+}
+
+bool Swirl::initialize(const char * srlDataDirectory,
+		       const char * parserDataDirectory,
+		       bool caseSensitive)
+{
+  return mEngine.initialize(srlDataDirectory, 
+			    parserDataDirectory, 
+			    caseSensitive);
+}
+
 /**
  * Propagates the NE labels from SwirlTokens to Tree terminals
  */
@@ -102,11 +200,11 @@ static void setPredicateFlags(TreePtr tree,
 }
 
 static bool includesChildWithLabel(TreePtr tree,
-				   const string & label)
+				   short labelId)
 {
   for(list<TreePtr>::const_iterator it = tree->getChildren().begin();
       it != tree->getChildren().end(); it ++){
-    if((* it)->getLabel() == label) return true;
+    if((* it)->getLabelId() == labelId) return true;
   }
   return false;
 }
@@ -118,16 +216,16 @@ static void detectPredicatesOnline(TreePtr tree)
 {
   if(tree->isTerminal()){
     // VB* that are head words of VPs, which do not include other VPs
-    if(tree->getLabel().substr(0, 2) == "VB" &&
-       tree->getParent()->getLabel() == "VP" &&
-       includesChildWithLabel(tree, "VP") == false){
+    if(tree->hasLabelCategory(LABEL_IS_VERB) &&
+       tree->getParent()->getLabelId() == LABEL_VP &&
+       includesChildWithLabel(tree, LABEL_VP) == false){
       //cerr << "Found predicate: " << tree << "\n";
       tree->setIsPredicate(true);
     }
 
     // VB* included in an NP, which has a different head
-    else if(tree->getLabel().substr(0, 2) == "VB" &&
-	    tree->getParent()->getLabel() == "NP" &&
+    else if(tree->hasLabelCategory(LABEL_IS_VERB) &&
+	    tree->getParent()->getLabelId() == LABEL_NP &&
 	    tree->getParent()->getHead() != tree){
       tree->setIsPredicate(true);
     }
@@ -164,13 +262,25 @@ static String normalizeSpaces(const String & str)
   return os.str();
 }
 
-srl::TreePtr Swirl::parse(const std::vector<SwirlToken> & sentence,
-			  bool detectPredicates,
-			  OracleSentence * goldFrames)
+srl::TreePtr SwirlContext::parse(const std::vector<SwirlToken> & sentence,
+				 bool detectPredicates,
+				 OracleSentence * goldFrames)
 {
-  std::vector<srl::TreePtr> sentenceTerminals;
+  TreePtr tree = parseSyntax(sentence, detectPredicates);
+  if(tree == (const Tree *) NULL) return tree;
+  return label(tree, sentence, goldFrames);
+}
 
+srl::TreePtr 
+SwirlContext::parseSyntax(const std::vector<SwirlToken> & sentence,
+			  bool detectPredicates,
+			  LatencyBudget * budget)
+{
   try {
+    // the nodes the parser builds for this sentence come from one arena
+    // it is freed in one step, when the caller drops the last node
+    TreeArena::SentenceScope arena;
+
     //
     // construct the parser input as a sequence of words
     //
@@ -183,8 +293,18 @@ srl::TreePtr Swirl::parse(const std::vector<SwirlToken> & sentence,
     //
     // actual parsing
     //
-    TreePtr tree = ParserApi::parse(parserInput.str().c_str());
-    if(tree == (const Tree *) NULL) return tree;
+    PipelineStats::count(STAT_SENTENCES);
+    PipelineStats::record(STAT_SENTENCE_LENGTH, sentence.size());
+
+    TreePtr tree = mEngine.parseSyntax(parserInput.str().c_str(),
+				       (int) sentence.size(), budget);
+    if(tree == (const Tree *) NULL){
+      // the deadline is counted by the budget
+      if(budget == NULL || ! budget->isExpired()){
+	PipelineStats::count(STAT_PARSE_FAILURES);
+      }
+      return tree;
+    }
     //cerr << "After parsing...\n" << tree << "\n";
     
     //
@@ -211,11 +331,35 @@ srl::TreePtr Swirl::parse(const std::vector<SwirlToken> & sentence,
       detectPredicatesOnline(tree);
     }
 
+    return tree;
+  } catch(Exception e){
+    PipelineStats::count(STAT_PARSE_FAILURES);
+    cerr << "SRL system failed with the exception: " << e.getMessage() << "\n";
+    return TreePtr();
+  }
+
+  return TreePtr();
+}
+
+srl::TreePtr SwirlContext::label(srl::TreePtr tree,
+				 const std::vector<SwirlToken> & sentence,
+				 OracleSentence * goldFrames,
+				 LatencyBudget * budget,
+				 const SwirlFilter * filter)
+{
+  std::vector<srl::TreePtr> & sentenceTerminals = mTerminals;
+  sentenceTerminals.clear();
+
+  try {
     //
     // preprocess the tree for SRL
     //
     //cerr << "Starting preprocess...\n";
-    BankTreeProducer::preprocess(tree, sentenceTerminals, mCaseSensitive);
+    {
+      StatTimer timer(STAT_PREPROCESS);
+      BankTreeProducer::preprocess(tree, sentenceTerminals, 
+				   mEngine.isCaseSensitive());
+    }
     RVASSERT(sentenceTerminals.size() == sentence.size(), 
 	     "Invalid sentence terminal count after preprocessing!");
     //cerr << "Parsed sentence:\n" << tree << "\n";
@@ -235,10 +379,42 @@ srl::TreePtr Swirl::parse(const std::vector<SwirlToken> & sentence,
     //
     // classify args for all preds
     //
-    tree->classify(sentenceTerminals, 0, mCaseSensitive);
+    //
+    // unmark the predicates that were not requested
+    // this is done after preprocessing, which treats the lemmas of 
+    //   predicates differently, such that the requested frames do not
+    //   change
+    //
+    const set<String> * allowedLabels = NULL;
+    if(filter != NULL){
+      const set<int> & predicates = filter->getPredicates();
+      if(! predicates.empty()){
+	for(size_t i = 0; i < sentenceTerminals.size(); i ++){
+	  if(predicates.count((int) i) == 0){
+	    sentenceTerminals[i]->setIsPredicate(false);
+	  }
+	}
+      }
+      if(! filter->getLabels().empty()) allowedLabels = & filter->getLabels();
+    }
+
+    int localBeam = LOCAL_COUNT_BEAM;
+    double localConfBeam = LOCAL_CONF_BEAM;
+    int globalBeam = GLOBAL_BEAM;
+    if(budget != NULL){
+      budget->startLabeling(localBeam, localConfBeam, globalBeam);
+    }
+    tree->classify(sentenceTerminals, 0, mEngine.isCaseSensitive(),
+		   localBeam, localConfBeam, globalBeam, allowedLabels, budget);
+    if(budget != NULL) budget->endLabeling();
     //cerr << "Parsed tree completed:\n" << tree << "\n";
+
+    // the terminals must not outlive this call: they may be released 
+    //   by another thread, together with the rest of the tree
+    sentenceTerminals.clear();
     return tree;
   } catch(Exception e){
+    sentenceTerminals.clear();
     cerr << "SRL system failed with the exception: " << e.getMessage() << "\n";
     return TreePtr();
   }
@@ -250,6 +426,7 @@ static bool extractTokens(const char * sentence,
 			  vector<SwirlToken> & srlTokens,
 			  bool & detectPredicates)
 {
+  StatTimer timer(STAT_TOKENIZE);
   vector<string> tokens;
   tokenizeWithQuotes(sentence, tokens, " \t\n\r");
   //cerr << "Parsing sentence: " << sentence << "\n";
@@ -346,9 +523,10 @@ static bool extractTokens(const char * sentence,
   return true;
 }
 
-srl::TreePtr Swirl::parse(const char * sentence)
+srl::TreePtr SwirlContext::parse(const char * sentence)
 {
-  vector<SwirlToken> srlTokens;
+  vector<SwirlToken> & srlTokens = mTokens;
+  srlTokens.clear();
   bool detectPredicates = false;
 
   if(extractTokens(sentence, srlTokens, detectPredicates) == false){
@@ -372,10 +550,105 @@ srl::TreePtr Swirl::parse(const char * sentence)
   return tree;
 }
 
-srl::TreePtr Swirl::oracleParse(const char * sentence,
-				OracleSentence * goldFrames)
+srl::TreePtr SwirlContext::parse(const char * sentence,
+				 LatencyBudget & budget)
 {
-  vector<SwirlToken> srlTokens;
+  vector<SwirlToken> & srlTokens = mTokens;
+  TreePtr tree = parseSyntax(sentence, srlTokens, & budget);
+  if(tree == (const Tree *) NULL) return tree;
+  return label(tree, srlTokens, NULL, & budget);
+}
+
+/**
+ * Text of the normalized sentence, as produced by extractTokens(), with
+ *   the model version and the settings that change the output
+ */
+static string makeCacheKey(const vector<SwirlToken> & sentence,
+			   bool detectPredicates,
+			   const SwirlFilter * filter,
+			   ResultCache::Key modelVersion)
+{
+  ostringstream os;
+  os << modelVersion << " " << detectPredicates << " " 
+     << Tree::getExactInference() << "\n";
+  if(filter != NULL){
+    for(set<int>::const_iterator it = filter->getPredicates().begin();
+	it != filter->getPredicates().end(); it ++){
+      os << * it << " ";
+    }
+    os << "\n";
+    for(set<String>::const_iterator it = filter->getLabels().begin();
+	it != filter->getLabels().end(); it ++){
+      os << * it << " ";
+    }
+    os << "\n";
+  }
+  for(size_t i = 0; i < sentence.size(); i ++){
+    os << sentence[i].getWord() << "\t" << sentence[i].getPos() << "\t"
+       << sentence[i].getNe() << "\t" 
+       << (sentence[i].getPred() ? sentence[i].getLemma() : "-") << "\n";
+  }
+  return os.str();
+}
+
+bool SwirlContext::serialize(const char * sentence,
+			     ResultCache & cache,
+			     std::ostream & os,
+			     LatencyBudget * budget,
+			     const SwirlFilter * filter)
+{
+  vector<SwirlToken> & srlTokens = mTokens;
+  srlTokens.clear();
+  bool detectPredicates = false;
+
+  // fails the same way as the uncached path
+  if(extractTokens(sentence, srlTokens, detectPredicates) == false){
+    Swirl::serialize(TreePtr(), sentence, os);
+    return false;
+  }
+
+  string key = makeCacheKey(srlTokens, detectPredicates, filter, 
+			    mEngine.getModelVersion());
+  string output;
+  if(cache.get(key, output)){
+    os << output;
+    return true;
+  }
+
+  TreePtr tree = parseSyntax(srlTokens, detectPredicates, budget);
+  if(tree != (const Tree *) NULL){
+    tree = label(tree, srlTokens, NULL, budget, filter);
+  }
+
+  ostringstream out;
+  Swirl::serialize(tree, sentence, out);
+  output = out.str();
+
+  // failed or degraded outputs may be better next time
+  if(tree != (const Tree *) NULL &&
+     (budget == NULL || budget->getDegradations().empty())){
+    cache.put(key, output);
+  }
+
+  os << output;
+  return false;
+}
+
+srl::TreePtr SwirlContext::parse(const char * sentence,
+				 const SwirlFilter & filter,
+				 LatencyBudget * budget)
+{
+  vector<SwirlToken> & srlTokens = mTokens;
+  TreePtr tree = parseSyntax(sentence, srlTokens, budget);
+  if(tree == (const Tree *) NULL) return tree;
+  return label(tree, srlTokens, NULL, budget, & filter);
+}
+
+srl::TreePtr SwirlContext::oracleParse(const char * sentence,
+				       OracleSentence * goldFrames)
+{
+  vector<SwirlToken> & srlTokens = mTokens;
+  srlTokens.clear();
   bool detectPredicates = false;
 
   if(extractTokens(sentence, srlTokens, detectPredicates) == false){
@@ -386,6 +659,60 @@ srl::TreePtr Swirl::oracleParse(const char * sentence,
   return tree;
 }
 
+srl::TreePtr SwirlContext::parseSyntax(const char * sentence,
+				       std::vector<SwirlToken> & tokens,
+				       LatencyBudget * budget)
+{
+  tokens.clear();
+  bool detectPredicates = false;
+
+  if(extractTokens(sentence, tokens, detectPredicates) == false){
+    return TreePtr();
+  }
+
+  return parseSyntax(tokens, detectPredicates, budget);
+}
+
+srl::TreePtr Swirl::parse(const std::vector<SwirlToken> & sentence,
+			  bool detectPredicates,
+			  OracleSentence * goldFrames)
+{
+  return mContext.parse(sentence, detectPredicates, goldFrames);
+}
+
+srl::TreePtr Swirl::parse(const char * sentence)
+{
+  return mContext.parse(sentence);
+}
+
+srl::TreePtr Swirl::parse(const char * sentence,
+			  LatencyBudget & budget)
+{
+  return mContext.parse(sentence, budget);
+}
+
+srl::TreePtr Swirl::oracleParse(const char * sentence,
+				OracleSentence * goldFrames)
+{
+  return mContext.oracleParse(sentence, goldFrames);
+}
+
+srl::TreePtr Swirl::parse(const char * sentence,
+			  const SwirlFilter & filter,
+			  LatencyBudget * budget)
+{
+  return mContext.parse(sentence, filter, budget);
+}
+
+bool Swirl::serialize(const char * sentence,
+		      ResultCache & cache,
+		      std::ostream & os,
+		      LatencyBudget * budget,
+		      const SwirlFilter * filter)
+{
+  return mContext.serialize(sentence, cache, os, budget, filter);
+}
+
 static void extractTerminals(TreePtr tree,
 			     vector<TreePtr> & terminals)
 {
@@ -409,10 +736,46 @@ void Swirl::displayProps(const srl::TreePtr & tree,
   tree->dumpCoNLL(os, terminals, showProbabilities);
 }
 
+void Swirl::getArguments(const srl::TreePtr & tree,
+			 std::vector<int> & predicates,
+			 std::vector<srl::ArgumentSpan> & spans)
+{
+  vector<TreePtr> terminals;
+  extractTerminals(tree, terminals);
+  tree->getArgumentSpans(terminals, predicates, spans);
+}
+
+void Swirl::encodeResult(const srl::TreePtr & tree, std::string & out)
+{
+  StatTimer timer(STAT_SERIALIZE);
+  vector<TreePtr> terminals;
+  extractTerminals(tree, terminals);
+  vector<int> predicates;
+  vector<ArgumentSpan> arguments;
+  tree->getArgumentSpans(terminals, predicates, arguments);
+
+  ResultWriter writer;
+  for(size_t i = 0; i < terminals.size(); i ++){
+    writer.addToken(terminals[i]->getWord(), 
+		    terminals[i]->getLemma(),
+		    terminals[i]->getLabel());
+  }
+  for(size_t i = 0; i < predicates.size(); i ++){
+    writer.addPredicate(predicates[i]);
+  }
+  for(size_t i = 0; i < arguments.size(); i ++){
+    writer.addArgument(arguments[i].predicate, arguments[i].label,
+		       arguments[i].start, arguments[i].end, 
+		       arguments[i].prob);
+  }
+  writer.encode(out);
+}
+
 void Swirl::serialize(const srl::TreePtr & tree,
 		      const char * sentence,
 		      std::ostream & os)
 {
+  StatTimer timer(STAT_SERIALIZE);
   if(tree != (const Tree *) NULL){
     vector<TreePtr> terminals;
     extractTerminals(tree, terminals);
@@ -4,10 +4,17 @@
  */
 
 #include <vector>
+#include <string>
+#include <set>
+#include <list>
+#include <map>
 
 #include "Wide.h"
 #include "Tree.h"
 #include "Oracle.h"
+#include "Mutex.h"
+#include "LatencyBudget.h"
+#include "ResultCache.h"
 
 class SwirlToken 
 {
@@ -29,6 +36,336 @@ class SwirlToken
   bool mPred; // only used when parsing Banks, can be left unset otherwise
 };
 
+/**
+ * Restricts the output of one sentence to some of its predicates, and to
+ *   some argument labels. The candidates of the other predicates are 
+ *   never generated, so that work is saved. The classifiers of the other
+ *   labels still run, since their confidences are part of the softmax: 
+ *   the kept labels get the same probabilities as without the filter.
+ * An empty set means no restriction.
+ */
+class SwirlFilter
+{
+ public:
+  SwirlFilter() {}
+
+  /** Labels the predicate at this word position (starting at 0) */
+  void addPredicate(int position) { mPredicates.insert(position); }
+
+  /** Accepts this argument label, e.g. A0, R-A0, or AM-TMP */
+  void addLabel(const String & label) { mLabels.insert(label); }
+
+  const std::set<int> & getPredicates() const { return mPredicates; }
+
+  const std::set<String> & getLabels() const { return mLabels; }
+
+ private:
+  std::set<int> mPredicates;
+  std::set<String> mLabels;
+};
+
+/**
+ * The models shared by all threads of a process: the SRL classifiers,
+ *   the lexicon, the morpher, and the Charniak parser.
+ * They are read-only after initialize(), except for the parser, which keeps
+ *   its charts in globals: parseSyntax() runs one sentence at a time.
+ * Limitation: the engine is a handle on models that are static globals
+ *   (of Tree, Lexicon, and the parser), not an owner of its own models.
+ *   So there can be only one initialized engine per process, and the
+ *   per-sentence state of the parser can not move into SwirlContext
+ *   without rewriting the parser; the per-sentence state of labeling 
+ *   already lives in the trees of each context.
+ */
+class SwirlEngine
+{
+ public:
+  SwirlEngine() 
+    : mCaseSensitive(true), mIsInitialized(false), mModelVersion(0) {}
+
+  /**
+   * Loads all models
+   * A failed call may be retried, e.g. after a wrong SRL model directory:
+   *   the classifiers and the morpher are loaded again, but a lexicon
+   *   loaded by the failed call is kept, so the retry must name the 
+   *   same SRL directory. A call that failed inside the lexicon can not
+   *   be retried. Once a call succeeded, every later call fails.
+   */
+  bool initialize(const char * srlDataDirectory,
+		  const char * parserDataDirectory,
+		  bool caseSensitive);
+
+  bool isInitialized() const { return mIsInitialized; }
+
+  bool isCaseSensitive() const { return mCaseSensitive; }
+
+  /** 
+   * Fingerprint of the models: names, sizes, and modification times of
+   *   the files in the model directories, plus the case setting
+   */
+  srl::ResultCache::Key getModelVersion() const { return mModelVersion; }
+
+  /** 
+   * Syntactic parse of space-separated words; NULL if parsing failed
+   * @param budget If not NULL, sets the parser effort and deadline once
+   *               the parser is free, so the wait for other threads 
+   *               counts against the deadline but not as parse cost
+   */
+  srl::TreePtr parseSyntax(const char * words, 
+			   int wordCount,
+			   srl::LatencyBudget * budget = NULL);
+
+ private:
+  SwirlEngine(const SwirlEngine &);
+  SwirlEngine & operator = (const SwirlEngine &);
+
+  /** If false, do case-insensitive processing */
+  bool mCaseSensitive;
+
+  /** Keeps track if the system was already initialized */
+  bool mIsInitialized;
+
+  srl::ResultCache::Key mModelVersion;
+
+  /** Serializes the calls to the parser */
+  srl::Mutex mParserMutex;
+
+  /** Set when some engine has loaded all the models of this process */
+  static bool mModelsLoaded;
+
+  /** Where the lexicon was loaded from, by a call that failed later */
+  static std::string mLexiconDirectory;
+
+  /** Set if the lexicon threw while loading */
+  static bool mLexiconFailed;
+};
+
+/**
+ * Per-thread entry point to a SwirlEngine
+ * A context must not be used by more than one thread at a time, but any
+ *   number of contexts may share one engine. The trees returned by a 
+ *   context belong to the calling thread.
+ */
+class SwirlContext
+{
+ public:
+  SwirlContext(SwirlEngine & engine) : mEngine(engine) {}
+
+  /** Same as Swirl::parse() */
+  srl::TreePtr parse(const std::vector<SwirlToken> & sentence,
+		     bool detectPredicates,
+		     srl::OracleSentence * goldFrames);
+
+  /** Same as Swirl::parse() */
+  srl::TreePtr parse(const char * sentence);
+
+  /** Same as Swirl::parse(), within the given budget */
+  srl::TreePtr parse(const char * sentence, srl::LatencyBudget & budget);
+
+  /** Same as Swirl::parse(sentence, filter, budget) */
+  srl::TreePtr parse(const char * sentence,
+		     const SwirlFilter & filter,
+		     srl::LatencyBudget * budget = NULL);
+
+  /** Same as Swirl::serialize(sentence, cache, os, budget) */
+  bool serialize(const char * sentence,
+		 srl::ResultCache & cache,
+		 std::ostream & os,
+		 srl::LatencyBudget * budget = NULL,
+		 const SwirlFilter * filter = NULL);
+
+  /** Same as Swirl::oracleParse() */
+  srl::TreePtr oracleParse(const char * sentence,
+			   srl::OracleSentence * goldFrames);
+
+  /**
+   * First half of parse(): tokenizes the sentence, and builds its syntactic
+   *   tree with the NE labels and predicate flags set
+   * @param budget If not NULL, the parser effort is reduced to fit it,
+   *               and the parser stops at its deadline
+   * @return NULL if the sentence could not be tokenized or parsed, or if
+   *         the deadline of the budget passed first
+   */
+  srl::TreePtr parseSyntax(const char * sentence,
+			   std::vector<SwirlToken> & tokens,
+			   srl::LatencyBudget * budget = NULL);
+
+  /** 
+   * Second half of parse(): preprocesses the tree built by parseSyntax()
+   *   and labels the arguments of its predicates
+   * @param budget If not NULL, the SRL beams are reduced to fit it; past
+   *               its deadline, the predicates not labeled yet get no
+   *               arguments (see Tree::classify())
+   * @param filter If not NULL, only these predicates and labels are 
+   *               considered; the other predicates are unmarked
+   * @return NULL if labeling failed
+   */
+  srl::TreePtr label(srl::TreePtr tree,
+		     const std::vector<SwirlToken> & tokens,
+		     srl::OracleSentence * goldFrames,
+		     srl::LatencyBudget * budget = NULL,
+		     const SwirlFilter * filter = NULL);
+
+ private:
+  SwirlContext(const SwirlContext &);
+  SwirlContext & operator = (const SwirlContext &);
+
+  srl::TreePtr parseSyntax(const std::vector<SwirlToken> & sentence,
+			   bool detectPredicates,
+			   srl::LatencyBudget * budget = NULL);
+
+  SwirlEngine & mEngine;
+
+  /** Scratch space, reused across sentences */
+  std::vector<SwirlToken> mTokens;
+  std::vector<srl::TreePtr> mTerminals;
+};
+
+/**
+ * Receives the results of a SwirlPipeline, or of Swirl::parseBatch()
+ */
+class SwirlBatchCallback
+{
+ public:
+  virtual ~SwirlBatchCallback() {}
+
+  /**
+   * Formats the result of one sentence. Called from the formatting
+   *   threads, so it must not modify shared state. By default, displays the args
+   *   in CoNLL format, as Swirl::displayProps()
+   */
+  virtual void format(const srl::TreePtr & tree,
+		      const std::string & sentence,
+		      std::ostream & os);
+
+  /**
+   * The deadline of one sentence, on the LatencyBudget::now() clock; 0
+   *   (the default) for none. A sentence whose deadline has passed when 
+   *   its turn comes is not parsed; one that runs past it is cut short,
+   *   as with a LatencyBudget that does not degrade, and emitted as not
+   *   parsed. Called from the parser thread.
+   */
+  virtual double getDeadline(size_t /* index */) { return 0; }
+
+  /**
+   * Receives the result of one sentence, in submission order, on the 
+   *   emit thread of the pipeline
+   * @param tree NULL if the sentence could not be parsed, or if its 
+   *             deadline passed before it was fully labeled
+   * @param output What format() wrote for this tree
+   */
+  virtual void emit(size_t index,
+		    const srl::TreePtr & tree,
+		    const std::string & output) = 0;
+
+  /**
+   * Called instead of emit() for a sentence whose processing threw, in
+   *   the same order and on the same thread. By default, displays the 
+   *   error and emits the sentence as not parsed.
+   */
+  virtual void fail(size_t index, const std::string & error);
+};
+
+struct SwirlBatchItem;
+
+/**
+ * A long-lived pipeline, fed one sentence at a time, with these stages:
+ *   parse: one thread tokenizes and parses; the parser holds a 
+ *     process-wide lock, so more threads would only wait on it, and 
+ *     tokenizing is too cheap to be worth its own hand-off
+ *   label: labelThreads threads preprocess the trees and classify the
+ *     candidate arguments; the features of a candidate are extracted
+ *     while it is classified, with the beams of the other candidates
+ *     of its predicate, so they are not a stage of their own
+ *   format: formatThreads threads call SwirlBatchCallback::format()
+ *   emit: one thread passes the results to their callbacks, in 
+ *     submission order
+ * The threads are created once, with the pipeline, so a host that feeds
+ *   it small batches does not pay for them, nor drain the pipeline, 
+ *   between batches.
+ * At most queueSize sentences are in the pipeline at any time.
+ */
+class SwirlPipeline
+{
+ public:
+  SwirlPipeline(SwirlEngine & engine,
+		int labelThreads = 1,
+		int formatThreads = 1,
+		int queueSize = 64);
+
+  /** Waits for all the sentences submitted, then stops the threads */
+  ~SwirlPipeline();
+
+  /**
+   * Queues one sentence, waiting while the pipeline is full. Its result
+   *   goes to callback.emit() or callback.fail() with this index; the
+   *   callback must outlive that call.
+   * @param goldFrames If not NULL, runs the sentence in oracle mode
+   */
+  void submit(const std::string & sentence,
+	      SwirlBatchCallback & callback,
+	      size_t index,
+	      srl::OracleSentence * goldFrames = NULL);
+
+  /** Waits until all the sentences submitted so far are emitted */
+  void drain();
+
+ private:
+  SwirlPipeline(const SwirlPipeline &);
+  SwirlPipeline & operator = (const SwirlPipeline &);
+
+  static void * parseWork(void * pipeline);
+  static void * labelWork(void * pipeline);
+  static void * formatWork(void * pipeline);
+  static void * emitWork(void * pipeline);
+
+  void parseWork();
+  void labelWork();
+  void formatWork();
+  void emitWork();
+
+  void startThreads(void * (* work)(void *), int count, const char * stage);
+
+  /** Waits for the sentences in flight, and joins the threads */
+  void stop();
+
+  /**
+   * Waits for the next item of a stage; NULL once the pipeline stops
+   *   and the stage is empty. Called with mMutex locked.
+   */
+  SwirlBatchItem * next(std::list<SwirlBatchItem *> & stage);
+
+  /** Hands an item to the next stage */
+  void pass(SwirlBatchItem * item, std::list<SwirlBatchItem *> & stage);
+
+  SwirlEngine & mEngine;
+  size_t mQueueSize;
+
+  std::vector<pthread_t> mThreads;
+
+  pthread_mutex_t mMutex;
+
+  /** Broadcast every time the state below changes */
+  pthread_cond_t mChanged;
+
+  std::list<SwirlBatchItem *> mSubmitted;
+  std::list<SwirlBatchItem *> mParsed;
+  std::list<SwirlBatchItem *> mLabeled;
+
+  /** Formatted sentences, waiting for the ones before them */
+  std::map<size_t, SwirlBatchItem *> mFormatted;
+
+  /** Sequence numbers, in submission order */
+  size_t mNextSubmit;
+  size_t mNextEmit;
+
+  bool mStopping;
+};
+
+/**
+ * Static interface to one process-wide SwirlEngine
+ * Not thread safe: multi-threaded hosts should create one SwirlContext
+ *   per thread over Swirl::getEngine(), or over their own engine.
+ */
 class Swirl
 {
  public:
@@ -58,6 +395,24 @@ class Swirl
    */
   static srl::TreePtr parse(const char * sentence);
 
+  /**
+   * Same as above, but tries to finish before the given budget runs out:
+   *   as the deadline nears, the parser effort and the SRL beams are
+   *   reduced. The degradations applied are recorded in the budget.
+   */
+  static srl::TreePtr parse(const char * sentence, 
+			    srl::LatencyBudget & budget);
+
+  /**
+   * Same as above, but labels only the predicates and argument labels
+   *   accepted by the filter; the other predicates are not marked in
+   *   the output
+   * @param budget If not NULL, the time limit of this sentence
+   */
+  static srl::TreePtr parse(const char * sentence,
+			    const SwirlFilter & filter,
+			    srl::LatencyBudget * budget = NULL);
+
   /**
    * Reranking oracle system using the given sent of GOLD frames
    * The oracle calculates the distribution of correct candidates and 
@@ -66,6 +421,24 @@ class Swirl
   static srl::TreePtr oracleParse(const char * sentence,
 				  srl::OracleSentence * goldFrames);
 
+  /**
+   * Parses many sentences through a SwirlPipeline of its own (see there
+   *   for the stages), and returns once all of them are emitted. The
+   *   results are emitted in input order, from the emit thread of the
+   *   pipeline. After the first error, nothing more is emitted, and the
+   *   error is thrown once the pipeline has stopped.
+   * At most queueSize sentences are in the pipeline at any time
+   * @param goldFrames If not NULL, runs the first goldFrames->size()
+   *                   sentences in oracle mode
+   */
+  static void parseBatch(const std::vector<std::string> & sentences,
+			 SwirlBatchCallback & callback,
+			 int labelThreads = 1,
+			 int queueSize = 64,
+			 const std::vector<srl::OracleSentence *> * goldFrames 
+			 = NULL,
+			 int formatThreads = 1);
+
   /**
    * Displays the args of this tree in CoNLL format
    * @param showProbabilities If true displays an extra column for each 
@@ -76,6 +449,22 @@ class Swirl
 			   std::ostream & os,
 			   bool showProbabilities);
 
+  /**
+   * The predicates of this tree and their predicted arguments, ordered by
+   *   predicate and start (see Tree::getArgumentSpans()), without
+   *   formatting any output
+   */
+  static void getArguments(const srl::TreePtr & tree,
+			   std::vector<int> & predicates,
+			   std::vector<srl::ArgumentSpan> & spans);
+
+  /**
+   * Appends the compact binary record of this tree to out (see 
+   *   ResultRecord.h): its tokens, with their lemmas and POS tags, and
+   *   its predicates and arguments, as getArguments() finds them
+   */
+  static void encodeResult(const srl::TreePtr & tree, std::string & out);
+
   /**
    * Displays the tree in extended CoNLL format
    */
@@ -83,10 +472,29 @@ class Swirl
 			const char * sentence, 
 			std::ostream & os);
 
+  /**
+   * Parses the sentence and displays it in extended CoNLL format, as
+   *   above, but repeats of a sentence are served from the cache
+   * The cache key holds the tokens, NEs, and predicates of the sentence,
+   *   and the model version; the exact-inference setting is part of the
+   *   key as well.
+   * @param budget If not NULL, the time limit of this sentence. Outputs
+   *               degraded to fit the budget are not cached.
+   * @param filter If not NULL, restricts the output as parse() does; the
+   *               filter is part of the cache key
+   * @return true if the output came from the cache
+   */
+  static bool serialize(const char * sentence,
+			srl::ResultCache & cache,
+			std::ostream & os,
+			srl::LatencyBudget * budget = NULL,
+			const SwirlFilter * filter = NULL);
+
+  /** The engine used by the static methods above */
+  static SwirlEngine & getEngine() { return mEngine; }
+
  private:
-  /** If false, do case-insensitive processing */
-  static bool mCaseSensitive;
+  static SwirlEngine mEngine;
 
-  /** Keeps track if the system was already initialized */
-  static bool mIsInitialized;
+  static SwirlContext mContext;
 };
@@ -0,0 +1,413 @@
+/**
+ * Pipelined batch interface to the SRL classifier
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <list>
+#include <map>
+#include <pthread.h>
+
+#include "Swirl.h"
+#include "AssertLocal.h"
+#include "Exception.h"
+#include "Logger.h"
+#include "PipelineStats.h"
+
+using namespace std;
+using namespace srl;
+
+void SwirlBatchCallback::format(const srl::TreePtr & tree,
+				const std::string & /* sentence */,
+				std::ostream & os)
+{
+  Swirl::displayProps(tree, os, false);
+}
+
+void SwirlBatchCallback::fail(size_t index, const std::string & error)
+{
+  CERR << "Sentence #" << index << " failed: " << error << endl;
+  emit(index, TreePtr(), "");
+}
+
+/** One sentence, as it moves through the pipeline */
+struct SwirlBatchItem {
+  SwirlBatchItem() : budget(NULL) {}
+  ~SwirlBatchItem() { delete budget; }
+
+  /** Position in the submission order */
+  size_t sequence;
+
+  string sentence;
+  SwirlBatchCallback * callback;
+  size_t index;
+  OracleSentence * goldFrames;
+
+  vector<SwirlToken> tokens;
+  TreePtr tree;
+  string output;
+
+  /** NULL if the sentence has no deadline */
+  LatencyBudget * budget;
+
+  /** Set by the stage that threw; the tree is then dropped */
+  string error;
+};
+
+//
+// All items are handed from one stage to the next under mMutex, so the
+//   (non-atomic) reference counts of their trees are never modified by
+//   two threads at the same time.
+//
+
+SwirlPipeline::SwirlPipeline(SwirlEngine & engine,
+			     int labelThreads,
+			     int formatThreads,
+			     int queueSize)
+  : mEngine(engine), mQueueSize(queueSize),
+    mNextSubmit(0), mNextEmit(0), mStopping(false)
+{
+  RVASSERT(engine.isInitialized(), "SRL system not initialized!");
+  RVASSERT(labelThreads > 0,
+	   "Invalid number of labeling threads: " << labelThreads);
+  RVASSERT(formatThreads > 0,
+	   "Invalid number of formatting threads: " << formatThreads);
+  RVASSERT(queueSize > 0, "Invalid queue size: " << queueSize);
+
+  pthread_mutex_init(& mMutex, NULL);
+  pthread_cond_init(& mChanged, NULL);
+
+  try{
+    startThreads(parseWork, 1, "parser");
+    startThreads(labelWork, labelThreads, "labeling");
+    startThreads(formatWork, formatThreads, "formatting");
+    startThreads(emitWork, 1, "emit");
+  } catch(...){
+    stop();
+    pthread_cond_destroy(& mChanged);
+    pthread_mutex_destroy(& mMutex);
+    throw;
+  }
+}
+
+SwirlPipeline::~SwirlPipeline()
+{
+  stop();
+  pthread_cond_destroy(& mChanged);
+  pthread_mutex_destroy(& mMutex);
+}
+
+void SwirlPipeline::startThreads(void * (* work)(void *),
+				 int count,
+				 const char * stage)
+{
+  for(int i = 0; i < count; i ++){
+    pthread_t t;
+    int error = pthread_create(& t, NULL, work, this);
+    RVASSERT(error == 0, "Failed to create " << stage << " thread: " << error);
+    mThreads.push_back(t);
+  }
+}
+
+void SwirlPipeline::stop()
+{
+  // the workers leave as soon as their stage is empty, so the stages 
+  //   must all be empty first
+  pthread_mutex_lock(& mMutex);
+  while(mNextEmit < mNextSubmit) pthread_cond_wait(& mChanged, & mMutex);
+  mStopping = true;
+  pthread_cond_broadcast(& mChanged);
+  pthread_mutex_unlock(& mMutex);
+
+  for(size_t i = 0; i < mThreads.size(); i ++){
+    pthread_join(mThreads[i], NULL);
+  }
+  mThreads.clear();
+}
+
+void SwirlPipeline::submit(const std::string & sentence,
+			   SwirlBatchCallback & callback,
+			   size_t index,
+			   srl::OracleSentence * goldFrames)
+{
+  SwirlBatchItem * item = new SwirlBatchItem;
+  item->sentence = sentence;
+  item->callback = & callback;
+  item->index = index;
+  item->goldFrames = goldFrames;
+
+  pthread_mutex_lock(& mMutex);
+  while(mNextSubmit - mNextEmit >= mQueueSize){
+    pthread_cond_wait(& mChanged, & mMutex);
+  }
+  item->sequence = mNextSubmit ++;
+  pass(item, mSubmitted);
+  pthread_mutex_unlock(& mMutex);
+}
+
+void SwirlPipeline::drain()
+{
+  pthread_mutex_lock(& mMutex);
+  while(mNextEmit < mNextSubmit) pthread_cond_wait(& mChanged, & mMutex);
+  pthread_mutex_unlock(& mMutex);
+}
+
+SwirlBatchItem * SwirlPipeline::next(std::list<SwirlBatchItem *> & stage)
+{
+  while(! mStopping && stage.empty()){
+    pthread_cond_wait(& mChanged, & mMutex);
+  }
+  if(stage.empty()) return NULL;
+
+  SwirlBatchItem * item = stage.front();
+  stage.pop_front();
+  return item;
+}
+
+void SwirlPipeline::pass(SwirlBatchItem * item,
+			 std::list<SwirlBatchItem *> & stage)
+{
+  stage.push_back(item);
+  pthread_cond_broadcast(& mChanged);
+}
+
+void * SwirlPipeline::parseWork(void * pipeline)
+{
+  ((SwirlPipeline *) pipeline)->parseWork();
+  return NULL;
+}
+
+void * SwirlPipeline::labelWork(void * pipeline)
+{
+  ((SwirlPipeline *) pipeline)->labelWork();
+  return NULL;
+}
+
+void * SwirlPipeline::formatWork(void * pipeline)
+{
+  ((SwirlPipeline *) pipeline)->formatWork();
+  return NULL;
+}
+
+void * SwirlPipeline::emitWork(void * pipeline)
+{
+  ((SwirlPipeline *) pipeline)->emitWork();
+  return NULL;
+}
+
+void SwirlPipeline::parseWork()
+{
+  SwirlContext context(mEngine);
+
+  pthread_mutex_lock(& mMutex);
+  SwirlBatchItem * item;
+  while((item = next(mSubmitted)) != NULL){
+    pthread_mutex_unlock(& mMutex);
+
+    try{
+      // nobody waits for the sentences past their deadline anymore
+      double deadline = item->callback->getDeadline(item->index);
+      double start = LatencyBudget::now();
+      if(deadline > 0 && deadline <= start){
+	PipelineStats::count(STAT_DEADLINE_EXPIRED);
+      } else {
+	if(deadline > 0) item->budget = new LatencyBudget(deadline - start,
+							  start, false);
+	item->tree = context.parseSyntax(item->sentence.c_str(),
+					 item->tokens, item->budget);
+      }
+    } catch(Exception e){
+      item->error = e.getMessage();
+    } catch(exception & e){
+      item->error = e.what();
+    } catch(...){
+      item->error = "Exception caught in parser thread!";
+    }
+
+    pthread_mutex_lock(& mMutex);
+    pass(item, mParsed);
+  }
+  pthread_mutex_unlock(& mMutex);
+}
+
+void SwirlPipeline::labelWork()
+{
+  SwirlContext context(mEngine);
+
+  pthread_mutex_lock(& mMutex);
+  SwirlBatchItem * item;
+  while((item = next(mParsed)) != NULL){
+    pthread_mutex_unlock(& mMutex);
+
+    try{
+      if(item->tree != (const Tree *) NULL){
+	item->tree = context.label(item->tree, item->tokens,
+				   item->goldFrames, item->budget);
+      }
+      // a sentence cut short at its deadline has no usable frame
+      if(item->budget != NULL && item->budget->isCutShort()){
+	item->tree = TreePtr();
+      }
+    } catch(Exception e){
+      item->error = e.getMessage();
+    } catch(exception & e){
+      item->error = e.what();
+    } catch(...){
+      item->error = "Exception caught in labeling thread!";
+    }
+    if(! item->error.empty()) item->tree = TreePtr();
+
+    pthread_mutex_lock(& mMutex);
+    pass(item, mLabeled);
+  }
+  pthread_mutex_unlock(& mMutex);
+}
+
+void SwirlPipeline::formatWork()
+{
+  pthread_mutex_lock(& mMutex);
+  SwirlBatchItem * item;
+  while((item = next(mLabeled)) != NULL){
+    pthread_mutex_unlock(& mMutex);
+
+    try{
+      if(item->tree != (const Tree *) NULL){
+	ostringstream os;
+	item->callback->format(item->tree, item->sentence, os);
+	item->output = os.str();
+      }
+    } catch(Exception e){
+      item->error = e.getMessage();
+    } catch(exception & e){
+      item->error = e.what();
+    } catch(...){
+      item->error = "Exception caught in formatting thread!";
+    }
+
+    pthread_mutex_lock(& mMutex);
+    mFormatted[item->sequence] = item;
+    pthread_cond_broadcast(& mChanged);
+  }
+  pthread_mutex_unlock(& mMutex);
+}
+
+void SwirlPipeline::emitWork()
+{
+  pthread_mutex_lock(& mMutex);
+  while(true){
+    map<size_t, SwirlBatchItem *>::iterator it = mFormatted.find(mNextEmit);
+    if(it == mFormatted.end()){
+      if(mStopping) break;
+      pthread_cond_wait(& mChanged, & mMutex);
+      continue;
+    }
+
+    SwirlBatchItem * item = it->second;
+    mFormatted.erase(it);
+    pthread_mutex_unlock(& mMutex);
+
+    try{
+      if(item->error.empty()){
+	item->callback->emit(item->index, item->tree, item->output);
+      } else {
+	item->callback->fail(item->index, item->error);
+      }
+    } catch(Exception e){
+      CERR << "Failed to emit sentence #" << item->index << ": "
+	   << e.getMessage() << endl;
+    } catch(exception & e){
+      CERR << "Failed to emit sentence #" << item->index << ": "
+	   << e.what() << endl;
+    } catch(...){
+      CERR << "Failed to emit sentence #" << item->index << endl;
+    }
+    delete item;
+
+    pthread_mutex_lock(& mMutex);
+    // there is room for one more sentence in the pipeline
+    mNextEmit ++;
+    pthread_cond_broadcast(& mChanged);
+  }
+  pthread_mutex_unlock(& mMutex);
+}
+
+/**
+ * Passes the results of Swirl::parseBatch() on, until the first error,
+ *   which parseBatch() throws
+ */
+class BatchCallback : public SwirlBatchCallback
+{
+ public:
+  BatchCallback(SwirlBatchCallback & callback) : mCallback(callback) {}
+
+  void format(const srl::TreePtr & tree,
+	      const std::string & sentence,
+	      std::ostream & os) {
+    mCallback.format(tree, sentence, os);
+  }
+
+  double getDeadline(size_t index) {
+    return mCallback.getDeadline(index);
+  }
+
+  void emit(size_t index,
+	    const srl::TreePtr & tree,
+	    const std::string & output) {
+    if(failed()) return;
+    try{
+      mCallback.emit(index, tree, output);
+    } catch(Exception e){
+      fail(index, e.getMessage());
+    } catch(exception & e){
+      fail(index, e.what());
+    } catch(...){
+      fail(index, "Exception caught while emitting a result!");
+    }
+  }
+
+  void fail(size_t /* index */, const std::string & error) {
+    MutexLock lock(mMutex);
+    if(mError.empty()) mError = error;
+  }
+
+  bool failed() {
+    MutexLock lock(mMutex);
+    return ! mError.empty();
+  }
+
+  string getError() {
+    MutexLock lock(mMutex);
+    return mError;
+  }
+
+ private:
+  SwirlBatchCallback & mCallback;
+
+  /** mError is set on the emit thread, and read by the caller */
+  Mutex mMutex;
+
+  string mError;
+};
+
+void Swirl::parseBatch(const std::vector<std::string> & sentences,
+		       SwirlBatchCallback & callback,
+		       int labelThreads,
+		       int queueSize,
+		       const std::vector<srl::OracleSentence *> * goldFrames,
+		       int formatThreads)
+{
+  BatchCallback batch(callback);
+  {
+    SwirlPipeline pipeline(mEngine, labelThreads, formatThreads, queueSize);
+    for(size_t i = 0; i < sentences.size() && ! batch.failed(); i ++){
+      OracleSentence * gold = NULL;
+      if(goldFrames != NULL && i < goldFrames->size()){
+	gold = (* goldFrames)[i];
+      }
+      pipeline.submit(sentences[i], batch, i, gold);
+    }
+    // the pipeline waits for its last sentences here
+  }
+  if(batch.failed()) throw runtime_error(batch.getError());
+}
@@ -0,0 +1,216 @@
+
+#include <cstring>
+#include <exception>
+
+#include "SwirlCApi.h"
+#include "Swirl.h"
+#include "Exception.h"
+
+using namespace std;
+using namespace srl;
+
+struct swirl_engine {
+  SwirlEngine engine;
+};
+
+struct swirl_context {
+  swirl_context(SwirlEngine & engine) : context(engine) {}
+
+  SwirlContext context;
+
+  //
+  // scratch space, reused across sentences
+  //
+  vector<SwirlToken> tokens;
+  vector<int> predicates;
+  vector<ArgumentSpan> arguments;
+
+  string error;
+};
+
+int swirl_api_version(void)
+{
+  return SWIRL_API_VERSION;
+}
+
+swirl_engine * swirl_engine_create(const char * srl_model_directory,
+				   const char * parser_model_directory,
+				   int case_sensitive)
+{
+  if(srl_model_directory == NULL || parser_model_directory == NULL){
+    return NULL;
+  }
+
+  swirl_engine * engine = NULL;
+  try{
+    engine = new swirl_engine;
+    if(engine->engine.initialize(srl_model_directory,
+				 parser_model_directory,
+				 case_sensitive != 0)){
+      return engine;
+    }
+  } catch(...){
+    // no exception crosses the C interface
+  }
+  delete engine;
+  return NULL;
+}
+
+void swirl_engine_destroy(swirl_engine * engine)
+{
+  delete engine;
+}
+
+swirl_context * swirl_context_create(swirl_engine * engine)
+{
+  if(engine == NULL || ! engine->engine.isInitialized()) return NULL;
+  try{
+    return new swirl_context(engine->engine);
+  } catch(...){
+    return NULL;
+  }
+}
+
+void swirl_context_destroy(swirl_context * context)
+{
+  delete context;
+}
+
+static int fail(swirl_context * context, int code, const string & error)
+{
+  context->error = error;
+  return code;
+}
+
+/**
+ * Copies the predicates and arguments of the tree into the buffers of
+ *   the caller, as many as fit
+ */
+static int fillResult(swirl_context * context,
+		      const TreePtr & tree,
+		      swirl_result * result)
+{
+  context->predicates.clear();
+  context->arguments.clear();
+  Swirl::getArguments(tree, context->predicates, context->arguments);
+
+  result->predicate_count = context->predicates.size();
+  for(size_t i = 0;
+      i < context->predicates.size() && i < result->max_predicates; i ++){
+    result->predicates[i] = context->predicates[i];
+  }
+
+  bool truncated = false;
+  result->argument_count = context->arguments.size();
+  for(size_t i = 0;
+      i < context->arguments.size() && i < result->max_arguments; i ++){
+    const ArgumentSpan & span = context->arguments[i];
+    swirl_argument & arg = result->arguments[i];
+    arg.predicate = span.predicate;
+    arg.start = span.start;
+    arg.end = span.end;
+    arg.prob = (float) span.prob;
+    strncpy(arg.label, span.label.c_str(), SWIRL_LABEL_SIZE - 1);
+    arg.label[SWIRL_LABEL_SIZE - 1] = '\0';
+    if(span.label.size() >= SWIRL_LABEL_SIZE) truncated = true;
+  }
+
+  if(result->predicate_count > result->max_predicates ||
+     result->argument_count > result->max_arguments){
+    return fail(context, SWIRL_BUFFER_TOO_SMALL, "Result buffers too small");
+  }
+  if(truncated){
+    return fail(context, SWIRL_BUFFER_TOO_SMALL, "Argument label too long");
+  }
+  return SWIRL_OK;
+}
+
+/** Are the buffers of the result usable? */
+static bool validResult(const swirl_result * result)
+{
+  return (result != NULL &&
+	  (result->predicates != NULL || result->max_predicates == 0) &&
+	  (result->arguments != NULL || result->max_arguments == 0));
+}
+
+int swirl_parse_tokens(swirl_context * context,
+		       const char * const * words,
+		       const char * const * nes,
+		       const char * const * preds,
+		       size_t token_count,
+		       swirl_result * result)
+{
+  if(context == NULL) return SWIRL_INVALID_ARGUMENT;
+  context->error.clear();
+  if(words == NULL || token_count == 0 || ! validResult(result)){
+    return fail(context, SWIRL_INVALID_ARGUMENT, "Invalid arguments");
+  }
+  result->predicate_count = 0;
+  result->argument_count = 0;
+
+  try{
+    vector<SwirlToken> & tokens = context->tokens;
+    tokens.clear();
+    for(size_t i = 0; i < token_count; i ++){
+      if(words[i] == NULL || words[i][0] == '\0'){
+	return fail(context, SWIRL_INVALID_ARGUMENT, "Empty token");
+      }
+      String ne;
+      if(nes != NULL && nes[i] != NULL && strcmp(nes[i], "O") != 0){
+	ne = nes[i];
+      }
+      bool pred = (preds != NULL && preds[i] != NULL);
+      tokens.push_back(SwirlToken(words[i], (pred ? preds[i] : ""), "",
+				  ne, pred));
+    }
+
+    bool detectPredicates = (preds == NULL);
+    TreePtr tree = context->context.parse(tokens, detectPredicates, NULL);
+    if(tree == (const Tree *) NULL){
+      return fail(context, SWIRL_PARSE_FAILED, "Failed to parse sentence");
+    }
+    return fillResult(context, tree, result);
+  } catch(Exception e){
+    return fail(context, SWIRL_FAILED, e.getMessage());
+  } catch(exception & e){
+    return fail(context, SWIRL_FAILED, e.what());
+  } catch(...){
+    return fail(context, SWIRL_FAILED, "Unknown error");
+  }
+}
+
+int swirl_parse_sentence(swirl_context * context,
+			 const char * sentence,
+			 swirl_result * result)
+{
+  if(context == NULL) return SWIRL_INVALID_ARGUMENT;
+  context->error.clear();
+  if(sentence == NULL || ! validResult(result)){
+    return fail(context, SWIRL_INVALID_ARGUMENT, "Invalid arguments");
+  }
+  result->predicate_count = 0;
+  result->argument_count = 0;
+  if(strspn(sentence, " \t\r\n") == strlen(sentence)){
+    return fail(context, SWIRL_INVALID_ARGUMENT, "Empty sentence");
+  }
+
+  try{
+    TreePtr tree = context->context.parse(sentence);
+    if(tree == (const Tree *) NULL){
+      return fail(context, SWIRL_PARSE_FAILED, "Failed to parse sentence");
+    }
+    return fillResult(context, tree, result);
+  } catch(Exception e){
+    return fail(context, SWIRL_FAILED, e.getMessage());
+  } catch(exception & e){
+    return fail(context, SWIRL_FAILED, e.what());
+  } catch(...){
+    return fail(context, SWIRL_FAILED, "Unknown error");
+  }
+}
+
+const char * swirl_error_message(const swirl_context * context)
+{
+  if(context == NULL) return "Invalid context";
+  return context->error.c_str();
+}
@@ -0,0 +1,136 @@
+
+#ifndef SRL_SWIRL_C_API_H
+#define SRL_SWIRL_C_API_H
+
+/**
+ * C interface to the SRL system, exported by libswirl.so (not built by 
+ *   default: see src/bin/Makefile.am, WordNet must be compiled with -fPIC)
+ * An engine holds the models; a context labels one sentence at a time,
+ *   so each thread of the host uses its own context over a shared engine.
+ * The results are written into buffers owned by the caller: no call
+ *   allocates memory that the caller must free, and the only strings
+ *   returned (error messages) belong to their context.
+ * This interface only grows: existing functions and structures keep
+ *   their meaning across versions (see SWIRL_API_VERSION).
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWIRL_API_VERSION 1
+
+/** Return codes of swirl_parse_tokens() and swirl_parse_sentence() */
+#define SWIRL_OK 0
+/** The sentence could not be parsed */
+#define SWIRL_PARSE_FAILED 1
+/**
+ * The result buffers are too small, and the counts hold the sizes needed;
+ *   or a label is longer than SWIRL_LABEL_SIZE - 1, and was truncated
+ */
+#define SWIRL_BUFFER_TOO_SMALL 2
+/** A NULL handle or buffer, or an empty sentence */
+#define SWIRL_INVALID_ARGUMENT 3
+/** Any other error; see swirl_error_message() */
+#define SWIRL_FAILED 4
+
+/** 
+ * Longest argument label, including its terminating NUL. The PropBank
+ *   labels of the shipped models, e.g. "C-AM-TMP", all fit.
+ */
+#define SWIRL_LABEL_SIZE 16
+
+typedef struct swirl_engine swirl_engine;
+
+typedef struct swirl_context swirl_context;
+
+/** One argument of a predicate, as a span of tokens */
+typedef struct swirl_argument {
+  /** Token position of the predicate, starting at 0 */
+  int predicate;
+  /** First and last token of the argument, inclusive */
+  int start;
+  int end;
+  /** Probability of the argument */
+  float prob;
+  /** NUL-terminated label, e.g. "A0" or "AM-TMP" */
+  char label[SWIRL_LABEL_SIZE];
+} swirl_argument;
+
+/**
+ * The result of one sentence. The caller sets the buffers and their
+ *   sizes; the parse functions set the counts.
+ */
+typedef struct swirl_result {
+  /** Token positions of the predicates, including those without args */
+  int * predicates;
+  size_t max_predicates;
+  size_t predicate_count;
+
+  /** The arguments, ordered by predicate and start */
+  swirl_argument * arguments;
+  size_t max_arguments;
+  size_t argument_count;
+} swirl_result;
+
+/** The SWIRL_API_VERSION the library was built with */
+int swirl_api_version(void);
+
+/**
+ * Loads the SRL and parser models
+ * The models are globals of the process: only one engine can be
+ *   created per process, and its models stay loaded until the process
+ *   exits, even after swirl_engine_destroy(). A call that failed on a
+ *   wrong SRL model directory may be retried; see SwirlEngine::initialize()
+ *   for the failures that can not be.
+ * @return NULL if the models could not be loaded
+ */
+swirl_engine * swirl_engine_create(const char * srl_model_directory,
+				   const char * parser_model_directory,
+				   int case_sensitive);
+
+/** All contexts of the engine must be destroyed first */
+void swirl_engine_destroy(swirl_engine * engine);
+
+/** A context must not be used by more than one thread at a time */
+swirl_context * swirl_context_create(swirl_engine * engine);
+
+void swirl_context_destroy(swirl_context * context);
+
+/**
+ * Parses and labels one tokenized sentence
+ * There is no POS tag argument: the parser always tags the words itself.
+ * @param words The tokens of the sentence
+ * @param nes The named-entity label of each token ("O" or NULL for
+ *            none), or NULL if there are no NE labels
+ * @param preds The lemma of each predicate, NULL for the other tokens;
+ *              if preds itself is NULL, the predicates are detected
+ * @return SWIRL_OK, or one of the error codes above. With
+ *         SWIRL_BUFFER_TOO_SMALL, the buffers hold the first entries,
+ *         and the labels too long to fit are truncated.
+ */
+int swirl_parse_tokens(swirl_context * context,
+		       const char * const * words,
+		       const char * const * nes,
+		       const char * const * preds,
+		       size_t token_count,
+		       swirl_result * result);
+
+/**
+ * Same as swirl_parse_tokens(), for a sentence in one of the text
+ *   formats of the swirl_parse_classify shell, e.g. "3 The cat sat ."
+ */
+int swirl_parse_sentence(swirl_context * context,
+			 const char * sentence,
+			 swirl_result * result);
+
+/** The error of the last failed call on this context; "" if none */
+const char * swirl_error_message(const swirl_context * context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+
+#include <iostream>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+ThreadPool::ThreadPool(int threadCount)
+  : _stopping(false)
+{
+  RVASSERT(threadCount > 0, "Invalid number of threads: " << threadCount);
+
+  pthread_mutex_init(& _mutex, NULL);
+  pthread_cond_init(& _ready, NULL);
+
+  for(int i = 0; i < threadCount; i ++){
+    pthread_t t;
+    int error = pthread_create(& t, NULL, work, this);
+    RVASSERT(error == 0, "Failed to create worker thread: " << error);
+    _threads.push_back(t);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  pthread_mutex_lock(& _mutex);
+  _stopping = true;
+  pthread_cond_broadcast(& _ready);
+  pthread_mutex_unlock(& _mutex);
+
+  for(size_t i = 0; i < _threads.size(); i ++){
+    pthread_join(_threads[i], NULL);
+  }
+
+  pthread_cond_destroy(& _ready);
+  pthread_mutex_destroy(& _mutex);
+}
+
+void ThreadPool::run(const std::vector<ThreadTask *> & tasks)
+{
+  if(tasks.empty()) return;
+
+  Batch batch;
+  batch.pending = (int) tasks.size();
+  pthread_cond_init(& batch.done, NULL);
+
+  pthread_mutex_lock(& _mutex);
+  for(size_t i = 0; i < tasks.size(); i ++){
+    QueuedTask qt;
+    qt.task = tasks[i];
+    qt.batch = & batch;
+    _queue.push_back(qt);
+  }
+  pthread_cond_broadcast(& _ready);
+
+  while(batch.pending > 0){
+    pthread_cond_wait(& batch.done, & _mutex);
+  }
+  pthread_mutex_unlock(& _mutex);
+
+  pthread_cond_destroy(& batch.done);
+
+  if(! batch.error.empty()) throw runtime_error(batch.error);
+}
+
+void * ThreadPool::work(void * pool)
+{
+  ((ThreadPool *) pool)->work();
+  return NULL;
+}
+
+void ThreadPool::work()
+{
+  pthread_mutex_lock(& _mutex);
+
+  while(true){
+    while(_queue.empty() && ! _stopping){
+      pthread_cond_wait(& _ready, & _mutex);
+    }
+    if(_queue.empty()) break;
+
+    QueuedTask qt = _queue.front();
+    _queue.pop_front();
+    pthread_mutex_unlock(& _mutex);
+
+    string error;
+    try{
+      qt.task->run();
+    } catch(exception & e){
+      error = e.what();
+      if(error.empty()) error = "Exception caught in worker thread!";
+    } catch(...){
+      error = "Exception caught in worker thread!";
+    }
+
+    pthread_mutex_lock(& _mutex);
+    // keep the first error of the batch
+    if(! error.empty() && qt.batch->error.empty()) qt.batch->error = error;
+    if(-- qt.batch->pending == 0) pthread_cond_signal(& qt.batch->done);
+  }
+
+  pthread_mutex_unlock(& _mutex);
+}
@@ -0,0 +1,71 @@
+
+#ifndef SRL_THREAD_POOL_H
+#define SRL_THREAD_POOL_H
+
+#include <vector>
+#include <list>
+#include <string>
+#include <pthread.h>
+
+namespace srl {
+
+  /** One unit of work executed by a ThreadPool */
+  class ThreadTask {
+  public:
+    virtual void run() = 0;
+    virtual ~ThreadTask() {}
+  };
+
+  /**
+   * Fixed set of worker threads.
+   * run() blocks until all the given tasks are done. Several threads may
+   *   call run() at the same time; their tasks share the same workers.
+   * An exception thrown by a task is reported by run() as a
+   *   std::runtime_error, after all the other tasks of the call are done.
+   */
+  class ThreadPool {
+
+  public:
+    ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    /** Executes all tasks, and returns when they are done */
+    void run(const std::vector<ThreadTask *> & tasks);
+
+    int size() const { return (int) _threads.size(); }
+
+  private:
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator = (const ThreadPool &);
+
+    /** The tasks submitted by one call to run() */
+    struct Batch {
+      int pending;
+      std::string error;
+      pthread_cond_t done;
+    };
+
+    struct QueuedTask {
+      ThreadTask * task;
+      Batch * batch;
+    };
+
+    static void * work(void * pool);
+
+    void work();
+
+    std::vector<pthread_t> _threads;
+
+    std::list<QueuedTask> _queue;
+
+    pthread_mutex_t _mutex;
+
+    /** Signaled when tasks are queued, or when the pool shuts down */
+    pthread_cond_t _ready;
+
+    bool _stopping;
+  };
+
+} // end namespace srl
+
+#endif
@@ -497,31 +497,35 @@ void Tree::setHead()
   }
 
   if(_children.empty() == false){
-    setHead(findHead<Tree>(getLabel(), getChildren()));
-
-    // find the direct iterator
-    _headIterator = _children.end();
-    for(_headIterator = _children.begin();
-	_headIterator != _children.end();
-	_headIterator ++){
-      if((* _headIterator).operator->() == _head.operator->()){
-	break;
-      }
-    }
-    LVASSERT(_headIterator != _children.end(), "missing head iterator");
-
-    // find the reverse iterator
-    _headReverseIterator = _children.rend();
-    for(_headReverseIterator = _children.rbegin();
-	_headReverseIterator != _children.rend();
-	_headReverseIterator ++){
-      if((* _headReverseIterator).operator->() == _head.operator->()){
-	break;
-      }
+    detectHead();
+  }
+}
+
+void Tree::detectHead()
+{
+  setHead(findHead<Tree>(getLabel(), getChildren()));
+
+  // find the direct iterator
+  _headIterator = _children.end();
+  for(_headIterator = _children.begin();
+      _headIterator != _children.end();
+      _headIterator ++){
+    if((* _headIterator).operator->() == _head.operator->()){
+      break;
     }
-    LVASSERT(_headReverseIterator != _children.rend(), "missing head iterator");
+  }
+  LVASSERT(_headIterator != _children.end(), "missing head iterator");
 
+  // find the reverse iterator
+  _headReverseIterator = _children.rend();
+  for(_headReverseIterator = _children.rbegin();
+      _headReverseIterator != _children.rend();
+      _headReverseIterator ++){
+    if((* _headReverseIterator).operator->() == _head.operator->()){
+      break;
+    }
   }
+  LVASSERT(_headReverseIterator != _children.rend(), "missing head iterator");
 }
 
 void Tree::detectContentWords()
@@ -570,15 +574,15 @@ const RCIPtr<srl::Tree> & Tree::getFirstChild() const
 void Tree::detectContentWord()
 {    
   // H1
-  if(getLabel().substr(0, 2) == "PP"){
+  if(hasLabelCategory(LABEL_IS_PP)){
     _content = getLastChild();
   } 
 
   // H2
-  else if(getLabel().substr(0, 4) == "SBAR"){
+  else if(getLabel().compare(0, 4, "SBAR") == 0){
     for(list<TreePtr>::const_iterator it = _children.begin(); 
 	it != _children.end(); it ++){
-      if((* it)->getLabel().substr(0, 1) == "S"){
+      if((* it)->hasLabelCategory(LABEL_IS_CLAUSE)){
 	_content = * it;
 	break;
       }
@@ -586,10 +590,10 @@ void Tree::detectContentWord()
   }
 
   // H3 
-  else if(getLabel().substr(0, 2) == "VP"){
+  else if(hasLabelCategory(LABEL_IS_VP)){
     for(list<TreePtr>::const_iterator it = _children.begin(); 
 	it != _children.end(); it ++){
-      if((* it)->getLabel().substr(0, 2) == "VP"){
+      if((* it)->hasLabelCategory(LABEL_IS_VP)){
 	_content = * it;
 	break;
       }
@@ -597,11 +601,11 @@ void Tree::detectContentWord()
   }
   
   // H4
-  else if(getLabel().substr(0, 4) == "ADVP"){
+  else if(getLabel().compare(0, 4, "ADVP") == 0){
     for(list<TreePtr>::reverse_iterator it = _children.rbegin(); 
 	it != _children.rend(); it ++){
-      if((* it)->getLabel().substr(0, 2) != "TO" &&
-	 (* it)->getLabel().substr(0, 2) != "IN"){
+      if((* it)->getLabel().compare(0, 2, "TO") != 0 &&
+	 (* it)->getLabel().compare(0, 2, "IN") != 0){
 	_content = * it;
 	break;
       }
@@ -609,12 +613,13 @@ void Tree::detectContentWord()
   }
 
   // H5
-  else if(getLabel().substr(0, 4) == "ADJP"){
+  else if(getLabel().compare(0, 4, "ADJP") == 0){
     for(list<TreePtr>::reverse_iterator it = _children.rbegin(); 
 	it != _children.rend(); it ++){
-      String pre2 = (* it)->getLabel().substr(0, 2);
-      if(pre2 == "NN" || pre2 == "NP" || pre2 == "VB" || pre2 == "VP" ||
-	 pre2 == "JJ" || (* it)->getLabel().substr(0, 4) == "ADJP"){
+      if((* it)->hasLabelCategory(LABEL_IS_NOUN | LABEL_IS_NP | 
+				   LABEL_IS_VERB | LABEL_IS_VP |
+				   LABEL_IS_ADJ) ||
+	 (* it)->getLabel().compare(0, 4, "ADJP") == 0){
 	_content = * it;
 	break;
       }
@@ -630,9 +635,9 @@ static const Tree * findVerbModifier(short start,
 				     const vector<TreePtr> & sentence)
 {
   for(short i = end - 1; i >= start; i --){
-    String pre = sentence[i]->getLabel().substr(0, 2);
-    if(pre == "VB" || pre == "MD" || pre == "TO" || 
-       sentence[i]->getLabel().substr(0, 3) == "AUX") 
+    if(sentence[i]->hasLabelCategory(LABEL_IS_VERB | LABEL_IS_AUX) ||
+       sentence[i]->getLabel().compare(0, 2, "MD") == 0 ||
+       sentence[i]->getLabel().compare(0, 2, "TO") == 0) 
       return sentence[i].operator->();
   }
   return NULL;
@@ -640,6 +645,17 @@ static const Tree * findVerbModifier(short start,
 
 void Tree::
 detectPredicateVoices(const std::vector< RCIPtr<srl::Tree> > & sentence)
+{
+  detectPredicateVoice(sentence);
+
+  for(list<TreePtr>::const_iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectPredicateVoices(sentence);
+  }
+}
+
+void Tree::
+detectPredicateVoice(const std::vector< RCIPtr<srl::Tree> > & sentence)
 {
   // only care about terminals marked as predicate
   if(isTerminal() && isPredicate()){
@@ -653,11 +669,6 @@ detectPredicateVoices(const std::vector< RCIPtr<srl::Tree> > & sentence)
     //else cerr << "NIL" << endl;
     detectVoice(modifier);
   }
-
-  for(list<TreePtr>::const_iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectPredicateVoices(sentence);
-  }
 }
 
 static bool isBeVerb(const string & v)
@@ -692,17 +703,17 @@ static bool isGetVerb(const string & v)
 
 void Tree::detectVoice(const Tree * modifier)
 {
-  if(getLabel() == "VBG" && modifier == NULL){
+  if(getLabelId() == LABEL_VBG && modifier == NULL){
     _verbType = VERB_GERUND;
     //cerr << "Verb " << getWord() << " is gerund" << endl;
-  } else if(getLabel() == "VB" && 
-	    modifier != NULL && modifier->getLabel() == "TO") {
+  } else if(getLabelId() == LABEL_VB && 
+	    modifier != NULL && modifier->getLabelId() == LABEL_TO) {
     _verbType = VERB_INFINITIVE;
     //cerr << "Verb " << getWord() << " is infinitive" << endl;
   } else if(isBeVerb(getWord())){
     _verbType = VERB_COPULATIVE;
     //cerr << "Verb " << getWord() << " is copulative" << endl;
-  } else if((getLabel() == "VBN" || getLabel() == "VBD") &&
+  } else if((getLabelId() == LABEL_VBN || getLabelId() == LABEL_VBD) &&
 	    modifier != NULL &&
 	    (isBeVerb(modifier->getWord()) || isGetVerb(modifier->getWord()))){
     _verbType = VERB_PASSIVE;
@@ -746,7 +757,7 @@ short Tree::findVerbContext(const std::vector< RCIPtr<srl::Tree> > & sentence) c
   //
   int ctx = getLeftPosition();
   for(; ctx >= good->getLeftPosition() && 
-	sentence[ctx]->getLabel() != "CC"; 
+	sentence[ctx]->getLabelId() != LABEL_CC; 
       ctx --);
   ctx ++;
 
@@ -762,15 +773,15 @@ bool Tree::validPredicateParent(const Tree * child,
   if(sawSentence == true) return false;
 
   // VP* are Ok
-  if(getLabel().substr(0, 2) == "VP") return true;
+  if(hasLabelCategory(LABEL_IS_VP)) return true;
 
   // the first S* is Ok if no left children are VP*, NP* or S*
-  if(getLabel().substr(0, 1) == "S"){
+  if(hasLabelCategory(LABEL_IS_CLAUSE)){
     for(list<TreePtr>::const_iterator it = _children.begin();
 	it != _children.end() && (* it).operator->() != child; it ++){
-      if((* it)->getLabel().substr(0, 2) == "VP" ||
-	 (* it)->getLabel().substr(0, 2) == "NP" ||
-	 (* it)->getLabel().substr(0, 1) == "S"){
+      if((* it)->hasLabelCategory(LABEL_IS_VP) ||
+	 (* it)->hasLabelCategory(LABEL_IS_NP) ||
+	 (* it)->hasLabelCategory(LABEL_IS_CLAUSE)){
 	return false;
       }
     }
@@ -865,11 +876,11 @@ void Tree::constructPath(const Tree * arg,
 
   for(const Tree * crt = arg->_parent; crt != NULL; crt = crt->_parent){
     argParents.push_back(crt);
-    if(crt->getLabel().substr(0, 1) == "S"){
+    if(crt->hasLabelCategory(LABEL_IS_CLAUSE)){
       pf.clauseCount ++;
       pf.upClauseCount ++;
     }
-    else if(crt->getLabel().substr(0, 2) == "VP"){
+    else if(crt->hasLabelCategory(LABEL_IS_VP)){
       pf.vpCount ++;
       pf.upVpCount ++;
     }
@@ -885,10 +896,10 @@ void Tree::constructPath(const Tree * arg,
       break;
     }
     verbParents.push_back(crt);
-    if(crt->getLabel().substr(0, 1) == "S"){
+    if(crt->hasLabelCategory(LABEL_IS_CLAUSE)){
       pf.clauseCount ++;
       pf.downClauseCount ++;
-    } else if(crt->getLabel().substr(0, 2) == "VP"){
+    } else if(crt->hasLabelCategory(LABEL_IS_VP)){
       pf.vpCount ++;
       pf.downVpCount ++;
     }
@@ -954,13 +965,23 @@ void Tree::constructPath(const Tree * arg,
 }
 
 void Tree::detectAuxVerbs()
+{
+  detectAuxChildren();
+
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectAuxVerbs();
+  }
+}
+
+void Tree::detectAuxChildren()
 {
   // Auxiliary verbs are VB*|AUX phrases inside VP* that contain other VP*
-  if(getLabel().substr(0, 2) == "VP"){
+  if(hasLabelCategory(LABEL_IS_VP)){
     bool containsVP = false;
     for(list<TreePtr>::const_iterator it = _children.begin();
 	it != _children.end(); it ++){
-      if((* it)->getLabel().substr(0, 2) == "VP"){
+      if((* it)->hasLabelCategory(LABEL_IS_VP)){
 	containsVP = true;
 	break;
       }
@@ -969,19 +990,14 @@ void Tree::detectAuxVerbs()
       for(list<TreePtr>::iterator it = _children.begin();
 	  it != _children.end(); it ++){
 	if((* it)->isTerminal() && 
-	   ((* it)->getLabel().substr(0, 2) == "VB" ||
-	    (* it)->getLabel().substr(0, 3) == "AUX")){
+	   ((* it)->hasLabelCategory(LABEL_IS_VERB) ||
+	    (* it)->hasLabelCategory(LABEL_IS_AUX))){
 	  //cerr << "Found aux verb at position: " << (* it)->getLeftPosition() << endl;
 	  (* it)->setIsAuxVerb(true);
 	}
       }
     }
   }
-
-  for(list<TreePtr>::iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectAuxVerbs();
-  }
 }
 
 static String 
@@ -1005,6 +1021,17 @@ detectContext(const std::vector< RCIPtr<srl::Tree> > & sentence,
 
 void Tree::
 detectPOSContexts(const std::vector< RCIPtr<srl::Tree> > & sentence)
+{
+  detectPOSContext(sentence);
+
+  for(list<TreePtr>::const_iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectPOSContexts(sentence);
+  }
+}
+
+void Tree::
+detectPOSContext(const std::vector< RCIPtr<srl::Tree> > & sentence)
 {
   // only care about terminals marked as predicate
   if(isTerminal() && isPredicate()){
@@ -1016,23 +1043,13 @@ detectPOSContexts(const std::vector< RCIPtr<srl::Tree> > & sentence)
     _posContexts.push_back(detectContext(sentence, getLeftPosition(), 2, 0));
     //cerr << "Ctx for " << getLeftPosition() << " " << _posContexts.back() << endl;
   }
-
-  for(list<TreePtr>::const_iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectPOSContexts(sentence);
-  }
 }
 
 void Tree::
 detectTemporalTerminals()
 {
   // only care about terminals marked as predicate
-  if(isTerminal()){
-    if(Lexicon::isTmpNN(getWord().c_str())) _temporal = "NN";
-    else if(Lexicon::isTmpNNP(getWord().c_str())) _temporal = "NNP";
-    else if(Lexicon::isTmpIN(getWord().c_str())) _temporal = "IN";
-    else if(Lexicon::isTmpRB(getWord().c_str())) _temporal = "RB";
-  }
+  if(isTerminal()) detectTemporalTerminal();
 
   for(list<TreePtr>::const_iterator it = _children.begin();
       it != _children.end(); it ++){
@@ -1040,19 +1057,17 @@ detectTemporalTerminals()
   }
 }
 
+void Tree::detectTemporalTerminal()
+{
+  if(Lexicon::isTmpNN(getWord().c_str())) _temporal = "NN";
+  else if(Lexicon::isTmpNNP(getWord().c_str())) _temporal = "NNP";
+  else if(Lexicon::isTmpIN(getWord().c_str())) _temporal = "IN";
+  else if(Lexicon::isTmpRB(getWord().c_str())) _temporal = "RB";
+}
+
 void Tree::detectGoverningCategory()
 {
-  if(getLabel().substr(0, 2) == "NP"){
-    for(const Tree * crt = _parent; crt != NULL; crt = crt->_parent){
-      if(crt->getLabel().substr(0, 1) == "S"){
-	_gov = "S";
-	break;
-      } else if(crt->getLabel().substr(0, 2) == "VP"){
-	_gov = "VP";
-	break;
-      }
-    }
-  }
+  if(hasLabelCategory(LABEL_IS_NP)) detectGoverningParent();
 
   for(list<TreePtr>::iterator it = _children.begin();
       it != _children.end(); it ++){
@@ -1060,6 +1075,19 @@ void Tree::detectGoverningCategory()
   }
 }
 
+void Tree::detectGoverningParent()
+{
+  for(const Tree * crt = _parent; crt != NULL; crt = crt->_parent){
+    if(crt->hasLabelCategory(LABEL_IS_CLAUSE)){
+      _gov = "S";
+      break;
+    } else if(crt->hasLabelCategory(LABEL_IS_VP)){
+      _gov = "VP";
+      break;
+    }
+  }
+}
+
 void Tree::countCommas()
 {
   /*
@@ -1091,15 +1119,7 @@ void Tree::countCommas()
 
 void Tree::detectChildrenPath()
 {
-  if(! isTerminal()){
-    ostringstream os;
-    for(list<TreePtr>::iterator it = _children.begin();
-	it != _children.end(); it ++){
-      if(it != _children.begin()) os << "+";
-      os << (* it)->getLabel();
-    }
-    _childrenPath = os.str();
-  }
+  if(! isTerminal()) detectChildrenLabels();
 
   for(list<TreePtr>::iterator it = _children.begin();
       it != _children.end(); it ++){
@@ -1107,7 +1127,28 @@ void Tree::detectChildrenPath()
   }
 }
 
+void Tree::detectChildrenLabels()
+{
+  ostringstream os;
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    if(it != _children.begin()) os << "+";
+    os << (* it)->getLabel();
+  }
+  _childrenPath = os.str();
+}
+
 void Tree::detectSiblingPaths()
+{
+  detectChildrenSiblingPaths();
+
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectSiblingPaths();
+  }
+}
+
+void Tree::detectChildrenSiblingPaths()
 {
   list<String> leftLabels;
   list<String> rightLabels;
@@ -1147,26 +1188,11 @@ void Tree::detectSiblingPaths()
     rightNodes.push_front((* it).operator->());
     rightNodes.pop_back();
   }
-
-  for(list<TreePtr>::iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectSiblingPaths();
-  }
 }
 
 void Tree::detectSuffixes(bool caseSensitive)
 {
-  if(isTerminal()){
-    for(int i = 2; i <= 4; i ++){
-      if((int) _word.size() >= i){
-	String suf = normalizeCase(_word.substr(_word.size() - i, i),
-				   caseSensitive);
-	_suffixes.push_back(suf);
-      } else {
-	_suffixes.push_back("nil");
-      }
-    }
-  }
+  if(isTerminal()) detectWordSuffixes(caseSensitive);
 
   for(list<TreePtr>::iterator it = _children.begin();
       it != _children.end(); it ++){
@@ -1174,6 +1200,19 @@ void Tree::detectSuffixes(bool caseSensitive)
   }
 }
 
+void Tree::detectWordSuffixes(bool caseSensitive)
+{
+  for(int i = 2; i <= 4; i ++){
+    if((int) _word.size() >= i){
+      String suf = normalizeCase(_word.substr(_word.size() - i, i),
+				 caseSensitive);
+      _suffixes.push_back(suf);
+    } else {
+      _suffixes.push_back("nil");
+    }
+  }
+}
+
 const Tree * Tree::findBegin(const String & argName,
 			     int verbPosition,
 			     int argLeftPosition,
@@ -1203,6 +1242,16 @@ const Tree * Tree::findBegin(const String & argName,
 }
 
 void Tree::detectArgumentBegins(const Tree * top)
+{
+  detectArgumentBegin(top);
+
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectArgumentBegins(top);
+  }
+}
+
+void Tree::detectArgumentBegin(const Tree * top)
 {
   for(list<Argument>::iterator it = _arguments.begin();
       it != _arguments.end(); it ++){
@@ -1222,18 +1271,13 @@ void Tree::detectArgumentBegins(const Tree * top)
       */
     }
   }
-
-  for(list<TreePtr>::iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectArgumentBegins(top);
-  }
 }
 
 void Tree::incLabelCount(const Char * lab,
 			 int increment)
 {
-  RCIPtr< StringMapEntry<int> > value = _labelCounts.get(lab);
-  if(value.operator->() == NULL){
+  StringMapEntry<int> * value = _labelCounts.get(lab);
+  if(value == NULL){
     _labelCounts.set(lab, increment);
   } else{
     value->setValue(value->getValue() + increment);
@@ -1241,6 +1285,16 @@ void Tree::incLabelCount(const Char * lab,
 }
 
 void Tree::detectIncludes()
+{
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectIncludes();
+  }
+
+  gatherIncludes();
+}
+
+void Tree::gatherIncludes()
 {
   // PER, ORG, LOC, MISC, TMP_NN, TMP_NNP, TMP_IN, TMP_MISC
   _includes.resize(INCLUDES_SIZE, false);
@@ -1261,11 +1315,6 @@ void Tree::detectIncludes()
     }
   }
 
-  for(list<TreePtr>::iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectIncludes();
-  }
-
   for(list<TreePtr>::const_iterator cit = _children.begin();
       cit != _children.end(); cit ++){
 
@@ -1288,23 +1337,23 @@ void Tree::detectIncludes()
 bool Tree::isReferent() const
 {
   // (WHNP (WP who))
-  if(getLabel() == "WP" &&
+  if(getLabelId() == LABEL_WP &&
      _parent != NULL &&
-     _parent->getLabel() == "WHNP")
+     _parent->getLabelId() == LABEL_WHNP)
     return true;
 
   // (WHNP (WDT which))
-  if(getLabel() == "WDT" &&
+  if(getLabelId() == LABEL_WDT &&
      _parent != NULL &&
-     _parent->getLabel() == "WHNP" &&
+     _parent->getLabelId() == LABEL_WHNP &&
      _parent->_children.size() == 1)
     return true;
 
   // (SBAR (IN that) ...)
-  if(getLabel() == "IN" &&
+  if(getLabelId() == LABEL_IN &&
      toLower(getHeadWord()) == "that" &&
      _parent != NULL &&
-     _parent->getLabel() == "SBAR" &&
+     _parent->getLabelId() == LABEL_SBAR &&
      _parent->_children.front().operator->() == this)
     return true;
 
@@ -1334,11 +1383,11 @@ detectSurfaceDistance(const std::vector< RCIPtr<srl::Tree> > & sentence,
   for(int i = left; i < right; i ++){
     tokenDist ++;
 
-    if(sentence[i]->getLabel() == ","){
+    if(sentence[i]->getLabelId() == LABEL_COMMA){
       commaDist ++;
-    } else if(sentence[i]->getLabel() == "CC"){
+    } else if(sentence[i]->getLabelId() == LABEL_CC){
       ccDist ++;
-    } else if(sentence[i]->getLabel().substr(0, 2) == "VB"){
+    } else if(sentence[i]->hasLabelCategory(LABEL_IS_VERB)){
        if(! sentence[i]->isAuxVerb()){
 	 vbDist ++;
        }
@@ -1391,7 +1440,7 @@ const Tree * Tree::
 findParentForLluisHeuristic() const
 {
   const Tree * p = _parent;
-  while(p != NULL && p->getLabel().substr(0, 1) != "S")
+  while(p != NULL && ! p->hasLabelCategory(LABEL_IS_CLAUSE))
     p = p->_parent;
 
   /*
@@ -1426,17 +1475,8 @@ generateFeatureSets(const std::vector< RCIPtr<srl::Tree> > & sentence,
 
 static bool usefulSyntacticLabel(const string & label)
 {
-  static char * skip [] = {
-    "S1", "TOP", "LST", "SYM", "LS", "SBARQ", "RRC", "SQ", "X", "SINV",
-    "UH", "INTJ", "WHADJP", "FRAG", "WP$", "FW", "EX", "NX", "UCP", "NAC",
-    "AUXG", "WHPP", "PDT", ".", "WHADVP", "WRB", NULL
-  };
-
-  for(int i = 0; skip[i] != NULL; i ++){
-    if(label == skip[i]) return false;
-  }
-
-  return true;
+  // the skipped labels are marked in the label table
+  return ((Label::getCategories(label) & LABEL_IS_RARE) == 0);
 }
 
 void Tree::
@@ -1639,7 +1679,7 @@ int Tree::countDTIgnore() const
 {
   String lower = toLower(getHeadWord());
   if(isTerminal() &&
-     getLabel() == "DT" &&
+     getLabelId() == LABEL_DT &&
      (lower == "the" ||
       lower == "a")){
     return 1;
@@ -1892,7 +1932,7 @@ bool Tree::detectSyntacticFrame(const Tree * arg,
   // e.g. for constructs such as NP(the quitting president) it is useless
   //
   if(pred->getParent() == NULL ||
-     pred->getParent()->getLabel() != "VP"){
+     pred->getParent()->getLabelId() != LABEL_VP){
     return false;
   }
 
@@ -1930,14 +1970,14 @@ bool Tree::detectSyntacticFrame(const Tree * arg,
 	}
 
 	// found an NP
-	else if((* it)->getLabel() == "NP"){
+	else if((* it)->getLabelId() == LABEL_NP){
 	  elements.push_back((* it).operator->());
 	}
 
 	// found a PP with NP
-	else if((* it)->getLabel() == "PP" &&
+	else if((* it)->getLabelId() == LABEL_PP &&
 		(* it)->_children.empty() == false &&
-		(* it)->_children.back()->getLabel() == "NP"){
+		(* it)->_children.back()->getLabelId() == LABEL_NP){
 	  elements.push_back((* it).operator->());
 	}
       }
@@ -1962,14 +2002,14 @@ bool Tree::detectSyntacticFrame(const Tree * arg,
 	}
 
 	// found an NP
-	else if((* it)->getLabel() == "NP"){
+	else if((* it)->getLabelId() == LABEL_NP){
 	  elements.push_front((* it).operator->());
 	}
 
 	// found a PP with NP
-	else if((* it)->getLabel() == "PP" &&
+	else if((* it)->getLabelId() == LABEL_PP &&
 		(* it)->_children.empty() == false &&
-		(* it)->_children.back()->getLabel() == "NP"){
+		(* it)->_children.back()->getLabelId() == LABEL_NP){
 	  elements.push_front((* it).operator->());
 	}
       }
@@ -2346,10 +2386,10 @@ generateExampleFeatures(const std::vector< RCIPtr<srl::Tree> > & sentence,
 
 bool Tree::isCollinsSpecial() const
 {
-  if(getLabel() == "," ||
-     getLabel() == ":" ||
-     getLabel() == "``" ||
-     getLabel() == "''")
+  if(getLabelId() == LABEL_COMMA ||
+     getLabelId() == LABEL_COLON ||
+     getLabelId() == LABEL_LQUOTE ||
+     getLabelId() == LABEL_RQUOTE)
     return true;
   return false;
 }
@@ -2402,7 +2442,7 @@ bool Tree::isValidPalmerHeuristic(const Tree * pred) const
       }
       
       // children of a PP child
-      if((* it)->getLabel() == "PP"){
+      if((* it)->getLabelId() == LABEL_PP){
 	for(list<TreePtr>::const_iterator ppit = (* it)->_children.begin();
 	    ppit != (* it)->_children.end(); ppit ++){
 	  if((* ppit).operator->() == this){
@@ -2414,7 +2454,7 @@ bool Tree::isValidPalmerHeuristic(const Tree * pred) const
 
       // this is from Lluis' heuristic:
       //   stop looking when reaching the first S* parent
-      if(crtParent->_label.substr(0, 1) == "S") break;
+      if(crtParent->hasLabelCategory(LABEL_IS_CLAUSE)) break;
     }
   }
 
@@ -2470,6 +2510,16 @@ void Tree::propagatePredicate(const String & lemma,
 }
 
 void Tree::detectBTypes()
+{
+  detectBType();
+
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectBTypes();
+  }
+}
+
+void Tree::detectBType()
 {
   for(list<Argument>::iterator it = _arguments.begin();
       it != _arguments.end(); it ++){
@@ -2512,11 +2562,6 @@ void Tree::detectBTypes()
       RVASSERT(found, "Found I arg without B arg: " << * this);
     }
   }
-
-  for(list<TreePtr>::iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectBTypes();
-  }
 }
 
 void Tree::countBTypes(int & single,
@@ -2583,6 +2628,16 @@ bool Tree::ugglyPhrase() const
 }
 
 void Tree::detectSiblings()
+{
+  detectChildrenSiblings();
+
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->detectSiblings();
+  }
+}
+
+void Tree::detectChildrenSiblings()
 {
   Tree * previous = NULL;
   for(list<TreePtr>::iterator it = _children.begin();
@@ -2595,11 +2650,6 @@ void Tree::detectSiblings()
 
     previous = (* it).operator->();
   }
-
-  for(list<TreePtr>::iterator it = _children.begin();
-      it != _children.end(); it ++){
-    (* it)->detectSiblings();
-  }
 }
 
 const Tree * Tree::findMatchingTree(int start, int end)
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
 #include <limits.h>
 #include <float.h>
 
@@ -16,11 +17,16 @@
 #include "Argument.h"
 #include "Classifier.h"
 #include "StringMap.h"
+#include "Label.h"
+#include "TreeArena.h"
 #include "ClassifiedArg.h"
 #include "PathFeatures.h"
 
 namespace srl {
 
+class ThreadPool;
+class LatencyBudget;
+
 /**
  * Voice types
  */
@@ -82,7 +88,8 @@ class Tree : public RCObject {
  public:
 
   /** C'tor */
-  Tree() : _head(NULL), _content(NULL), _parent(NULL), 
+  Tree() : _labelId(LABEL_OTHER), _labelCategories(0),
+    _head(NULL), _content(NULL), _parent(NULL), 
     _leftSibling(NULL), _rightSibling(NULL), 
     _verbType(VERB_ACTIVE), 
     _leftPosition(-1), _rightPosition(-1),
@@ -94,14 +101,22 @@ class Tree : public RCObject {
     _word(word), _label(label), _head(NULL), _content(NULL), _parent(NULL),
     _leftSibling(NULL), _rightSibling(NULL), 
     _verbType(VERB_ACTIVE), _leftPosition(-1), _rightPosition(-1),
-    _isPredicate(false), _isAuxVerb(false), _oracleMode(false) {} 
+    _isPredicate(false), _isAuxVerb(false), _oracleMode(false) 
+    { Label::lookup(_label, _labelId, _labelCategories); }
   
   /** C'tor */
   Tree(const String & label):
     _label(label), _head(NULL), _content(NULL), _parent(NULL),
     _leftSibling(NULL), _rightSibling(NULL), 
     _verbType(VERB_ACTIVE), _leftPosition(-1), _rightPosition(-1),
-    _isPredicate(false), _isAuxVerb(false), _oracleMode(false) {}
+    _isPredicate(false), _isAuxVerb(false), _oracleMode(false)
+    { Label::lookup(_label, _labelId, _labelCategories); }
+
+  /** Nodes are allocated from the current TreeArena, if any */
+  static void * operator new(size_t size) 
+    { return TreeArena::allocate(size); }
+  static void operator delete(void * p) 
+    { TreeArena::deallocate(p); }
 
   /** Fetches the token word, for terminal nodes */
   const String & getWord() const { return _word; };
@@ -113,7 +128,17 @@ class Tree : public RCObject {
   const String & getLabel() const { return _label; };  
 
   /** Sets the node syntactic label */
-  void setLabel(const String & label) { _label = label; };
+  void setLabel(const String & label) { 
+    _label = label; 
+    Label::lookup(_label, _labelId, _labelCategories);
+  };
+
+  /** Fetches the interned label, a LabelId */
+  short getLabelId() const { return _labelId; };
+
+  /** Does the label have any of these LabelCategory bits? */
+  bool hasLabelCategory(unsigned short c) const 
+    { return ((_labelCategories & c) != 0); };
 
   /** Fetches the head node pointer */
   const RCIPtr<srl::Tree> & getHead() const { return _head; };
@@ -254,6 +279,8 @@ class Tree : public RCObject {
     _word = W("");
     _lemma = W("");
     _label = W("");
+    _labelId = LABEL_OTHER;
+    _labelCategories = 0;
     _children.clear();
     _head = RCIPtr<srl::Tree>();
     _content = RCIPtr<srl::Tree>();
@@ -458,11 +485,61 @@ class Tree : public RCObject {
   void generateFeatureSets(const std::vector< RCIPtr<srl::Tree> > & sentence,
 			   bool caseSensitive);
 
+  /**
+   * Computes all the annotations required for SRL on this tree, 
+   *   and the phrase-specific feature sets, in two traversals.
+   * Produces the same output as calling setHead(), detectContentWords(),
+   *   setPositions(), ..., detectSiblings() and generateFeatureSets()
+   *   one after another, each of which walks the whole tree.
+   * Empty nodes must be removed before calling this method.
+   * The terminals are stored in sentence.
+   */
+  void preprocess(std::vector< RCIPtr<srl::Tree> > & sentence,
+		  bool caseSensitive);
+
   /** Classifies arguments for all predicates in this sentence */
   void classify(const std::vector< RCIPtr<srl::Tree> > & sentence,
 		int sentenceIndex,
 		bool caseSensitive);
 
+  /**
+   * Same as above, but keeps at most localBeam labels per argument 
+   *   candidate (LOCAL_COUNT_BEAM by default), only the labels within 
+   *   localConfBeam of the best one (LOCAL_CONF_BEAM by default), and 
+   *   globalBeam frames per predicate (GLOBAL_BEAM by default)
+   * @param allowedLabels If not NULL, only these labels (e.g. A0, R-A0,
+   *                      AM-TMP) and O are kept; the probabilities are
+   *                      still normalized over all labels
+   * @param budget If not NULL, classification stops once its deadline
+   *               has passed: the remaining predicates get no arguments,
+   *               and the predicate in progress keeps the candidates
+   *               classified so far
+   */
+  void classify(const std::vector< RCIPtr<srl::Tree> > & sentence,
+		int sentenceIndex,
+		bool caseSensitive,
+		int localBeam,
+		double localConfBeam,
+		int globalBeam,
+		const std::set<String> * allowedLabels = NULL,
+		const LatencyBudget * budget = NULL);
+
+  /**
+   * Finds the best argument frame for the predicate at the given position.
+   * Does not modify the tree (except for oracle stats), so the 
+   *   predicates of a sentence can be processed concurrently.
+   * The frame stores only the non-O arguments.
+   */
+  void classifyPredicate(const std::vector< RCIPtr<srl::Tree> > & sentence,
+			 int position,
+			 bool caseSensitive,
+			 int localBeam,
+			 double localConfBeam,
+			 int globalBeam,
+			 const std::set<String> * allowedLabels,
+			 std::vector<ClassifiedArg> & frame,
+			 const LatencyBudget * budget = NULL);
+
   /** Dump tree in the CoNLL standard format */
   void dumpCoNLL(OStream & os,
 		 const std::vector< RCIPtr<srl::Tree> > & sentence,
@@ -477,6 +554,17 @@ class Tree : public RCObject {
   void dumpExtendedCoNLL(OStream & os,
 			 const std::vector< RCIPtr<srl::Tree> > & sentence);
 
+  /**
+   * The predicted arguments of all predicates, ordered by predicate and
+   *   start: the frames of dumpCoNLL(), including its corrections, built
+   *   straight from the predicted Arguments
+   * @param predicates The predicate positions, including the predicates
+   *                   without arguments
+   */
+  void getArgumentSpans(const std::vector< RCIPtr<srl::Tree> > & sentence,
+			std::vector<int> & predicates,
+			std::vector<ArgumentSpan> & spans);
+
   /**
    * Generates the full-syntax label for one terminal,
    *   e.g. "(S1(S(PP*)"
@@ -522,6 +610,26 @@ class Tree : public RCObject {
   /** Fetches the classifier for the given argument label */
   static Classifier * getClassifier(const String & label);
 
+  /** 
+   * Sets the number of threads used by classify() to process the 
+   *   predicates of one sentence in parallel. 1 (default) uses no threads.
+   * The results are applied to the tree in predicate order, 
+   *   so the output does not depend on this setting.
+   */
+  static void setPredicateThreads(int count);
+  static int getPredicateThreads();
+
+  /**
+   * If true, classify() finds the best frame of each predicate with an 
+   *   exact A* search, instead of the beam of GLOBAL_BEAM frames.
+   * Oracle mode always uses the beam, which scores many frames.
+   */
+  static void setExactInference(bool exact) { _exactInference = exact; }
+  static bool getExactInference() { return _exactInference; }
+
+  /** Displays how many frames the inference expanded per predicate */
+  static void printInferenceStats(std::ostream & os);
+
   /** 
    * Returns true if we generated the maximum number of training examples
    */
@@ -602,6 +710,41 @@ class Tree : public RCObject {
   /** Used by setPositions() */
   void setPosition(short & current);
 
+  /**
+   * The stages of preprocess(). Each one annotates a single node, 
+   *   and is also called by the corresponding recursive detect* method.
+   */
+  void detectHead();
+  void detectAuxChildren();
+  void detectPOSContext(const std::vector< RCIPtr<srl::Tree> > & sentence);
+  void detectTemporalTerminal();
+  void gatherIncludes();
+  void detectPredicateVoice(const std::vector< RCIPtr<srl::Tree> > & sent);
+  void detectGoverningParent();
+  void detectChildrenLabels();
+  void detectChildrenSiblingPaths();
+  void detectWordSuffixes(bool caseSensitive);
+  void detectArgumentBegin(const Tree * top);
+  void detectBType();
+  void detectChildrenSiblings();
+
+  /** 
+   * First pass of preprocess(): post-order stages, which need the 
+   *   annotations of the children
+   */
+  void preprocessBottomUp(short & position,
+			  std::vector< RCIPtr<srl::Tree> > & sentence,
+			  bool caseSensitive);
+
+  /**
+   * Second pass of preprocess(): pre-order stages, which need the 
+   *   full sentence or the annotations of the parent, followed by the 
+   *   (bottom-up) generation of feature sets
+   */
+  void preprocessTopDown(const std::vector< RCIPtr<srl::Tree> > & sentence,
+			 const Tree * top,
+			 bool caseSensitive);
+
   /** Detects reference phrases */
   bool isReferent() const;
 
@@ -690,6 +833,8 @@ class Tree : public RCObject {
   /**
    * Generates argument labels for all candidate phrases for a predicate
    * Used by both greedyClassification and dynamicClassification
+   * If the deadline of the budget passes, the candidates not classified
+   *   yet are left out of allArgs
    */
   void generateArgsForCandidates(const std::vector< RCIPtr<srl::Tree> > & sentence,
 				 const Tree * predicate,
@@ -698,7 +843,9 @@ class Tree : public RCObject {
 				 bool caseSensitive,
 				 int countBeam,
 				 double confBeam,
-				 std::vector<std::vector<ClassifiedArg> *> & allArgs);
+				 const std::set<String> * allowedLabels,
+				 std::vector<std::vector<ClassifiedArg> *> & allArgs,
+				 const LatencyBudget * budget = NULL);
 
   /**
    * Fetches the list of gold args for this predicate 
@@ -710,18 +857,31 @@ class Tree : public RCObject {
 
   /**
    * Greedy classification for all arguments of a given predicate
+   * The selected non-O arguments are stored in result
    */
   void greedyClassification(const Tree * predicate,
 			    std::vector<std::vector<ClassifiedArg> *> & allArgs,
-			    const std::vector<ClassifiedArg> & goldArgs);
+			    const std::vector<ClassifiedArg> & goldArgs,
+			    std::vector<ClassifiedArg> & result);
 
   /**
    * Classification with global search for all arguments of a given predicate
+   * The selected non-O arguments are stored in result
    */
   void rerankingClassification(const Tree * predicate,
 			       std::vector<std::vector<ClassifiedArg> *> & allArgs,
 			       int beam,
-			       const std::vector<ClassifiedArg> & goldArgs);
+			       const std::vector<ClassifiedArg> & goldArgs,
+			       std::vector<ClassifiedArg> & result);
+
+  /**
+   * Classification with exact A* search for all arguments of a predicate
+   * The selected non-O arguments are stored in result
+   * Returns false if the search exceeded ASTAR_MAX_EXPANSIONS
+   */
+  bool searchClassification(const Tree * predicate,
+			    std::vector<std::vector<ClassifiedArg> *> & allArgs,
+			    std::vector<ClassifiedArg> & result);
 
   /**
    * Classifies this phrase for a given predicate
@@ -732,6 +892,7 @@ class Tree : public RCObject {
 			    bool caseSensitive,
 			    int countBeam,
 			    double confBeam,
+			    const std::set<String> * allowedLabels,
 			    std::vector<ClassifiedArg> & output,
 			    std::vector<int> * savedFeatures);
 
@@ -752,6 +913,11 @@ class Tree : public RCObject {
   static void loadAcceptableArgumentLabels(const String & lemma,
 					   std::list<String> & args);
 
+  /** The phrases that are args of one predicate, left to right */
+  void collectArgsForVerb(int predicatePosition,
+			  std::vector<const Tree *> & phrases,
+			  std::vector<const Argument *> & args) const;
+
   /** Dumps args for one predicate in IOB2 format */
   void dumpCoNLLColumnIOB(const std::vector< RCIPtr<srl::Tree> > & sentence,
 			  int predicatePosition,
@@ -824,6 +990,10 @@ class Tree : public RCObject {
   /** The phrase label, POS for terminals, TreeBank for non-terminals */
   String _label;
 
+  /** The interned label and its category bits, kept in sync with _label */
+  short _labelId;
+  unsigned short _labelCategories;
+
   /** The BIO NE label attached to this terminal */
   String _ne;
 
@@ -930,6 +1100,11 @@ class Tree : public RCObject {
   /** The set of argument classifiers (testing only) */
   static StringMap<Classifier *> _classifiers;
 
+  /** Workers for classify(); NULL if predicates are classified serially */
+  static ThreadPool * _predicatePool;
+
+  static bool _exactInference;
+
   /** Scoring stats (PB testing only) */
   static StringMap<Stats *> _stats;
 
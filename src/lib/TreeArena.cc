@@ -0,0 +1,90 @@
+
+#include <cstdlib>
+#include <new>
+
+#include "TreeArena.h"
+
+using namespace std;
+using namespace srl;
+
+__thread TreeArena * TreeArena::_current = NULL;
+
+/**
+ * Every allocation is preceded by a header that points to its arena
+ *   (NULL for heap allocations). The header is padded such that the
+ *   objects keep the alignment of malloc
+ */
+union AllocationHeader {
+  TreeArena * arena;
+  long double alignment;
+};
+
+TreeArena::TreeArena()
+  : _next(NULL), _left(0), _live(1), _closed(false)
+{
+}
+
+TreeArena::~TreeArena()
+{
+  for(size_t i = 0; i < _blocks.size(); i ++) free(_blocks[i]);
+}
+
+void TreeArena::close()
+{
+  _closed = true;
+  // the reference of the open arena
+  release();
+}
+
+void * TreeArena::allocateHere(size_t size)
+{
+  // keep the next allocation aligned as well
+  size = (size + sizeof(AllocationHeader) - 1) /
+    sizeof(AllocationHeader) * sizeof(AllocationHeader);
+
+  if(size > _left){
+    size_t blockSize = (size > BLOCK_SIZE ? size : BLOCK_SIZE);
+    char * block = (char *) malloc(blockSize);
+    if(block == NULL) throw bad_alloc();
+    _blocks.push_back(block);
+    _next = block;
+    _left = blockSize;
+  }
+
+  void * p = _next;
+  _next += size;
+  _left -= size;
+  __sync_fetch_and_add(& _live, 1);
+  return p;
+}
+
+void TreeArena::release()
+{
+  if(__sync_sub_and_fetch(& _live, 1) == 0) delete this;
+}
+
+void * TreeArena::allocate(size_t size)
+{
+  size += sizeof(AllocationHeader);
+
+  AllocationHeader * h = NULL;
+  if(_current != NULL && ! _current->_closed){
+    h = (AllocationHeader *) _current->allocateHere(size);
+    h->arena = _current;
+  } else {
+    h = (AllocationHeader *) malloc(size);
+    if(h == NULL) throw bad_alloc();
+    h->arena = NULL;
+  }
+
+  return h + 1;
+}
+
+void TreeArena::deallocate(void * p)
+{
+  if(p == NULL) return;
+
+  AllocationHeader * h = ((AllocationHeader *) p) - 1;
+  if(h->arena != NULL) h->arena->release();
+  else free(h);
+}
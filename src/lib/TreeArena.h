@@ -0,0 +1,101 @@
+
+#ifndef SRL_TREE_ARENA_H
+#define SRL_TREE_ARENA_H
+
+#include <vector>
+#include <cstddef>
+
+namespace srl {
+
+  /**
+   * Bump allocator for the Tree nodes of one sentence.
+   * While an arena is current (see TreeArena::Scope), every new Tree is
+   *   carved out of its blocks instead of being allocated on the heap.
+   *   Deleting such a node only decrements the arena's live count; the
+   *   blocks are freed in one step once the arena is closed and its last
+   *   node is gone, so trees returned to the caller stay valid until the
+   *   caller drops them.
+   * Only the Tree objects themselves come from the arena: the strings,
+   *   lists, and maps that a node holds still allocate on the heap, so
+   *   the arena removes one heap allocation per node, not all of them.
+   *   On the 40-sentence test file, that is 41 of the 168 allocations of
+   *   parsing a sentence, but only 41 of the 11,630 of parsing and
+   *   labeling it, and the labeling time did not change measurably.
+   * Only the parser runs in an arena (see SwirlContext::parseSyntax()):
+   *   the nodes made later, while labeling, come from the heap.
+   * Nodes created with no current arena go to the heap, as before.
+   * Each thread has its own current arena, and only that thread
+   *   allocates from it. The nodes may be deleted from any thread (e.g.
+   *   the predicate threads): the live count is atomic.
+   */
+  class TreeArena {
+
+  public:
+    TreeArena();
+
+    /**
+     * Marks the end of the sentence: no more nodes are allocated here.
+     * The arena deletes itself when its last node is deleted
+     *   (or immediately, if no node is alive).
+     */
+    void close();
+
+    /** Allocates size bytes from the current arena, or from the heap */
+    static void * allocate(size_t size);
+
+    /** Releases memory returned by allocate() */
+    static void deallocate(void * p);
+
+    /** Makes an arena current for the lifetime of this object */
+    class Scope {
+    public:
+      Scope(TreeArena * arena) : _previous(_current) { _current = arena; }
+      ~Scope() { _current = _previous; }
+    private:
+      TreeArena * _previous;
+    };
+
+    /**
+     * Allocates all the nodes created in this scope from a fresh arena,
+     *   which is closed when the scope ends
+     */
+    class SentenceScope {
+    public:
+      SentenceScope() : _arena(new TreeArena), _scope(_arena) {}
+      ~SentenceScope() { _arena->close(); }
+    private:
+      TreeArena * _arena;
+      Scope _scope;
+    };
+
+  private:
+    /** Only close() destroys arenas */
+    ~TreeArena();
+    TreeArena(const TreeArena &);
+    TreeArena & operator = (const TreeArena &);
+
+    void * allocateHere(size_t size);
+
+    void release();
+
+    enum { BLOCK_SIZE = 64 * 1024 };
+
+    std::vector<char *> _blocks;
+    char * _next;
+    size_t _left;
+
+    /**
+     * Number of nodes allocated here and not yet deleted, plus one until
+     *   close(); updated atomically. Whoever brings it to 0 deletes the
+     *   arena.
+     */
+    size_t _live;
+
+    bool _closed;
+
+    static __thread TreeArena * _current;
+  };
+
+} // end namespace srl
+
+#endif
@@ -12,6 +12,10 @@
 //#include "SVMClassifier.h"
 #include "UnitCandidate.h"
 #include "Score.h"
+#include "ThreadPool.h"
+#include "Mutex.h"
+#include "PipelineStats.h"
+#include "LatencyBudget.h"
 
 using namespace std;
 using namespace srl;
@@ -20,6 +24,46 @@ using namespace srl;
 
 StringMap<Classifier *> Tree::_classifiers;
 
+ThreadPool * Tree::_predicatePool = NULL;
+
+bool Tree::_exactInference = false;
+
+//
+// work done by the frame inference: frames offered to the beam, or
+//   frames expanded by A*
+//
+static long inferencePredicates = 0;
+static long inferenceExpansions = 0;
+static long inferenceFallbacks = 0;
+
+/** Guards the inference stats, for predicates classified in parallel */
+static Mutex inferenceMutex;
+
+static void addInferenceStats(long expansions, bool fallback)
+{
+  MutexLock lock(inferenceMutex);
+  inferencePredicates ++;
+  inferenceExpansions += expansions;
+  if(fallback) inferenceFallbacks ++;
+}
+
+void Tree::printInferenceStats(ostream & os)
+{
+  MutexLock lock(inferenceMutex);
+  os << "Inference: " << (_exactInference ? "A*" : "beam")
+     << ", " << inferencePredicates << " predicates, "
+     << inferenceExpansions
+     << (_exactInference ? " frames expanded" : " frames offered");
+  if(inferencePredicates > 0){
+    os << " (" << (double) inferenceExpansions / inferencePredicates 
+       << " per predicate)";
+  }
+  if(_exactInference){
+    os << ", " << inferenceFallbacks << " fallbacks to the beam";
+  }
+  os << endl;
+}
+
 ///////////////////////////////////////////////////////////////////////
 //
 // These statistics computed when running in ORACLE mode
@@ -40,6 +84,9 @@ static vector<int> bestPositions;
 //
 static vector<Score> oracleScores;
 
+/** Guards the stats above, for sentences classified in parallel */
+static Mutex oracleMutex;
+
 void Tree::resetOracleStats()
 {
   int max = LOCAL_COUNT_BEAM;
@@ -160,7 +207,10 @@ static String merge(const String & s1,
        failedClasses.push_back(labels[i]);
      }
 
-     _classifiers.set(labels[i], c);
+     // the classifiers of an earlier, failed call are replaced
+     Classifier * old = NULL;
+     if(_classifiers.get(labels[i], old)) delete old;
+     _classifiers.overwrite(labels[i], c);
    }
    //cerr << endl;
 
@@ -202,10 +252,82 @@ void Tree::fetchGoldArgsForPredicate(const Tree * predicate,
   }
 }
 
+ void Tree::setPredicateThreads(int count)
+ {
+   RVASSERT(count > 0, "Invalid number of predicate threads: " << count);
+   delete _predicatePool;
+   _predicatePool = NULL;
+   if(count > 1) _predicatePool = new ThreadPool(count);
+ }
+
+ int Tree::getPredicateThreads()
+ {
+   if(_predicatePool == NULL) return 1;
+   return _predicatePool->size();
+ }
+
+/**
+ * Classifies one predicate of a sentence in a worker thread
+ */
+class PredicateTask : public ThreadTask
+{
+public:
+  PredicateTask(Tree * tree,
+		const vector<TreePtr> * sentence,
+		int position,
+		bool caseSensitive,
+		int localBeam,
+		double localConfBeam,
+		int globalBeam,
+		const set<String> * allowedLabels,
+		vector<ClassifiedArg> * frame,
+		const LatencyBudget * budget)
+    : _tree(tree), _sentence(sentence), _position(position),
+      _caseSensitive(caseSensitive), _localBeam(localBeam),
+      _localConfBeam(localConfBeam), _globalBeam(globalBeam), 
+      _allowedLabels(allowedLabels), 
+      _frame(frame), _budget(budget) {}
+
+  void run() {
+    // the tasks still queued when the deadline passes do nothing
+    if(_budget != NULL && _budget->isExpired()) return;
+    _tree->classifyPredicate(* _sentence, _position, _caseSensitive, 
+			     _localBeam, _localConfBeam, _globalBeam, 
+			     _allowedLabels, 
+			     * _frame, _budget);
+  }
+
+private:
+  Tree * _tree;
+  const vector<TreePtr> * _sentence;
+  int _position;
+  bool _caseSensitive;
+  int _localBeam;
+  double _localConfBeam;
+  int _globalBeam;
+  const set<String> * _allowedLabels;
+  vector<ClassifiedArg> * _frame;
+  const LatencyBudget * _budget;
+};
+
  void Tree::
  classify(const std::vector< RCIPtr<srl::Tree> > & sentence,
 	  int sentenceIndex,
 	  bool caseSensitive)
+ {
+   classify(sentence, sentenceIndex, caseSensitive, 
+	    LOCAL_COUNT_BEAM, LOCAL_CONF_BEAM, GLOBAL_BEAM);
+ }
+
+ void Tree::
+ classify(const std::vector< RCIPtr<srl::Tree> > & sentence,
+	  int sentenceIndex,
+	  bool caseSensitive,
+	  int localBeam,
+	  double localConfBeam,
+	  int globalBeam,
+	  const std::set<String> * allowedLabels,
+	  const LatencyBudget * budget)
  {
    LOGH << "Started SRL classification for sentence:\n";
    LOGH << * this << "\n\n";
@@ -215,79 +337,55 @@ void Tree::fetchGoldArgsForPredicate(const Tree * predicate,
    detectPredicates(predPositions);
    LOGH << "Found " << predPositions.size() << " predicates.\n";
 
+   // the best frame for each predicate
+   vector< vector<ClassifiedArg> > frames(predPositions.size());
+
+   //
+   // the predicates are independent until their frames are stored in 
+   //   the tree, so they can be classified in parallel
+   // the oracle mode updates global stats, hence it always runs serially
+   //
+   bool parallel = (_predicatePool != NULL && 
+		    predPositions.size() > 1 &&
+		    getOracleMode() == false);
+   if(parallel){
+     vector<PredicateTask> tasks;
+     for(size_t i = 0; i < predPositions.size(); i ++){
+       tasks.push_back(PredicateTask(this, & sentence, predPositions[i], 
+				     caseSensitive, localBeam, localConfBeam,
+				     globalBeam, allowedLabels, & frames[i],
+				     budget));
+     }
+     vector<ThreadTask *> taskPointers;
+     for(size_t i = 0; i < tasks.size(); i ++){
+       taskPointers.push_back(& tasks[i]);
+     }
+     _predicatePool->run(taskPointers);
+   }
+
    //
-   // classify args for each predicate
+   // store the args for each predicate, in predicate order
    //
    for(int predicateIndex = 0; 
        predicateIndex < (int) predPositions.size(); 
        predicateIndex ++){
 
      int position = predPositions[predicateIndex];
-     RVASSERT(position >= 0 && position < (int) sentence.size(),
-	     "Invalid predicate position " << position);
-     //cerr << "Classifying sentence " << sentenceIndex << " with predicate " << predicateIndex << endl;
+     vector<ClassifiedArg> & frame = frames[predicateIndex];
+     // past the deadline, the remaining predicates get no arguments
+     if(! parallel && (budget == NULL || ! budget->isExpired())){
+       classifyPredicate(sentence, position, caseSensitive, 
+			 localBeam, localConfBeam, globalBeam, allowedLabels, 
+			 frame, budget);
+     }
 
-     // this is the current predicate
      Tree * predicate = sentence[position].operator->();
-     RVASSERT(predicate != NULL && predicate->isPredicate(),
-	      "Chosen phrase is not a predicate!");
-     LOGH << "Inspecting predicate: " << * predicate;
-
-     // the first S* parent
-     const Tree * predParent = predicate->findParentForLluisHeuristic();
-     RVASSERT(predParent != NULL, "Found NULL parent for Lluis heuristic!");
-
-     // which argument types are possible for this predicate?
-     list<String> possibleArgLabels;
-     loadAcceptableArgumentLabels(predicate->getLemma(), possibleArgLabels);
-
-     LOGH << "Arg list is:";
-     for(list<String>::const_iterator it = possibleArgLabels.begin();
-	 it != possibleArgLabels.end(); it ++)
-       LOGH << " " << * it;
-     LOGH << endl;
-
-     //
-     // this is the full set of candidates for this predicate
-     // required by both greedyClassification and rerankingClassification
-     //
-     vector<Tree *> candidates;
-     findCandidatesForPredicate(predicate, predParent, candidates);
-
-     //
-     // this is the set of arg labels for all candidates
-     // required by both greedyClassification and rerankingClassification
-     // candidatesArgs is sorted (both rows and columns) in 
-     //   descending order of the classifier confidences
-     //
-     vector< vector<ClassifiedArg> *> candidatesArgs;
-     generateArgsForCandidates(sentence, predicate, 
-			       possibleArgLabels, candidates, 
-			       caseSensitive, 
-			       LOCAL_COUNT_BEAM, LOCAL_CONF_BEAM,
-			       candidatesArgs);
-
-     // 
-     // if we're running in oracle mode fetch the list of GOLD args
-     //
-     vector<ClassifiedArg> goldArgs;
-     if(getOracleMode()) fetchGoldArgsForPredicate(predicate, goldArgs);
-
-     // classification using global search within many frame candidates
-     if(DO_CLASSIFICATION_WITH_APPROXIMATE_INFERENCE){
-       rerankingClassification(predicate, candidatesArgs, 
-			       GLOBAL_BEAM, goldArgs);
-     } 
-
-     // use the greedy strategy for classification
-     else {
-       greedyClassification(predicate, candidatesArgs, goldArgs);
+     for(size_t i = 0; i < frame.size(); i ++){
+       Argument arg("B", frame[i].label, predicate->getRightPosition());
+       arg.setProb(frame[i].prob);
+       frame[i].phrase->addArgPrediction(arg);
      }
 
-     // cleanup
-     for(size_t i = 0; i < candidatesArgs.size(); i ++)
-       delete candidatesArgs[i];
-
      //
      // expand terminal Bs
      // XXX: you can disable expansion heuristics here!
@@ -301,6 +399,86 @@ void Tree::fetchGoldArgsForPredicate(const Tree * predicate,
 	<< endl << * this;
  }
 
+ void Tree::
+ classifyPredicate(const std::vector< RCIPtr<srl::Tree> > & sentence,
+		   int position,
+		   bool caseSensitive,
+		   int localBeam,
+		   double localConfBeam,
+		   int globalBeam,
+		   const std::set<String> * allowedLabels,
+		   std::vector<ClassifiedArg> & frame,
+		   const LatencyBudget * budget)
+ {
+   RVASSERT(position >= 0 && position < (int) sentence.size(),
+	    "Invalid predicate position " << position);
+
+   // this is the current predicate
+   Tree * predicate = sentence[position].operator->();
+   RVASSERT(predicate != NULL && predicate->isPredicate(),
+	    "Chosen phrase is not a predicate!");
+   LOGH << "Inspecting predicate: " << * predicate;
+
+   // the first S* parent
+   const Tree * predParent = predicate->findParentForLluisHeuristic();
+   RVASSERT(predParent != NULL, "Found NULL parent for Lluis heuristic!");
+
+   // which argument types are possible for this predicate?
+   list<String> possibleArgLabels;
+   loadAcceptableArgumentLabels(predicate->getLemma(), possibleArgLabels);
+
+   LOGH << "Arg list is:";
+   for(list<String>::const_iterator it = possibleArgLabels.begin();
+       it != possibleArgLabels.end(); it ++)
+     LOGH << " " << * it;
+   LOGH << endl;
+
+   //
+   // this is the full set of candidates for this predicate
+   // required by both greedyClassification and rerankingClassification
+   //
+   vector<Tree *> candidates;
+   findCandidatesForPredicate(predicate, predParent, candidates);
+
+   //
+   // this is the set of arg labels for all candidates
+   // required by both greedyClassification and rerankingClassification
+   // candidatesArgs is sorted (both rows and columns) in 
+   //   descending order of the classifier confidences
+   //
+   vector< vector<ClassifiedArg> *> candidatesArgs;
+   generateArgsForCandidates(sentence, predicate, 
+			     possibleArgLabels, candidates, 
+			     caseSensitive, 
+			     localBeam, localConfBeam, allowedLabels,
+			     candidatesArgs, budget);
+
+   // 
+   // if we're running in oracle mode fetch the list of GOLD args
+   //
+   vector<ClassifiedArg> goldArgs;
+   if(getOracleMode()) fetchGoldArgsForPredicate(predicate, goldArgs);
+
+   // classification using global search within many frame candidates
+   StatTimer timer(STAT_RERANKING);
+   if(DO_CLASSIFICATION_WITH_APPROXIMATE_INFERENCE){
+     if(_exactInference == false || getOracleMode() == true ||
+	searchClassification(predicate, candidatesArgs, frame) == false){
+       rerankingClassification(predicate, candidatesArgs, 
+			       globalBeam, goldArgs, frame);
+     }
+   } 
+
+   // use the greedy strategy for classification
+   else {
+     greedyClassification(predicate, candidatesArgs, goldArgs, frame);
+   }
+
+   // cleanup
+   for(size_t i = 0; i < candidatesArgs.size(); i ++)
+     delete candidatesArgs[i];
+ }
+
  static bool satisfiesDomainConstraints(const vector<ClassifiedArg> & frame,
 					const ClassifiedArg & newArg)
  {
@@ -353,7 +531,9 @@ public:
 			   bool caseSensitive,
 			   int countBeam,
 			   double confBeam,
-			   vector<vector<ClassifiedArg> *> & allArgs)
+			   const std::set<String> * allowedLabels,
+			   vector<vector<ClassifiedArg> *> & allArgs,
+			   const LatencyBudget * budget)
  {
    //
    // allArgs stores all possible label assignments for each candidate
@@ -368,9 +548,17 @@ public:
    // fetch the confidences for all possible labels for all candidates
    //
    for(size_t i = 0; i < candidates.size(); i ++){
+     // past the deadline, infer the frame from the candidates seen so far
+     if(budget != NULL && budget->isExpired()){
+       LOGH << "Deadline expired after " << i << " of " 
+	    << candidates.size() << " candidates" << endl;
+       for(size_t j = i; j < allArgs.size(); j ++) delete allArgs[j];
+       allArgs.resize(i);
+       break;
+     }
      candidates[i]->classifyForPredicate(sentence, predicate, 
 					 possibleArgLabels, caseSensitive, 
-					 countBeam, confBeam,
+					 countBeam, confBeam, allowedLabels,
 					 * allArgs[i], NULL);
    }
 
@@ -384,10 +572,11 @@ public:
  void
  Tree::classifyForPredicate(const std::vector< RCIPtr<srl::Tree> > & sentence,
 			    const Tree * predicate,
-			    const list<String> & allowedLabels, 
+			    const list<String> & possibleArgLabels, 
 			    bool caseSensitive,
 			    int countBeam,
 			    double confBeam,
+			    const std::set<String> * allowedLabels,
 			    std::vector<ClassifiedArg> & result,
 			    std::vector<int> * savedFeatures)
  {
@@ -401,6 +590,7 @@ public:
    //
    vector<int> features;
    vector<DebugFeature> debugFeats;
+   unsigned long long start = PipelineStats::now();
    generateExampleFeatures(sentence, 
 			   predicate, 
 			   predicate->getRightPosition(),
@@ -410,6 +600,10 @@ public:
 			   & debugFeats,
 			   false, // this param not used in classification!
 			   caseSensitive); 
+   unsigned long long end = PipelineStats::now();
+   PipelineStats::record(STAT_FEATURES, (end > start ? end - start : 0));
+   // scoring covers the classifiers, the softmax, and the beam
+   StatTimer timer(STAT_SCORING);
 
    // save features if needed (needed for reranking)
    if(savedFeatures != NULL){
@@ -421,8 +615,8 @@ public:
    //
    // traverse all possible arg labels, and classify this phrase
    //
-   for(list<String>::const_iterator ait = allowedLabels.begin();
-       ait != allowedLabels.end(); ait ++){
+   for(list<String>::const_iterator ait = possibleArgLabels.begin();
+       ait != possibleArgLabels.end(); ait ++){
      const String & argLabel = (* ait);
 
      //
@@ -450,8 +644,13 @@ public:
      }
      LOGD << endl;
 
-     output.push_back(ClassifiedArg(this, argLabel, conf));
+     // the labels filtered out still count in the softmax, such that
+     //   the filter does not change the probabilities of the others
      allLabelConfidences.push_back(conf);
+     if(allowedLabels == NULL || argLabel == "O" || 
+	allowedLabels->count(argLabel) > 0){
+       output.push_back(ClassifiedArg(this, argLabel, conf));
+     }
 
    } // end all possible arg labels  
 
@@ -527,7 +726,8 @@ static void fetchFrameGreedy(const vector<vector<ClassifiedArg> *> & allArgs,
 void Tree::
 greedyClassification(const Tree * predicate,
 		     vector<vector<ClassifiedArg> *> & allArgs,
-		     const vector<ClassifiedArg> & goldArgs)
+		     const vector<ClassifiedArg> & goldArgs,
+		     vector<ClassifiedArg> & result)
 {
   bool showGold = false;
   if(showGold){
@@ -547,10 +747,8 @@ greedyClassification(const Tree * predicate,
   fetchFrameGreedy(allArgs, predicate, frame, LOCAL_COUNT_BEAM, 
 		   false, goldArgs);
   if(showFrame) cerr << "Predicate: " << predicate->getWord() << endl;
+  result = frame;
   for(size_t i = 0; i < frame.size(); i ++){
-    Argument arg("B", frame[i].label, predicate->getRightPosition());
-    arg.setProb(frame[i].prob);
-    frame[i].phrase->addArgPrediction(arg);
     if(showFrame) cerr << "\tArg: " << frame[i].label << " " 
 		       << frame[i].phrase->getLeftPosition() << " " 
 		       << frame[i].phrase->getRightPosition() << endl;
@@ -560,6 +758,7 @@ greedyClassification(const Tree * predicate,
   // oracle mode: compute the position of the best argument
   //
   if(getOracleMode() == true){
+    MutexLock lock(oracleMutex);
     frame.clear();
     for(size_t i = 0; i < allArgs.size(); i ++){
       const vector<ClassifiedArg> & crtArgs = * allArgs[i];
@@ -578,6 +777,7 @@ greedyClassification(const Tree * predicate,
   // oracle mode: upper score when using the top N labels per candidate
   //
   if(getOracleMode() == true){
+    MutexLock lock(oracleMutex);
     for(int i = 1; i < LOCAL_COUNT_BEAM; i ++){
       vector<ClassifiedArg> frame;
       fetchFrameGreedy(allArgs, predicate, frame, i, true, goldArgs);
@@ -623,7 +823,7 @@ greedyClassification(const Tree * predicate,
    }
 
    // the numeric args + R-* + C-*
-   bool * frame = Lexicon::getFrame(lemma);
+   const bool * frame = Lexicon::getFrame(lemma);
    // RVASSERT(frame != NULL, "Found NULL frame for verb: " << lemma);
    for(int i = 0; i < MAX_NUMBERED_ARGS; i ++){
      if(frame == NULL || frame[i] == true){
@@ -639,51 +839,17 @@ greedyClassification(const Tree * predicate,
    args.push_back("O");
  }
 
- /** Adds a candidate to the list, 
-     maintaining the list in descending order of the candidate log prob
+/** 
+ * Selects the frame with the highest oracle score among the first 
+ *   maxCount frames
  */
- static void addInOrder(list<UnitCandidate *> & cands,
-			UnitCandidate * cand)
- {
-   for(list<UnitCandidate *>::iterator it = cands.begin();
-       it != cands.end(); it ++){
-     if((* it)->mProb < cand->mProb){
-       cands.insert(it, cand);
-       return;
-     }
-   }
-   cands.push_back(cand);
- }
-
- static void deleteCandList(list<UnitCandidate *> * cands)
- {
-   for(list<UnitCandidate *>::iterator it = cands->begin();
-       it != cands->end(); it ++){
-     delete * it;
-   }
-   delete cands;
- }
-
-/** Trims the list to at most maxSize elements */
-static void trim(list<UnitCandidate *> & cands,
-		 size_t maxSize) {
-  while(cands.size() > maxSize){
-    UnitCandidate * back = cands.back();
-    cands.pop_back();
-    delete back;
-  }
-}
-
-static UnitCandidate * selectBestFrame(const list<UnitCandidate *> & cands,
-				       int maxCount)
+static int selectBestFrame(const vector<Score> & scores,
+			   int maxCount)
 {
-  int pos = 0;
-  UnitCandidate * best = NULL;
-  for(list<UnitCandidate *>::const_iterator it = cands.begin();
-      it != cands.end() && pos < maxCount; it ++, pos ++){
-    UnitCandidate * crt = * it;
-    if(best == NULL || crt->mScore.F1() > best->mScore.F1()){
-      best = crt;
+  int best = -1;
+  for(int i = 0; i < (int) scores.size() && i < maxCount; i ++){
+    if(best < 0 || scores[i].F1() > scores[best].F1()){
+      best = i;
     }
   }
   return best;
@@ -693,7 +859,8 @@ void Tree::
 rerankingClassification(const Tree * predicate,
 			vector<vector<ClassifiedArg> *> & allArgs,
 			int beam,
-			const vector<ClassifiedArg> & goldArgs)
+			const vector<ClassifiedArg> & goldArgs,
+			vector<ClassifiedArg> & result)
 {
   bool showGold = false;
   bool showFrame = false;
@@ -701,62 +868,57 @@ rerankingClassification(const Tree * predicate,
   //
   // generate the top beam solutions
   //
-  list<UnitCandidate *> * oldCands = new list<UnitCandidate *>();
-  list<UnitCandidate *> * newCands = new list<UnitCandidate *>();
+  FrameBeam frames(beam, allArgs);
   
   for(size_t i = 0; i < allArgs.size(); i ++){
     vector<ClassifiedArg> * crtArgs = allArgs[i];
-    for(size_t j = 0; j < crtArgs->size(); j ++){
-      const ClassifiedArg & crtArg = (* crtArgs)[j];
+    // the frames of the previous step; they change only in endStep()
+    const vector<int> & oldFrames = frames.getFrames();
 
+    for(int j = 0; j < (int) crtArgs->size(); j ++){
       // the partial frames are empty => start them here
-      if(oldCands->size() == 0){
-	addInOrder(* newCands, new UnitCandidate(crtArg));
+      if(oldFrames.empty()){
+	frames.start(j);
       } 
       
       // we continue an existing set of partial frames
       else {
-	for(list<UnitCandidate *>::iterator oldIt = oldCands->begin();
-	    oldIt != oldCands->end(); oldIt ++){
+	for(size_t k = 0; k < oldFrames.size(); k ++){
 	  // add the new arg only if domain constraints are Ok
-	  if(satisfiesDomainConstraints((* oldIt)->mSequence, crtArg)){
-	    UnitCandidate * cand = (* oldIt)->makeCand(crtArg);
-	    addInOrder(* newCands, cand);
+	  if(frames.satisfiesDomainConstraints(oldFrames[k], j)){
+	    frames.extend(oldFrames[k], j);
 	  } 
 	}
       }
     }
 
-    //
-    // newCands stores the new set of cands expanded with the current cand
-    // move newCands -> oldCands (this will store the final set of frames) 
-    //
-    if(newCands->size() > 0){
-      // trim the new candidate list to beam elements
-      trim(* newCands, beam);
+    // keep the top beam frames expanded with the current candidate
+    frames.endStep();
+  }
 
-      deleteCandList(oldCands);
-      oldCands = newCands;
-      newCands = new list<UnitCandidate *>();
-    }
+  // A* reports its own stats, also when it falls back to the beam
+  if(_exactInference == false){
+    addInferenceStats(frames.getOfferCount(), false);
   }
 
+  const vector<int> & finalFrames = frames.getFrames();
+
   //
   // oracle mode: compute the scores of all candidate frames
   //
+  vector<Score> scores;
   if(getOracleMode() == true){
-    for(list<UnitCandidate *>::const_iterator it = oldCands->begin(); 
-	it != oldCands->end(); it ++){
-      UnitCandidate * unit = * it;
-      unit->computeScore(goldArgs);
+    scores.resize(finalFrames.size());
+    for(size_t i = 0; i < finalFrames.size(); i ++){
+      frames.computeScore(finalFrames[i], goldArgs, scores[i]);
     }
   }
 
   //
   // this will store the best frame for this predicate
   //
-  UnitCandidate * best = NULL;
-  if(oldCands->size() > 0) best = oldCands->front();
+  vector<ClassifiedArg> best;
+  if(finalFrames.size() > 0) frames.getSequence(finalFrames[0], best);
   /*
   //
   // Use the code below to compute the true oracle score!
@@ -765,14 +927,8 @@ rerankingClassification(const Tree * predicate,
   // these scores are ALWAYS higher than the true oracle scores (by ~5%).
   //
   // BEGIN TRUE ORACLE
-  int position = 0;
-  for(list<UnitCandidate *>::const_iterator it = oldCands->begin(); 
-      it != oldCands->end() && position < GLOBAL_BEAM; it ++, position ++){
-    UnitCandidate * unit = * it;
-    if(best == NULL || unit->mScore.F1() > best->mScore.F1()){
-      best = unit;
-    }
-  }
+  int trueBest = selectBestFrame(scores, GLOBAL_BEAM);
+  if(trueBest >= 0) frames.getSequence(finalFrames[trueBest], best);
   // END TRUE ORACLE
   */
 
@@ -785,46 +941,32 @@ rerankingClassification(const Tree * predicate,
     }
   }
 
-  if(showFrame && best != NULL){
+  if(showFrame && ! best.empty()){
     cerr << "Predicate: " << predicate->getWord() << endl;
-    for(size_t i = 0; i < best->mSequence.size(); i ++){
-      if(best->mSequence[i].label != "O"){
-	cerr << "\tArg: " << best->mSequence[i].label << " " 
-	     << best->mSequence[i].phrase->getLeftPosition() << " " 
-	     << best->mSequence[i].phrase->getRightPosition() << endl;
+    for(size_t i = 0; i < best.size(); i ++){
+      if(best[i].label != "O"){
+	cerr << "\tArg: " << best[i].label << " " 
+	     << best[i].phrase->getLeftPosition() << " " 
+	     << best[i].phrase->getRightPosition() << endl;
       }
     }
   }
 
   //
-  // create actual args from the best solution
+  // keep the actual args from the best solution
   //
-  if(best != NULL){
-    for(size_t j = 0; j < best->size(); j ++){
-      ClassifiedArg & cand = best->get(j);
-      if(cand.label != "O"){
-	Argument arg("B", cand.label, predicate->getRightPosition());
-	arg.setProb(cand.prob);
-	cand.phrase->addArgPrediction(arg);
-      } 
-    }
+  result.clear();
+  for(size_t j = 0; j < best.size(); j ++){
+    if(best[j].label != "O") result.push_back(best[j]);
   }
 
   //
   // oracle mode: compute the position of the best frame
   //
   if(getOracleMode() == true){
-    int position = 0;
-    int bestPosition = 0;
-    UnitCandidate * bestFrame = NULL;
-    for(list<UnitCandidate *>::const_iterator it = oldCands->begin(); 
-	it != oldCands->end(); it ++, position ++){
-      UnitCandidate * unit = * it;
-      if(bestFrame == NULL || unit->mScore.F1() > bestFrame->mScore.F1()){
-	bestFrame = unit;
-	bestPosition = position;
-      }
-    }
+    MutexLock lock(oracleMutex);
+    int bestPosition = selectBestFrame(scores, (int) scores.size());
+    if(bestPosition < 0) bestPosition = 0;
     bestPositions[bestPosition] ++;    
   }
   
@@ -832,16 +974,41 @@ rerankingClassification(const Tree * predicate,
   // oracle mode: upper score when using the top N frames
   //
   if(getOracleMode() == true){
-    for(int i = 1; i < (int) oldCands->size() && i < GLOBAL_BEAM; i ++){
-      UnitCandidate * bestFrame = selectBestFrame(* oldCands, i);
-      oracleScores[i].mCorrect += bestFrame->mScore.mCorrect;
-      oracleScores[i].mTotal += bestFrame->mScore.mTotal;
-      oracleScores[i].mPredicted += bestFrame->mScore.mPredicted;
+    MutexLock lock(oracleMutex);
+    for(int i = 1; i < (int) scores.size() && i < GLOBAL_BEAM; i ++){
+      const Score & bestFrame = scores[selectBestFrame(scores, i)];
+      oracleScores[i].mCorrect += bestFrame.mCorrect;
+      oracleScores[i].mTotal += bestFrame.mTotal;
+      oracleScores[i].mPredicted += bestFrame.mPredicted;
     }
   }
-  
-  deleteCandList(oldCands);
-  deleteCandList(newCands);
+}
+
+bool Tree::
+searchClassification(const Tree * predicate,
+		     vector<vector<ClassifiedArg> *> & allArgs,
+		     vector<ClassifiedArg> & result)
+{
+  FrameSearch search(allArgs);
+  vector<ClassifiedArg> best;
+  bool found = search.search(ASTAR_MAX_EXPANSIONS, best);
+
+  LOGD << "A* expanded " << search.getExpandedCount() 
+       << " frames for predicate " << predicate->getWord()
+       << " with " << allArgs.size() << " candidates"
+       << (found ? "" : ", falling back to the beam") << endl;
+  addInferenceStats(search.getExpandedCount(), ! found);
+  if(! found) return false;
+
+  //
+  // keep the actual args from the best solution
+  //
+  result.clear();
+  for(size_t j = 0; j < best.size(); j ++){
+    if(best[j].label != "O") result.push_back(best[j]);
+  }
+
+  return true;
 }
 
 void Tree::expandArguments(const std::vector< RCIPtr<srl::Tree> > & sentence,
@@ -1136,6 +1303,111 @@ void Tree::convertIOB2ToParens(std::vector< std::vector<String> > & matrix,
   }
 }
 
+void Tree::collectArgsForVerb(int predicatePosition,
+			      std::vector<const Tree *> & phrases,
+			      std::vector<const Argument *> & args) const
+{
+  for(list<Argument>::const_iterator it = _predictedArguments.begin();
+      it != _predictedArguments.end(); it ++){
+    if((* it).getVerbPosition() == predicatePosition){
+      phrases.push_back(this);
+      args.push_back(& (* it));
+      return;
+    }
+  }
+
+  for(list<TreePtr>::const_iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->collectArgsForVerb(predicatePosition, phrases, args);
+  }
+}
+
+/** Does any terminal in [start, end] have this head word? */
+static bool spanContains(const std::vector< RCIPtr<srl::Tree> > & sentence,
+			 int start,
+			 int end,
+			 const String & word)
+{
+  for(int i = start; i <= end; i ++){
+    if(sentence[i]->getHeadWord() == word) return true;
+  }
+  return false;
+}
+
+void Tree::getArgumentSpans(const std::vector< RCIPtr<srl::Tree> > & sentence,
+			    std::vector<int> & predPositions,
+			    std::vector<ArgumentSpan> & spans)
+{
+  // detect all predicates in this phrase
+  detectPredicates(predPositions);
+
+  int last = (int) sentence.size() - 1;
+  for(size_t predIndex = 0; predIndex < predPositions.size(); predIndex ++){
+    vector<const Tree *> phrases;
+    vector<const Argument *> args;
+    collectArgsForVerb(predPositions[predIndex], phrases, args);
+
+    //
+    // same as convertIOB2ToParens(): a B starts an argument, and the
+    //   adjacent Is with the same name extend it
+    //
+    size_t first = spans.size();
+    for(size_t i = 0; i < args.size(); i ++){
+      if(args[i]->getName() == "X") continue;
+
+      int start = phrases[i]->getLeftPosition();
+      int end = phrases[i]->getRightPosition();
+      if(args[i]->getType() != "B" && spans.size() > first &&
+	 spans.back().label == args[i]->getName() &&
+	 spans.back().end + 1 == start){
+	spans.back().end = end;
+	continue;
+      }
+
+      ArgumentSpan span;
+      span.predicate = predPositions[predIndex];
+      span.label = args[i]->getName();
+      span.start = start;
+      span.end = end;
+      span.prob = args[i]->getProb();
+      spans.push_back(span);
+    }
+
+    //
+    // same as correctionHeuristics(); a boundary never moves into the
+    //   neighbouring argument
+    //
+    for(size_t i = first; i < spans.size(); i ++){
+      ArgumentSpan & span = spans[i];
+      int previousEnd = (i > first ? spans[i - 1].end : -1);
+
+      // Include `` in the argument if '' already included in the same arg
+      if(span.start - 1 > previousEnd &&
+	 sentence[span.start - 1]->getHeadWord() == "``" &&
+	 startsWith(span.label, "A") &&
+	 spanContains(sentence, span.start, span.end, "''")){
+	span.start --;
+      }
+    }
+    for(size_t i = first; i < spans.size(); i ++){
+      ArgumentSpan & span = spans[i];
+      int nextStart = (i + 1 < spans.size() ? spans[i + 1].start : last + 1);
+      if(! spanContains(sentence, span.start, span.end, "``")) continue;
+
+      // Include ,'' OR '' in the argument if `` already included
+      if(span.end + 2 < nextStart &&
+	 sentence[span.end + 1]->getHeadWord() == "," &&
+	 sentence[span.end + 2]->getHeadWord() == "''"){
+	span.end += 2;
+      }
+      if(span.end + 1 < nextStart &&
+	 sentence[span.end + 1]->getHeadWord() == "''"){
+	span.end ++;
+      }
+    }
+  }
+}
+
 static void displayString(OStream & os,
 			  const String & str,
 			  size_t fillSize)
@@ -0,0 +1,113 @@
+
+#include <iostream>
+#include <string>
+
+#include "Tree.h"
+#include "AssertLocal.h"
+
+using namespace std;
+using namespace srl;
+
+//
+// The annotations computed by BankTreeProducer::preprocess() used to
+// require one walk over the tree for each detector. Here the detectors
+// run as stages of only two walks:
+//   - a post-order walk, for the stages that need the annotations of 
+//     the children (heads, content words, positions, includes) or that
+//     only touch the terminals (lemmas, sentence, temporal, suffixes);
+//   - a pre-order walk, for the stages that need the full sentence
+//     (voices, POS contexts, argument begins) or the parent 
+//     (governing category). Feature sets are generated bottom-up on the
+//     way back, after all the nodes they look at are annotated.
+// The stages within one node run in the same order as the detectors
+// used to, so the output does not change.
+//
+
+void Tree::preprocess(std::vector< RCIPtr<srl::Tree> > & sentence,
+		      bool caseSensitive)
+{
+  short position = 0;
+  sentence.clear();
+  preprocessBottomUp(position, sentence, caseSensitive);
+  preprocessTopDown(sentence, this, caseSensitive);
+}
+
+void Tree::preprocessBottomUp(short & position,
+			      std::vector< RCIPtr<srl::Tree> > & sentence,
+			      bool caseSensitive)
+{
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->preprocessBottomUp(position, sentence, caseSensitive);
+  }
+
+  // Collins head heuristics
+  // Surdeanu, ACL2003 content word heuristics
+  if(_children.empty() == false){
+    detectHead();
+    detectContentWord();
+  }
+
+  if(isTerminal()){
+    // sentence terminal positions
+    _leftPosition = position;
+    _rightPosition = position;
+    position ++;
+
+    // detect lemmas if not already set
+    getLemma();
+
+    // extract sequence of terminals
+    sentence.push_back(TreePtr(this));
+
+    // detect temporal-specific terminals
+    detectTemporalTerminal();
+
+    // detect head word suffixes
+    detectWordSuffixes(caseSensitive);
+  } else {
+    _leftPosition = _children.front()->getLeftPosition();
+    _rightPosition = _children.back()->getRightPosition();
+
+    // detect the sequence of children labels
+    detectChildrenLabels();
+  }
+
+  // these set annotations of the children, which are not used in this walk
+  detectAuxChildren();
+  detectChildrenSiblingPaths();
+  detectChildrenSiblings();
+
+  // mark the inclusion of several semantic categories
+  gatherIncludes();
+}
+
+void Tree::preprocessTopDown(const std::vector< RCIPtr<srl::Tree> > & sentence,
+			     const Tree * top,
+			     bool caseSensitive)
+{
+  // detect voice
+  detectPredicateVoice(sentence);
+
+  // detect POS contexts
+  detectPOSContext(sentence);
+
+  // detect the governing category for NPs: S or VP?
+  if(hasLabelCategory(LABEL_IS_NP)) detectGoverningParent();
+
+  // detect B-A nodes for all I-As
+  detectArgumentBegin(top);
+
+  // detect the types of B labels: single, term, incorrect
+  detectBType();
+
+  for(list<TreePtr>::iterator it = _children.begin();
+      it != _children.end(); it ++){
+    (* it)->preprocessTopDown(sentence, top, caseSensitive);
+  }
+
+  // generate the feature sets for each phrase, as generateFeatureSets()
+  generateArgumentFeatures(sentence, caseSensitive);
+  if(isTerminal() && isPredicate()) 
+    generatePredicateFeatures(sentence, caseSensitive);
+}
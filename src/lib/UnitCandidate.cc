@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <math.h>
 #include <algorithm>
+#include <map>
 
 #include "UnitCandidate.h"
 #include "AssertLocal.h"
@@ -13,50 +14,185 @@
 using namespace std;
 using namespace srl;
 
-UnitCandidate::UnitCandidate(const ClassifiedArg & first) 
+FrameConstraints::
+FrameConstraints(const vector<vector<ClassifiedArg> *> & allArgs)
+  : mAllArgs(allArgs)
 {
-  reset();
-  mSequence.push_back(first);
-  mProb = first.prob;
-  
-  if(first.label != "O"){
-    mArgProbSum += exp(first.prob);
-    mArgCount ++;
+  int candidateCount = (int) allArgs.size();
+  mCandidateWords = (candidateCount + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+  // all labels of a candidate share the same phrase
+  vector<const Tree *> phrases(candidateCount, (const Tree *) NULL);
+  for(int i = 0; i < candidateCount; i ++){
+    if(! allArgs[i]->empty()) phrases[i] = (* allArgs[i])[0].phrase;
+  }
+
+  mOverlaps.resize(candidateCount * mCandidateWords, 0);
+  for(int i = 0; i < candidateCount; i ++){
+    if(phrases[i] == NULL) continue;
+    for(int k = 0; k < candidateCount; k ++){
+      if(phrases[k] == NULL) continue;
+      if(phrases[i]->includes(phrases[k]) ||
+	 phrases[k]->includes(phrases[i])){
+	set(& mOverlaps[i * mCandidateWords], k);
+      }
+    }
+  }
+
+  // one bit for each distinct core label
+  map<String, int> coreLabels;
+  mLabelIds.resize(candidateCount);
+  for(int i = 0; i < candidateCount; i ++){
+    const vector<ClassifiedArg> & args = * allArgs[i];
+    mLabelIds[i].resize(args.size(), -1);
+    for(size_t j = 0; j < args.size(); j ++){
+      if(args[j].label == "O" || startsWith(args[j].label, "AM")) continue;
+      map<String, int>::iterator it = coreLabels.find(args[j].label);
+      if(it == coreLabels.end()){
+	int id = (int) coreLabels.size();
+	it = coreLabels.insert(make_pair(args[j].label, id)).first;
+      }
+      mLabelIds[i][j] = it->second;
+    }
+  }
+  mLabelWords = (coreLabels.size() + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+bool FrameConstraints::satisfies(const unsigned long * frameBits,
+				 int i, int j) const
+{
+  // O is always fine
+  if((* mAllArgs[i])[j].label == "O") return true;
+
+  //
+  // two arguments in the same frame cannot include each other
+  //
+  const unsigned long * overlaps = & mOverlaps[i * mCandidateWords];
+  for(size_t w = 0; w < mCandidateWords; w ++){
+    if(frameBits[w] & overlaps[w]) return false;
   }
+
+  //
+  // numeric arguments cannot repeat
+  //
+  int labelId = mLabelIds[i][j];
+  if(labelId >= 0 && test(frameBits + mCandidateWords, labelId)) return false;
+
+  return true;
+}
+
+void FrameConstraints::add(unsigned long * frameBits, int i, int j) const
+{
+  if((* mAllArgs[i])[j].label == "O") return;
+
+  set(frameBits, i);
+  if(mLabelIds[i][j] >= 0) set(frameBits + mCandidateWords, mLabelIds[i][j]);
 }
 
-UnitCandidate * UnitCandidate::makeCand(const ClassifiedArg & last) 
+FrameBeam::FrameBeam(size_t beam,
+		     const vector<vector<ClassifiedArg> *> & allArgs)
+  : mBeam(beam), mAllArgs(allArgs), mConstraints(allArgs),
+    mStep(0), mOfferCount(0)
 {
-  UnitCandidate * newCand = new UnitCandidate();
-  for(size_t i = 0; i < mSequence.size(); i ++)
-    newCand->mSequence.push_back(mSequence[i]);
-
-  newCand->mSequence.push_back(last);
-  newCand->mProb = mProb + last.prob;
-  
-  newCand->mArgCount = mArgCount;
-  newCand->mArgProbSum = mArgProbSum;
-  if(last.label != "O"){
-    newCand->mArgProbSum += exp(last.prob);
-    newCand->mArgCount ++;
+}
+
+void FrameBeam::offer(int parent, int j)
+{
+  if(mBeam == 0) return;
+
+  const ClassifiedArg & arg = (* mAllArgs[mStep])[j];
+
+  Offer o;
+  o.prob = (parent < 0 ? arg.prob : mNodes[parent].mProb + arg.prob);
+  o.order = mOfferCount ++;
+  o.parent = parent;
+  o.label = j;
+
+  if(mOffers.size() < mBeam){
+    mOffers.push_back(o);
+    push_heap(mOffers.begin(), mOffers.end(), isBetter);
+  } else if(isBetter(o, mOffers.front())){
+    // replace the worst offer
+    pop_heap(mOffers.begin(), mOffers.end(), isBetter);
+    mOffers.back() = o;
+    push_heap(mOffers.begin(), mOffers.end(), isBetter);
   }
-  
-  return newCand;
 }
 
-void UnitCandidate::addArg(const ClassifiedArg & arg)
+/**
+ * Creates the node for label j of candidate i, which extends parent,
+ *   in the given pools
+ */
+static int addNode(const vector<vector<ClassifiedArg> *> & allArgs,
+		   const FrameConstraints & constraints,
+		   int parent, int i, int j, double prob,
+		   vector<UnitCandidate> & nodes,
+		   vector<unsigned long> & bits)
 {
-  mSequence.push_back(arg);
-  mProb += arg.prob;
+  const ClassifiedArg & arg = (* allArgs[i])[j];
+  size_t words = constraints.getWords();
+
+  UnitCandidate node;
+  node.mArg = & arg;
+  node.mCandidate = i;
+  node.mParent = parent;
+  node.mBits = bits.size();
+  node.mProb = prob;
+  node.mArgProbSum = 0;
+  node.mArgCount = 0;
+
+  bits.resize(bits.size() + words, 0);
+  if(parent >= 0){
+    node.mArgProbSum = nodes[parent].mArgProbSum;
+    node.mArgCount = nodes[parent].mArgCount;
+    copy(bits.begin() + nodes[parent].mBits,
+	 bits.begin() + nodes[parent].mBits + words,
+	 bits.begin() + node.mBits);
+  }
 
   if(arg.label != "O"){
-    mArgProbSum += exp(arg.prob);
-    mArgCount ++;
-  }  
+    node.mArgProbSum += exp(arg.prob);
+    node.mArgCount ++;
+  }
+  constraints.add(& bits[node.mBits], i, j);
+
+  nodes.push_back(node);
+  return (int) nodes.size() - 1;
+}
+
+void FrameBeam::endStep()
+{
+  if(mOffers.empty()){
+    mStep ++;
+    return;
+  }
+
+  // best offer first
+  sort_heap(mOffers.begin(), mOffers.end(), isBetter);
+
+  mFrames.clear();
+  for(size_t i = 0; i < mOffers.size(); i ++){
+    const Offer & o = mOffers[i];
+    mFrames.push_back(addNode(mAllArgs, mConstraints, o.parent,
+			      mStep, o.label, o.prob, mNodes, mBits));
+  }
+
+  mOffers.clear();
+  mStep ++;
+}
+
+void FrameBeam::getSequence(int frame,
+			    std::vector<ClassifiedArg> & sequence) const
+{
+  sequence.clear();
+  for(int f = frame; f >= 0; f = mNodes[f].mParent){
+    sequence.push_back(* mNodes[f].mArg);
+  }
+  reverse(sequence.begin(), sequence.end());
 }
 
 /**
- * Verifies if this predicted argument matches a GOLD argument 
+ * Verifies if this predicted argument matches a GOLD argument
  */
 static bool matchesGold(const ClassifiedArg & arg,
 			const vector<ClassifiedArg> & goldArgs)
@@ -67,14 +203,94 @@ static bool matchesGold(const ClassifiedArg & arg,
   return false;
 }
 
-/** Computes the score of this frame compared to the GOLD args */
-void UnitCandidate::computeScore(const std::vector<ClassifiedArg> & goldArgs)
+void FrameBeam::computeScore(int frame,
+			     const std::vector<ClassifiedArg> & goldArgs,
+			     Score & score) const
+{
+  score.mTotal = goldArgs.size();
+  for(int f = frame; f >= 0; f = mNodes[f].mParent){
+    const ClassifiedArg & arg = * mNodes[f].mArg;
+    if(arg.label != "O"){
+      score.mPredicted ++;
+      if(matchesGold(arg, goldArgs)) score.mCorrect ++;
+    }
+  }
+}
+
+FrameSearch::FrameSearch(const vector<vector<ClassifiedArg> *> & allArgs)
+  : mAllArgs(allArgs), mConstraints(allArgs),
+    mEntryCount(0), mExpandedCount(0)
+{
+  int candidateCount = (int) allArgs.size();
+
+  mHeuristic.resize(candidateCount + 1, 0.0);
+  mNext.resize(candidateCount + 1, candidateCount);
+  for(int i = candidateCount - 1; i >= 0; i --){
+    const vector<ClassifiedArg> & args = * allArgs[i];
+    double best = 0.0;
+    for(size_t j = 0; j < args.size(); j ++){
+      if(j == 0 || args[j].prob > best) best = args[j].prob;
+    }
+    mHeuristic[i] = mHeuristic[i + 1] + best;
+    mNext[i] = (args.empty() ? mNext[i + 1] : i);
+  }
+}
+
+void FrameSearch::push(int frame, int i, int j)
 {
-  mScore.mTotal = goldArgs.size();
-  for(size_t i = 0; i < mSequence.size(); i ++){
-    if(mSequence[i].label != "O"){
-      mScore.mPredicted ++;
-      if(matchesGold(mSequence[i], goldArgs)) mScore.mCorrect ++;
+  double prob = (* mAllArgs[i])[j].prob;
+  if(frame >= 0) prob += mNodes[frame].mProb;
+
+  Entry e;
+  e.node = addNode(mAllArgs, mConstraints, frame, i, j, prob, mNodes, mBits);
+  e.estimate = prob + mHeuristic[i + 1];
+  e.order = mEntryCount ++;
+
+  mQueue.push_back(e);
+  push_heap(mQueue.begin(), mQueue.end(), isWorse);
+}
+
+void FrameSearch::expand(int frame)
+{
+  int i = mNext[frame < 0 ? 0 : mNodes[frame].mCandidate + 1];
+  const vector<ClassifiedArg> & args = * mAllArgs[i];
+
+  for(int j = 0; j < (int) args.size(); j ++){
+    if(frame < 0 ||
+       mConstraints.satisfies(& mBits[mNodes[frame].mBits], i, j)){
+      push(frame, i, j);
+    }
+  }
+}
+
+bool FrameSearch::search(size_t maxExpansions,
+			 std::vector<ClassifiedArg> & frame)
+{
+  frame.clear();
+
+  int candidateCount = (int) mAllArgs.size();
+  if(mNext[0] == candidateCount) return true;
+
+  expand(-1);
+
+  while(! mQueue.empty()){
+    pop_heap(mQueue.begin(), mQueue.end(), isWorse);
+    int best = mQueue.back().node;
+    mQueue.pop_back();
+
+    // the first complete frame out of the queue is the best one
+    if(mNext[mNodes[best].mCandidate + 1] == candidateCount){
+      for(int f = best; f >= 0; f = mNodes[f].mParent){
+	frame.push_back(* mNodes[f].mArg);
+      }
+      reverse(frame.begin(), frame.end());
+      return true;
     }
+
+    if(mExpandedCount >= maxExpansions) return false;
+    mExpandedCount ++;
+    expand(best);
   }
+
+  return false;
 }
@@ -7,45 +7,242 @@
 #include "Score.h"
 
 namespace srl {
+
+/**
+ * One partial frame: the label of its last candidate, plus a link to the
+ *   frame it extends. Frames that share a prefix share its nodes.
+ */
 class UnitCandidate
 {
  public:
-  /** Label assignments for all candidates */
-  std::vector<ClassifiedArg> mSequence; 
+  /** Label assignment for the last candidate */
+  const ClassifiedArg * mArg;
+
+  /** The candidate labeled by mArg */
+  int mCandidate;
+
+  /** Index of the frame extended by this one, -1 for the first candidate */
+  int mParent;
 
-  /** log_prob of the whole sequence */ 
-  double mProb; 
+  /** Offset of the bitsets of this frame in the pool of its search */
+  size_t mBits;
+
+  /** log_prob of the whole sequence */
+  double mProb;
 
   /** Sum of probs for all non-O arguments */
   double mArgProbSum;
   int mArgCount;
 
-  /** The oracle score of a frame */
-  Score mScore;
+}; // UnitCandidate
+
+/**
+ * The domain constraints of the frames of one predicate
+ * Candidate i is the phrase labeled by allArgs[i]. Each frame keeps two
+ *   bitsets, the candidates with a non-O label and the core (non-AM)
+ *   labels in the frame, such that the constraints reduce to a few ANDs
+ *   with the inclusion matrix of the candidates.
+ */
+class FrameConstraints
+{
+ public:
+  FrameConstraints(const std::vector<std::vector<ClassifiedArg> *> & allArgs);
+
+  /** Size of the bitsets of one frame, in words */
+  size_t getWords() const { return mCandidateWords + mLabelWords; }
 
-  UnitCandidate() {
-    reset();
+  /**
+   * Verifies that label j of candidate i can be added to the frame:
+   *   arguments in the same frame cannot include each other, and
+   *   numeric arguments cannot repeat
+   */
+  bool satisfies(const unsigned long * frameBits, int i, int j) const;
+
+  /** Adds label j of candidate i to the bitsets of a frame */
+  void add(unsigned long * frameBits, int i, int j) const;
+
+ private:
+  static bool test(const unsigned long * bits, int i) {
+    return (bits[i / BITS_PER_WORD] >> (i % BITS_PER_WORD)) & 1;
   }
 
-  void reset(){
-    mProb = 0.0;
-    
-    mArgProbSum = 0;
-    mArgCount = 0;
+  static void set(unsigned long * bits, int i) {
+    bits[i / BITS_PER_WORD] |= 1UL << (i % BITS_PER_WORD);
   }
 
-  UnitCandidate(const ClassifiedArg & first);
+  enum { BITS_PER_WORD = 8 * sizeof(unsigned long) };
 
-  void addArg(const ClassifiedArg & arg);
+  const std::vector<std::vector<ClassifiedArg> *> & mAllArgs;
 
-  UnitCandidate * makeCand(const ClassifiedArg & last);
+  /** Words in one bitset of candidates, and of core labels */
+  size_t mCandidateWords;
+  size_t mLabelWords;
 
-  size_t size() { return mSequence.size(); }
-  ClassifiedArg & get(int i) { return mSequence[i]; }
+  /**
+   * Row i marks the candidates that include candidate i or are
+   *   included in it
+   */
+  std::vector<unsigned long> mOverlaps;
 
-  void computeScore(const std::vector<ClassifiedArg> & goldArgs);
+  /** mLabelIds[i][j]: bit of label j of candidate i, -1 if not core */
+  std::vector< std::vector<int> > mLabelIds;
 
-}; // UnitCandidate
+}; // FrameConstraints
+
+/**
+ * The top frames of one predicate, grown one candidate at a time
+ * Frames are offered with start() or extend(), and endStep() keeps the
+ *   best beam of them. Frames of equal prob are ranked in the order they
+ *   were offered. Extending a frame is O(1), and the node pool grows by at
+ *   most beam nodes per candidate.
+ */
+class FrameBeam
+{
+ public:
+  FrameBeam(size_t beam,
+	    const std::vector<std::vector<ClassifiedArg> *> & allArgs);
+
+  /** Offers a new frame that starts with label j of the next candidate */
+  void start(int j) { offer(-1, j); }
+
+  /** Offers frame + label j of the next candidate */
+  void extend(int frame, int j) { offer(frame, j); }
+
+  /** Can label j of the next candidate be added to the frame? */
+  bool satisfiesDomainConstraints(int frame, int j) const {
+    return mConstraints.satisfies(& mBits[mNodes[frame].mBits], mStep, j);
+  }
+
+  /**
+   * Replaces the current frames with the best frames offered since the
+   *   previous call. If nothing was offered, keeps the current frames.
+   * Moves to the next candidate.
+   */
+  void endStep();
+
+  /** Indexes of the current frames, in descending order of their probs */
+  const std::vector<int> & getFrames() const { return mFrames; }
+
+  const UnitCandidate & get(int frame) const { return mNodes[frame]; }
+
+  /** Label assignments of all candidates in this frame, in order */
+  void getSequence(int frame, std::vector<ClassifiedArg> & sequence) const;
+
+  /** Computes the score of this frame compared to the GOLD args */
+  void computeScore(int frame,
+		    const std::vector<ClassifiedArg> & goldArgs,
+		    Score & score) const;
+
+  /** Number of frames offered so far */
+  size_t getOfferCount() const { return mOfferCount; }
+
+ private:
+  /** A frame that may enter the beam at the end of the current step */
+  struct Offer {
+    double prob;
+    size_t order;
+    int parent;
+    int label;
+  };
+
+  /** Higher prob first; for equal probs, the earliest offer first */
+  static bool isBetter(const Offer & o1, const Offer & o2) {
+    if(o1.prob != o2.prob) return o1.prob > o2.prob;
+    return o1.order < o2.order;
+  }
+
+  void offer(int parent, int j);
+
+  size_t mBeam;
+
+  const std::vector<std::vector<ClassifiedArg> *> & mAllArgs;
+
+  FrameConstraints mConstraints;
+
+  /** The candidate labeled by the next step */
+  int mStep;
+
+  /** All frame nodes created for this predicate */
+  std::vector<UnitCandidate> mNodes;
+
+  /** The bitsets of all nodes, FrameConstraints::getWords() per node */
+  std::vector<unsigned long> mBits;
+
+  std::vector<int> mFrames;
+
+  /** The offers of the current step; heap with the worst offer on top */
+  std::vector<Offer> mOffers;
+
+  size_t mOfferCount;
+
+}; // FrameBeam
+
+/**
+ * Exact best-first (A*) search for the frame with the highest prob
+ * Frames are extended one candidate at a time, in the order of allArgs,
+ *   under the same constraints as in FrameBeam. The heuristic sums the
+ *   best label probs of the candidates not yet labeled: it never
+ *   underestimates the prob of a complete frame, so the first complete
+ *   frame taken from the queue is the best one.
+ */
+class FrameSearch
+{
+ public:
+  FrameSearch(const std::vector<std::vector<ClassifiedArg> *> & allArgs);
+
+  /**
+   * Searches for the best frame
+   * @param maxExpansions Gives up after expanding this many frames
+   * @return false if the search gave up, or if no frame labels all
+   *         candidates
+   */
+  bool search(size_t maxExpansions, std::vector<ClassifiedArg> & frame);
+
+  /** Number of frames expanded by search() */
+  size_t getExpandedCount() const { return mExpandedCount; }
+
+ private:
+  /** A frame waiting in the queue */
+  struct Entry {
+    /** Prob of the frame plus the heuristic of the rest */
+    double estimate;
+    size_t order;
+    int node;
+  };
+
+  /** Heap order: highest estimate on top; for ties, the earliest entry */
+  static bool isWorse(const Entry & e1, const Entry & e2) {
+    if(e1.estimate != e2.estimate) return e1.estimate < e2.estimate;
+    return e1.order > e2.order;
+  }
+
+  /** Queues frame + label j of candidate i */
+  void push(int frame, int i, int j);
+
+  /** Queues all valid extensions of frame (-1 for the empty frame) */
+  void expand(int frame);
+
+  const std::vector<std::vector<ClassifiedArg> *> & mAllArgs;
+
+  FrameConstraints mConstraints;
+
+  /** mHeuristic[i]: sum of the best label probs of candidates i, i+1, ... */
+  std::vector<double> mHeuristic;
+
+  /** mNext[i]: the first candidate at or after i with at least one label */
+  std::vector<int> mNext;
+
+  std::vector<UnitCandidate> mNodes;
+
+  std::vector<unsigned long> mBits;
+
+  std::vector<Entry> mQueue;
+
+  size_t mEntryCount;
+
+  size_t mExpandedCount;
+
+}; // FrameSearch
 
 } // namespace srl
 
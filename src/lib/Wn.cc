@@ -7,8 +7,10 @@
 #include <wn.h>
 
 #include "Wnet.h"
+#include "Label.h"
 #include "StringMap.h"
 #include "AssertLocal.h"
+#include "Mutex.h"
 
 using namespace std;
 using namespace srl;
@@ -24,6 +26,9 @@ std::vector< srl::StringMap<String> > WordNet::_lemmaCache;
 /** Cache for synsets */
 std::vector< srl::StringMap< std::vector<String> > > WordNet::_synsetCache;
 
+/** WordNet and the caches above are not thread safe */
+static Mutex wordNetMutex;
+
 bool WordNet::initialize()
 {
   if(initialized == true){
@@ -57,6 +62,7 @@ bool WordNet::initialize()
 
 WordNet::WordNet()
 {
+  MutexLock lock(wordNetMutex);
   if(initialize() == false){
     throw bool(false);
   }
@@ -64,15 +70,18 @@ WordNet::WordNet()
 
 int WordNet::getWordNetPos(const String & label)
 {
-  if(label.substr(0, 2) == "NN"){
+  short id;
+  unsigned short categories;
+  Label::lookup(label, id, categories);
+  if(categories & LABEL_IS_NOUN){
     return 1;
-  } else if(label.substr(0, 2) == "VB"){
+  } else if(categories & LABEL_IS_VERB){
     return 2;
-  } else if(label == "AUX"){ // Charniak's parser
+  } else if(id == LABEL_AUX){ // Charniak's parser
     return 2;
-  } else if(label.substr(0, 2) == "JJ"){
+  } else if(categories & LABEL_IS_ADJ){
     return 3;
-  } else if(label.substr(0, 2) == "RB"){
+  } else if(categories & LABEL_IS_ADV){
     return 4;
   } 
 
@@ -114,6 +123,8 @@ String WordNet::morph(const String & word,
   int wnPos = getWordNetPos(label);
   LASSERT(wnPos < WN_POS_COUNT, "invalid pos index");
 
+  MutexLock lock(wordNetMutex);
+
   // Has this word been cached?
   if(_lemmaCache[wnPos].get(word.c_str(), lemma) == true){
     return lemma;
@@ -186,6 +197,8 @@ bool WordNet::synonyms(const String & word,
   int wnPos = getWordNetPos(label);
   LASSERT(wnPos < WN_POS_COUNT, "invalid pos index");
 
+  MutexLock lock(wordNetMutex);
+
   // Copy word in a work buffer
   char * buffer = new char[word.size() + 1];
   strcpy(buffer, word.c_str());
@@ -249,6 +262,8 @@ bool WordNet::synsets(const String & word,
   int wnPos = getWordNetPos(label);
   LASSERT(wnPos < WN_POS_COUNT, "invalid pos index");
 
+  MutexLock lock(wordNetMutex);
+
   // Has this word been cached?
   if(_synsetCache[wnPos].get(word.c_str(), synsets) == true){
     // cerr << "Found in cache!" << endl;